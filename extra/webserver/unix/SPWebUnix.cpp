@@ -25,8 +25,19 @@
 #include "SPWebUnixRoot.cc"
 #include "SPWebUnixHost.cc"
 
+#include "SPWebUnixTimerWheel.cc"
+#include "SPWebUnixTaskQueue.cc"
 #include "SPWebUnixConnectionQueue.cc"
+#include "SPWebUnixHttpParser.cc"
 #include "SPWebUnixConnectionWorker.cc"
+#include "SPWebUnixUring.cc"
+#include "SPWebUnixHandlerPool.cc"
+#include "SPWebUnixTls.cc"
 
+#include "SPWebUnixCompress.cc"
+#include "SPWebUnixStaticCache.cc"
+#include "SPWebUnixFileCache.cc"
+#include "SPWebUnixHeaders.cc"
 #include "SPWebUnixRequest.cc"
+#include "SPWebUnixHttp2.cc"
 #include "SPWebUnixWebsocket.cc"
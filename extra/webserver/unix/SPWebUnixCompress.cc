@@ -0,0 +1,243 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#include "SPWebUnixCompress.h"
+
+#include <brotli/encode.h>
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+// brotli does not pass block size to free function, so we store it before the block
+static constexpr size_t s_allocHeader = 16;
+
+static void *s_allocFunc(void *opaque, size_t size) {
+	auto block = (uint8_t *)pool::palloc((pool_t *)opaque, size + s_allocHeader);
+	*(size_t *)block = size + s_allocHeader;
+	return block + s_allocHeader;
+}
+
+static void s_freeFunc(void *opaque, void *ptr) {
+	if (ptr) {
+		auto block = (uint8_t *)ptr - s_allocHeader;
+		pool::free((pool_t *)opaque, block, *(size_t *)block);
+	}
+}
+
+class UnixBrotliEncoder : public UnixEncoder {
+public:
+	UnixBrotliEncoder(pool_t *statePool, const CompressionInfo &);
+	virtual ~UnixBrotliEncoder();
+
+	virtual bool process(pool_t *, const uint8_t *, size_t, ConnectionWorker::BufferChain &target, Operation) override;
+
+protected:
+	BrotliEncoderState *_state = nullptr;
+};
+
+struct EncoderInfo {
+	StringView name;
+	UnixEncoder *(*create)(pool_t *, pool_t *statePool, const CompressionInfo &);
+};
+
+// supported codings in order of preference, new encoder should be added here
+static EncoderInfo s_encoders[] = {
+	{ "br", [] (pool_t *p, pool_t *statePool, const CompressionInfo &info) -> UnixEncoder * {
+		return new (p) UnixBrotliEncoder(statePool, info);
+	} },
+};
+
+float UnixCompressor::getQuality(StringView accept, StringView encoding) {
+	float quality = -1.0f;
+	float wildcard = -1.0f;
+
+	string::split(accept, ",", [&] (StringView v) {
+		v.trimChars<StringView::WhiteSpace>();
+
+		auto name = v.readUntil<StringView::Chars<';'>>();
+		name.trimChars<StringView::WhiteSpace>();
+
+		auto tmp = name.str<memory::StandartInterface>();
+		string::apply_tolower_c(tmp);
+
+		float q = 1.0f;
+		while (v.is(';')) {
+			++ v;
+			v.skipChars<StringView::WhiteSpace>();
+			if (v.starts_with("q=") || v.starts_with("Q=")) {
+				v = v.sub(2);
+				// malformed q-value should not enable coding
+				q = float(v.readDouble().get(0.0));
+			}
+			v.skipUntil<StringView::Chars<';'>>();
+		}
+
+		if (StringView(tmp) == encoding) {
+			quality = q;
+		} else if (name == "*") {
+			wildcard = q;
+		}
+	});
+
+	// explicit coding overrides wildcard
+	if (quality >= 0.0f) {
+		return quality;
+	}
+	return std::max(wildcard, 0.0f);
+}
+
+bool UnixCompressor::isAcceptable(StringView accept, StringView encoding) {
+	return getQuality(accept, encoding) > 0.0f;
+}
+
+StringView UnixCompressor::select(StringView accept) {
+	StringView ret;
+	float quality = 0.0f;
+	for (auto &it : s_encoders) {
+		// on equal q-values, order of the table is the server's preference
+		auto q = getQuality(accept, it.name);
+		if (q > quality) {
+			quality = q;
+			ret = it.name;
+		}
+	}
+	return ret;
+}
+
+bool UnixCompressor::isCompressible(StringView ct) {
+	auto type = ct.readUntil<StringView::Chars<' ', ';'>>();
+	return type.starts_with("text/") || type == "application/json" || type == "application/javascript"
+			|| type == "application/cbor" || type == "application/xml" || type == "image/svg+xml";
+}
+
+bool UnixCompressor::compress(BytesView data, int quality, int lgwin, mem_std::Bytes &out) {
+	out.resize(BrotliEncoderMaxCompressedSize(data.size()));
+
+	size_t encodedSize = out.size();
+	if (!BrotliEncoderCompress(quality, lgwin, BROTLI_MODE_GENERIC, data.size(), data.data(), &encodedSize, out.data())) {
+		out.clear();
+		return false;
+	}
+
+	out.resize(encodedSize);
+	out.shrink_to_fit();
+	return true;
+}
+
+UnixCompressor::UnixCompressor(pool_t *p, pool_t *statePool, StringView encoding, const CompressionInfo &info)
+: _encoding(encoding) {
+	for (auto &it : s_encoders) {
+		if (it.name == encoding) {
+			_encoder = it.create(p, statePool, info);
+			_encoding = it.name;
+			break;
+		}
+	}
+	if (!_encoder) {
+		log::error("UnixCompressor", "Encoding is not supported: ", encoding);
+	}
+}
+
+UnixCompressor::~UnixCompressor() {
+	if (_encoder) {
+		_encoder->~UnixEncoder();
+		_encoder = nullptr;
+	}
+}
+
+bool UnixCompressor::compress(pool_t *p, ConnectionWorker::BufferChain &source, ConnectionWorker::BufferChain &target, Operation op) {
+	if (!_encoder) {
+		source.clear();
+		return false;
+	}
+
+	auto outSize = target.size();
+	bool success = true;
+	source.read([&, this] (const ConnectionWorker::Buffer *buf, const uint8_t *data, size_t len) {
+		if (buf->isOutFile()) {
+			log::error("UnixCompressor", "File buffers can not be compressed");
+			success = false;
+			return int(DECLINED);
+		}
+		if (!_encoder->process(p, data, len, target, Process)) {
+			success = false;
+			return int(DECLINED);
+		}
+		_totalIn += len;
+		return int(len);
+	}, true);
+
+	source.clear();
+
+	if (success && op != Process) {
+		success = _encoder->process(p, nullptr, 0, target, op);
+	}
+
+	_totalOut += target.size() - outSize;
+	return success;
+}
+
+UnixBrotliEncoder::UnixBrotliEncoder(pool_t *statePool, const CompressionInfo &info) {
+	_state = BrotliEncoderCreateInstance(s_allocFunc, s_freeFunc, statePool);
+	BrotliEncoderSetParameter(_state, BROTLI_PARAM_QUALITY, info.quality);
+	BrotliEncoderSetParameter(_state, BROTLI_PARAM_LGWIN, info.lgwin);
+	BrotliEncoderSetParameter(_state, BROTLI_PARAM_LGBLOCK, info.lgblock);
+}
+
+UnixBrotliEncoder::~UnixBrotliEncoder() {
+	if (_state) {
+		BrotliEncoderDestroyInstance(_state);
+		_state = nullptr;
+	}
+}
+
+bool UnixBrotliEncoder::process(pool_t *p, const uint8_t *data, size_t len, ConnectionWorker::BufferChain &target, Operation op) {
+	BrotliEncoderOperation brotliOp = BROTLI_OPERATION_PROCESS;
+	switch (op) {
+	case Process: brotliOp = BROTLI_OPERATION_PROCESS; break;
+	case Flush: brotliOp = BROTLI_OPERATION_FLUSH; break;
+	case Finish: brotliOp = BROTLI_OPERATION_FINISH; break;
+	}
+
+	const uint8_t *nextIn = data;
+	size_t availIn = len;
+
+	do {
+		uint8_t *nextOut = nullptr;
+		size_t availOut = 0;
+
+		if (!BrotliEncoderCompressStream(_state, brotliOp, &availIn, &nextIn, &availOut, &nextOut, nullptr)) {
+			log::error("UnixCompressor", "Error while compressing data");
+			return false;
+		}
+
+		// copy encoder's output, pointer is valid until next call to encoder
+		while (BrotliEncoderHasMoreOutput(_state)) {
+			size_t outputLen = 0;
+			auto output = BrotliEncoderTakeOutput(_state, &outputLen);
+			target.write(p, output, outputLen);
+		}
+	} while (availIn > 0 || (op == Finish && !BrotliEncoderIsFinished(_state)));
+
+	return true;
+}
+
+}
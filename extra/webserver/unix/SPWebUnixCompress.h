@@ -0,0 +1,98 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#ifndef EXTRA_WEBSERVER_UNIX_SPWEBUNIXCOMPRESS_H_
+#define EXTRA_WEBSERVER_UNIX_SPWEBUNIXCOMPRESS_H_
+
+#include "SPWebUnixConnectionWorker.h"
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+// Stream encoder for one content coding
+// Encoders are registered in the table in SPWebUnixCompress.cc, and selected by Accept-Encoding
+class SP_PUBLIC UnixEncoder : public AllocBase {
+public:
+	enum Operation {
+		Process, // compress data, output can be buffered by encoder
+		Flush, // compress data and emit all buffered output
+		Finish, // compress data and complete the stream
+	};
+
+	virtual ~UnixEncoder() = default;
+
+	// append encoded data to the target, false if stream is broken
+	virtual bool process(pool_t *, const uint8_t *, size_t, ConnectionWorker::BufferChain &target, Operation) = 0;
+};
+
+// Compressor for the response body with the content coding, negotiated with Accept-Encoding
+// Encoder memory is allocated from the worker's pool, so large blocks are reused
+// between responses instead of allocation for every request
+class SP_PUBLIC UnixCompressor : public AllocBase {
+public:
+	using Operation = UnixEncoder::Operation;
+
+	static constexpr auto Process = UnixEncoder::Process;
+	static constexpr auto Flush = UnixEncoder::Flush;
+	static constexpr auto Finish = UnixEncoder::Finish;
+
+	// encoding of the whole block compression, used for the static files cache
+	static constexpr const char *BlockEncoding = "br";
+
+	// q-value for the encoding in Accept-Encoding, explicit coding overrides wildcard,
+	// missing or malformed q-value means 0
+	static float getQuality(StringView acceptEncoding, StringView encoding);
+
+	// check if Accept-Encoding allows encoding, q-values and wildcard are respected
+	static bool isAcceptable(StringView acceptEncoding, StringView encoding = StringView(BlockEncoding));
+
+	// registered encoding with the highest q-value, empty if client accepts none of them
+	static StringView select(StringView acceptEncoding);
+
+	// check if content is worth to compress (text and structured data)
+	static bool isCompressible(StringView contentType);
+
+	// compress whole block at once with BlockEncoding
+	static bool compress(BytesView, int quality, int lgwin, mem_std::Bytes &);
+
+	// encoder is allocated from the pool, where compressor is, its state - from the statePool;
+	// encoding should be one of the registered ones (from select)
+	UnixCompressor(pool_t *, pool_t *statePool, StringView encoding, const CompressionInfo &);
+	~UnixCompressor();
+
+	// compress data from the source into the target, source buffers are consumed
+	bool compress(pool_t *, ConnectionWorker::BufferChain &source, ConnectionWorker::BufferChain &target, Operation);
+
+	StringView getEncoding() const { return _encoding; }
+
+	size_t getTotalIn() const { return _totalIn; }
+	size_t getTotalOut() const { return _totalOut; }
+
+protected:
+	StringView _encoding;
+	UnixEncoder *_encoder = nullptr;
+	size_t _totalIn = 0;
+	size_t _totalOut = 0;
+};
+
+}
+
+#endif /* EXTRA_WEBSERVER_UNIX_SPWEBUNIXCOMPRESS_H_ */
@@ -31,6 +31,101 @@ static constexpr size_t UNIX_CLIENT_BUFFER_SIZE = 8_KiB;
 static constexpr size_t UNIX_MAX_REQUEST_LINE = 64_KiB;
 static constexpr size_t UNIX_MAX_HEADER_LINE = 64_KiB;
 
+// max number of memory buffers, written with single writev, should not exceed IOV_MAX
+static constexpr size_t UNIX_WRITE_IOV_MAX = 64;
+
+// max number of released clients, that each worker keeps for the new connections
+static constexpr size_t UNIX_CLIENT_FREE_LIST_SIZE = 256;
+
+// how long idle persistent connection can wait for the next request
+static constexpr auto UNIX_KEEPALIVE_TIMEOUT = 5_sec;
+
+// max number of requests, that can be served with single persistent connection
+static constexpr uint32_t UNIX_KEEPALIVE_MAX_REQUESTS = 100;
+
+// request line and headers should be received within this time after the first byte
+static constexpr auto UNIX_REQUEST_HEADER_TIMEOUT = 20_sec;
+
+// request body should be received with at least UNIX_REQUEST_BODY_MIN_RATE bytes per second,
+// rate is checked once per UNIX_REQUEST_BODY_TIMEOUT
+static constexpr auto UNIX_REQUEST_BODY_TIMEOUT = 20_sec;
+static constexpr size_t UNIX_REQUEST_BODY_MIN_RATE = 500;
+
+// how long client can not accept any of pending output
+static constexpr auto UNIX_WRITE_TIMEOUT = 60_sec;
+
+// max number of async tasks, performed by worker between network polls
+static constexpr uint32_t UNIX_TASK_BATCH = 16;
+
+// io_uring engine: submission queue size for the worker
+static constexpr uint32_t UNIX_URING_QUEUE_SIZE = 256;
+
+// io_uring engine: number of provided receive buffers for the worker, power of two
+static constexpr uint32_t UNIX_URING_BUFFERS = 256;
+
+// response, that grows beyond this size, is sent with chunked encoding instead of buffering
+static constexpr size_t UNIX_RESPONSE_STREAMING_THRESHOLD = 64_KiB;
+
+// max number of open files in cache for static responses
+static constexpr size_t UNIX_FILE_CACHE_SIZE = 1024;
+
+// how often cached file is checked, when inotify watch is not available
+static constexpr auto UNIX_FILE_CACHE_CHECK_INTERVAL = 1_sec;
+
+// Range request with more ranges than this is served as full response
+static constexpr size_t UNIX_MAX_BYTE_RANGES = 32;
+
+// raw file uploads larger than this are spliced from socket into the file (epoll engine only)
+static constexpr size_t UNIX_SPLICE_MIN_SIZE = 64_KiB;
+
+// capacity of the worker's splice pipe, one splice call moves at most this much
+static constexpr size_t UNIX_SPLICE_PIPE_SIZE = 256_KiB;
+
+// buffered responses smaller than this are not compressed
+static constexpr size_t UNIX_COMPRESSION_MIN_SIZE = 256;
+
+// static file is compressed into memory cache after this number of requests
+static constexpr uint32_t UNIX_STATIC_CACHE_HOT_HITS = 2;
+
+// limits for the static files cache: default size, max file size and number of tracked files
+static constexpr size_t UNIX_STATIC_CACHE_SIZE = 32_MiB;
+static constexpr size_t UNIX_STATIC_CACHE_MAX_FILE = 4_MiB;
+static constexpr size_t UNIX_STATIC_CACHE_MAX_TRACKED = 4096;
+
+// static files are compressed once, so we can use better compression than for responses
+static constexpr int UNIX_STATIC_COMPRESSION_QUALITY = 9;
+static constexpr int UNIX_STATIC_COMPRESSION_LGWIN = 22;
+
+// connections of the previous configuration are closed after this time on reload or upgrade
+static constexpr auto UNIX_DRAIN_TIMEOUT = 30_sec;
+
+// new process should start its workers within this time after the sockets were handed over
+static constexpr auto UNIX_HANDOVER_TIMEOUT = 10_sec;
+
+// max number of listening sockets in single SCM_RIGHTS message
+static constexpr size_t UNIX_HANDOVER_BATCH = 64;
+
+// environment variable with the descriptor of the socket, that delivers listening sockets to the new process
+static constexpr auto UNIX_HANDOVER_ENV = "STAPPLER_WEB_HANDOVER_FD";
+
+// HTTP/2: max number of concurrent streams for the connection, announced with SETTINGS
+static constexpr uint32_t UNIX_HTTP2_MAX_STREAMS = 128;
+
+// HTTP/2: receive window for the connection and every stream, request body is not buffered beyond it
+static constexpr size_t UNIX_HTTP2_WINDOW_SIZE = 1_MiB;
+
+// HTTP/2: max size of the compressed header block (HEADERS with CONTINUATION frames)
+static constexpr size_t UNIX_HTTP2_MAX_HEADER_BLOCK = 64_KiB;
+
+// admission control: queue delay stays above target for this time before requests are rejected by the target
+static const auto UNIX_QUEUE_DELAY_INTERVAL = TimeInterval::milliseconds(100);
+
+// Retry-After for the requests, rejected by admission control
+static constexpr auto UNIX_RETRY_AFTER = 1_sec;
+
+// resolution of the timer wheel for scheduled tasks and connection deadlines
+static const auto UNIX_TIMER_WHEEL_TICK = TimeInterval::milliseconds(10);
+
 }
 
 #endif /* EXTRA_WEBSERVER_UNIX_SPWEBUNIXCONFIG_H_ */
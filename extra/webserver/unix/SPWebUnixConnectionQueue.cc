@@ -22,15 +22,21 @@
 
 #include "SPWebUnixConnectionQueue.h"
 #include "SPWebUnixConnectionWorker.h"
+#include "SPWebUnixHandlerPool.h"
+#include "SPWebUnixTls.h"
 
 #include <sys/types.h>
-#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <sys/un.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/filter.h>
+#include <sched.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 
 namespace STAPPLER_VERSIONIZED stappler::web {
 
@@ -51,43 +57,59 @@ bool ConnectionQueue::setNonblocking(int fd) {
 ConnectionQueue::~ConnectionQueue() {
 	if (_pipe[0] > -1) { close(_pipe[0]); _pipe[0] = -1; }
 	if (_pipe[1] > -1) { close(_pipe[1]); _pipe[1] = -1; }
-	if (_eventFd > -1) { close(_eventFd); _eventFd = -1; }
-	if (_socket > -1) { close(_socket); _socket = -1; }
+	if (_timerFd > -1) { close(_timerFd); _timerFd = -1; }
+	if (_handoverFd > -1) { close(_handoverFd); _handoverFd = -1; }
+	for (auto &listener : _listeners) {
+		for (auto &it : listener) {
+			if (it > -1) { close(it); it = -1; }
+		}
+	}
+
+	for (auto &it : _socketPaths) {
+		filesystem::native::unlink_fn(it);
+	}
 
-	if (!_socketPath.empty()) {
-		filesystem::native::unlink_fn(_socketPath);
+	for (auto &it : _tls) {
+		if (it) {
+			delete it;
+		}
 	}
 }
 
 ConnectionQueue::ConnectionQueue(UnixRoot *r, pool_t *p, uint16_t w, UnixRoot::Config &&v)
-: _root(r), _originPool(p), _nWorkers(w), _config(move(v)) {
-	_eventFd = ::eventfd(0, EFD_NONBLOCK);
+: _root(r), _originPool(p), _nWorkers(w), _config(move(v))
+, _timers(Time::now(), config::UNIX_TIMER_WHEEL_TICK) {
+	_timerFd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
 	_taskCounter.store(0);
-
-	_inputQueue.setQueueLocking(_inputMutexQueue);
-	_inputQueue.setFreeLocking(_inputMutexFree);
 }
 
 bool ConnectionQueue::run() {
 	pool::context ctx(_originPool);
 
-	auto addr = StringView(_config.listen);
-	if (addr.starts_with("/")) {
-		_socket = openUnixSocket(addr);
-	} else if (addr.starts_with("unix:")) {
-		_socket = openUnixSocket(addr.sub("unix:"_len));
-	} else {
-		auto a = addr.readUntil<StringView::Chars<':'>>();
-		if (addr.is(':')) {
-			++ addr;
-			auto port = addr.readInteger(10).get(80);
-			_socket = openNetworkSocket(a, uint16_t(port));
+	_handoverFd = receiveSockets();
+
+	if (_config.pinWorkers) {
+		initCpus();
+	}
+
+	// sockets can be already bound by the previous process
+	if (_listeners.empty()) {
+		if (_config.listeners.empty()) {
+			UnixListenerConfig listener;
+			listener.address = _config.listen;
+			if (!openListener(listener)) {
+				return false;
+			}
 		} else {
-			_socket = openNetworkSocket(a, uint16_t(80));
+			for (auto &it : _config.listeners) {
+				if (!openListener(it)) {
+					return false;
+				}
+			}
 		}
 	}
 
-	if (_socket < 0) {
+	if (!initTls()) {
 		return false;
 	}
 
@@ -98,9 +120,32 @@ bool ConnectionQueue::run() {
 
 		retainSignals();
 
+		if (_config.heartbeatInterval) {
+			_heartbeatPool = pool::create(_originPool);
+
+			std::unique_lock lock(_timerMutex);
+			auto now = Time::now();
+			_timers.schedule(&_heartbeat, now + _config.heartbeatInterval);
+			updateTimer(now);
+		}
+
+		if (_config.handlerThreads > 0) {
+			_handlers = new (_originPool) UnixHandlerPool(_originPool, _config.handlerThreads,
+					_config.queueDelayTarget, _config.queueDelayInterval);
+		}
+
 		for (uint32_t i = 0; i < _nWorkers; i++) {
-			ConnectionWorker *worker = new (_originPool) ConnectionWorker(this, _root, _socket, _pipe[0], _eventFd);
+			// sockets in SO_REUSEPORT group are indexed in order of bind, so socket N belongs to worker N
+			Vector<int> sockets;
+			for (auto &it : _listeners) {
+				sockets.emplace_back(it[i % it.size()]);
+			}
+
+			// CPU steering program maps _cpus[N] to socket N, so worker N is pinned to the same CPU
+			ConnectionWorker *worker = new (_originPool) ConnectionWorker(this, _root, sockets,
+					_pipe[0], i, _cpus.empty() ? -1 : _cpus[i % _cpus.size()]);
 			_workers.push_back(worker);
+			_workersStarted = i + 1;
 		}
 		return true;
 	}
@@ -110,6 +155,12 @@ bool ConnectionQueue::run() {
 
 void ConnectionQueue::cancel() {
 	_finalized = true;
+
+	// handlers return processed requests to workers, so they should be stopped first
+	if (_handlers) {
+		_handlers->cancel();
+	}
+
 	if (::write(_pipe[1], "END!", 4) == 0) {
 		log::error("ConnectionQueue", "Fail to send finalization signal");
 	}
@@ -117,13 +168,281 @@ void ConnectionQueue::cancel() {
 	for (auto &it : _workers) {
 		if (it->thread().joinable()) {
 			it->thread().join();
-			delete it;
 		}
 	}
 
+	// workers can push tasks to each other until all of them are stopped
+	for (auto &it : _workers) {
+		it->getTasks().clear([&, this] (AsyncTask *task) {
+			releaseTask(task);
+		});
+		delete it;
+	}
+	_workersStarted = 0;
+	_workers.clear();
+
 	while (_sigCounter) {
 		releaseSignals();
 	}
+
+	// workers are stopped, scheduled tasks will never be performed
+	_timerMutex.lock();
+	_timers.clear([&, this] (TimerWheel::Node *node) {
+		if (node != &_heartbeat) {
+			releaseTask(static_cast<TimerTask *>(node)->task);
+		}
+	});
+	_timerMutex.unlock();
+}
+
+void ConnectionQueue::reload() {
+	auto nworkers = _workersStarted.load();
+	for (uint32_t i = 0; i < nworkers; ++ i) {
+		_workers[i]->wakeup();
+	}
+}
+
+bool ConnectionQueue::handover(SpanView<StringView> args) {
+	if (!_accepting || args.empty()) {
+		return false;
+	}
+
+	int sp[2] = { -1, -1 };
+	if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sp) != 0) {
+		log::error("ConnectionQueue", "Fail to create handover socket");
+		return false;
+	}
+
+	// only async-signal-safe calls are allowed after fork, so exec arguments are prepared before it
+	std::vector<std::string> argStrings;
+	std::vector<char *> argv;
+	for (auto &it : args) {
+		argStrings.emplace_back(it.data(), it.size());
+	}
+	for (auto &it : argStrings) {
+		argv.emplace_back(it.data());
+	}
+	argv.emplace_back(nullptr);
+
+	std::string envString = std::string(config::UNIX_HANDOVER_ENV) + "=" + std::to_string(sp[1]);
+	std::vector<char *> envp;
+	for (auto env = environ; *env; ++ env) {
+		if (!StringView(*env).starts_with(config::UNIX_HANDOVER_ENV)) {
+			envp.emplace_back(*env);
+		}
+	}
+	envp.emplace_back(envString.data());
+	envp.emplace_back(nullptr);
+
+	auto pid = ::fork();
+	if (pid == 0) {
+		// handover socket should survive exec
+		::fcntl(sp[1], F_SETFD, 0);
+		::execve(argv[0], argv.data(), envp.data());
+		::_exit(127);
+	}
+
+	::close(sp[1]);
+
+	if (pid < 0) {
+		log::error("ConnectionQueue", "Fail to fork new process");
+		::close(sp[0]);
+		return false;
+	}
+
+	bool success = false;
+	if (sendSockets(sp[0])) {
+		// wait until new process starts its workers, or closes socket on failure
+		struct pollfd fd;
+		fd.fd = sp[0];
+		fd.events = POLLIN;
+		fd.revents = 0;
+
+		char buf[2] = { 0 };
+		if (::poll(&fd, 1, int(config::UNIX_HANDOVER_TIMEOUT.toMicros() / 1000)) == 1
+				&& ::read(sp[0], buf, 2) == 2 && memcmp(buf, "OK", 2) == 0) {
+			success = true;
+		} else {
+			log::error("ConnectionQueue", "New process failed to start with handed over sockets");
+		}
+	}
+
+	::close(sp[0]);
+
+	if (success) {
+		stopAccept();
+	}
+	return success;
+}
+
+void ConnectionQueue::completeHandover() {
+	if (_handoverFd < 0) {
+		return;
+	}
+
+	// previous process can stop accepting now
+	if (::write(_handoverFd, "OK", 2) != 2) {
+		log::error("ConnectionQueue", "Fail to notify previous process");
+	}
+	close(_handoverFd);
+	_handoverFd = -1;
+}
+
+int ConnectionQueue::receiveSockets() {
+	auto env = ::getenv(config::UNIX_HANDOVER_ENV);
+	if (!env) {
+		return -1;
+	}
+
+	auto fd = int(StringView(env).readInteger(10).get(-1));
+
+	// processes, spawned by this one, should not see our socket
+	::unsetenv(config::UNIX_HANDOVER_ENV);
+
+	if (fd < 0) {
+		return -1;
+	}
+
+	Vector<int> sockets;
+	uint32_t total = 0;
+	do {
+		char control[CMSG_SPACE(sizeof(int) * config::UNIX_HANDOVER_BATCH)];
+		memset(control, 0, sizeof(control));
+
+		struct iovec iov;
+		iov.iov_base = &total;
+		iov.iov_len = sizeof(total);
+
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		if (::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC) != sizeof(total) || (msg.msg_flags & MSG_CTRUNC)) {
+			log::error("ConnectionQueue", "Fail to receive sockets from previous process");
+			for (auto &it : sockets) {
+				close(it);
+			}
+			sockets.clear();
+			break;
+		}
+
+		for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+				auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+				for (size_t i = 0; i < count; ++ i) {
+					int sock = -1;
+					memcpy(&sock, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+					sockets.emplace_back(sock);
+				}
+			}
+		}
+	} while (sockets.size() < total);
+
+	// sockets of the same SO_REUSEPORT group are bound to the same address, and were sent in order of bind
+	Vector<Bytes> addresses;
+	for (auto &sock : sockets) {
+		struct sockaddr_storage addr;
+		socklen_t len = sizeof(addr);
+		memset(&addr, 0, sizeof(addr));
+		if (::getsockname(sock, (struct sockaddr *)&addr, &len) != 0) {
+			log::error("ConnectionQueue", "Fail to read address of the received socket");
+			close(sock);
+			continue;
+		}
+
+		auto key = Bytes((const uint8_t *)&addr, (const uint8_t *)&addr + len);
+		auto it = std::find(addresses.begin(), addresses.end(), key);
+		if (it != addresses.end()) {
+			_listeners[it - addresses.begin()].emplace_back(sock);
+			continue;
+		}
+
+		addresses.emplace_back(move(key));
+		_listeners.emplace_back(Vector<int>{ sock });
+
+		if (addr.ss_family == AF_UNIX) {
+			// socket file should be removed by the last process, that uses it
+			_socketPaths.emplace_back(StringView(((struct sockaddr_un *)&addr)->sun_path).pdup(_originPool));
+		}
+	}
+
+	return fd;
+}
+
+bool ConnectionQueue::sendSockets(int fd) {
+	Vector<int> sockets;
+	for (auto &it : _listeners) {
+		sockets.insert(sockets.end(), it.begin(), it.end());
+	}
+
+	// number of descriptors in single message is limited, so sockets are sent in batches
+	uint32_t total = uint32_t(sockets.size());
+	for (size_t offset = 0; offset < sockets.size(); offset += config::UNIX_HANDOVER_BATCH) {
+		auto count = std::min(sockets.size() - offset, config::UNIX_HANDOVER_BATCH);
+
+		char control[CMSG_SPACE(sizeof(int) * config::UNIX_HANDOVER_BATCH)];
+		memset(control, 0, sizeof(control));
+
+		struct iovec iov;
+		iov.iov_base = &total;
+		iov.iov_len = sizeof(total);
+
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+		auto cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+		memcpy(CMSG_DATA(cmsg), sockets.data() + offset, sizeof(int) * count);
+
+		if (::sendmsg(fd, &msg, MSG_NOSIGNAL) != sizeof(total)) {
+			log::error("ConnectionQueue", "Fail to send sockets to new process");
+			return false;
+		}
+	}
+	return true;
+}
+
+void ConnectionQueue::stopAccept() {
+	_accepting = false;
+
+	// socket files are used by the new process now
+	_socketPaths.clear();
+
+	auto nworkers = _workersStarted.load();
+	for (uint32_t i = 0; i < nworkers; ++ i) {
+		_workers[i]->wakeup();
+	}
+}
+
+size_t ConnectionQueue::getConnectionsCount() const {
+	size_t ret = 0;
+	auto nworkers = _workersStarted.load();
+	for (uint32_t i = 0; i < nworkers; ++ i) {
+		ret += _workers[i]->getConnectionsCount();
+	}
+	return ret;
+}
+
+UnixEngine ConnectionQueue::getEngine() const {
+	auto nworkers = _workersStarted.load();
+	if (nworkers == 0) {
+		return UnixEngine::Epoll;
+	}
+	for (uint32_t i = 0; i < nworkers; ++ i) {
+		if (_workers[i]->getEngine() != UnixEngine::Uring) {
+			return UnixEngine::Epoll;
+		}
+	}
+	return UnixEngine::Uring;
 }
 
 void ConnectionQueue::retainSignals() {
@@ -167,24 +486,35 @@ void ConnectionQueue::pushTask(AsyncTask *task) {
 	if (auto g = task->getGroup()) {
 		g->onAdded(task);
 	}
-	uint64_t value = 1;
-
-	_inputQueue.push(task->getPriority(), false, task);
 
 	++ _taskCounter;
-	if (::write(_eventFd, &value, sizeof(uint64_t)) == 0) {
-		log::error("ConnectionQueue", "Fail to push event to eventfd");
-	}
+	enqueueTask(task);
 }
 
-AsyncTask * ConnectionQueue::popTask() {
-	AsyncTask *task = nullptr;
+AsyncTask * ConnectionQueue::popTask(ConnectionWorker *worker) {
+	if (auto task = worker->getTasks().pop()) {
+		return task;
+	}
 
-	_inputQueue.pop_direct([&] (int32_t, AsyncTask *t) {
-		task = t;
-	});
+	// start from the next worker, so thieves are not competing for the same deque
+	auto nworkers = _workersStarted.load();
+	for (uint32_t i = 1; i < nworkers; ++ i) {
+		if (auto task = _workers[(worker->getIndex() + i) % nworkers]->getTasks().steal()) {
+			return task;
+		}
+	}
 
-	return task;
+	return nullptr;
+}
+
+bool ConnectionQueue::hasQueuedTasks() const {
+	auto nworkers = _workersStarted.load();
+	for (uint32_t i = 0; i < nworkers; ++ i) {
+		if (!_workers[i]->getTasks().empty()) {
+			return true;
+		}
+	}
+	return false;
 }
 
 void ConnectionQueue::releaseTask(AsyncTask *task) {
@@ -200,7 +530,228 @@ bool ConnectionQueue::hasTasks() {
 	return _taskCounter.load();
 }
 
-int ConnectionQueue::openUnixSocket(StringView addr) {
+void ConnectionQueue::scheduleTask(AsyncTask *task, TimeInterval ival) {
+	if (!ival) {
+		pushTask(task);
+		return;
+	}
+
+	if (auto g = task->getGroup()) {
+		g->onAdded(task);
+	}
+
+	++ _taskCounter;
+
+	auto now = Time::now();
+	task->setScheduled(now + ival);
+
+	auto node = new (task->pool()) TimerTask;
+	node->task = task;
+
+	std::unique_lock lock(_timerMutex);
+	_timers.schedule(node, task->getScheduled());
+	updateTimer(now);
+}
+
+void ConnectionQueue::processTimers() {
+	uint64_t value = 0;
+	if (::read(_timerFd, &value, sizeof(uint64_t)) != sizeof(uint64_t)) {
+		// timer was already processed by another worker
+		return;
+	}
+
+	std::vector<AsyncTask *> tasks;
+	bool heartbeat = false;
+
+	_timerMutex.lock();
+	auto now = Time::now();
+	_timers.advance(now, [&, this] (TimerWheel::Node *node) {
+		if (node == &_heartbeat) {
+			heartbeat = true;
+		} else {
+			tasks.emplace_back(static_cast<TimerTask *>(node)->task);
+		}
+	});
+	_timerArmed = Time();
+	updateTimer(now);
+	_timerMutex.unlock();
+
+	for (auto &it : tasks) {
+		enqueueTask(it);
+	}
+
+	if (heartbeat && !_finalized) {
+		_root->handleHeartbeat(_heartbeatPool);
+		pool::clear(_heartbeatPool);
+
+		// next heartbeat is counted from the end of the current one, so they never overlap
+		std::unique_lock lock(_timerMutex);
+		now = Time::now();
+		_timers.schedule(&_heartbeat, now + _config.heartbeatInterval);
+		updateTimer(now);
+	}
+}
+
+void ConnectionQueue::enqueueTask(AsyncTask *task) {
+	auto nworkers = _workersStarted.load();
+	if (nworkers == 0) {
+		log::error("ConnectionQueue", "No workers to perform task");
+		releaseTask(task);
+		return;
+	}
+
+	auto current = ConnectionWorker::getCurrent();
+	if (current && current->getQueue() != this) {
+		current = nullptr;
+	}
+
+	// task from worker stays on it, external tasks are distributed in round-robin
+	auto target = current ? current : _workers[_nextWorker++ % nworkers];
+	target->getTasks().push(task);
+
+	if (target != current && target->wakeupIdle()) {
+		return;
+	}
+
+	// target is busy, wake only one of the idle workers to steal the task
+	for (uint32_t i = 1; i < nworkers; ++ i) {
+		if (_workers[(target->getIndex() + i) % nworkers]->wakeupIdle()) {
+			break;
+		}
+	}
+}
+
+void ConnectionQueue::updateTimer(Time now) {
+	auto next = _timers.getNextTime();
+	if (next == _timerArmed) {
+		return;
+	}
+
+	_timerArmed = next;
+
+	struct itimerspec spec;
+	memset(&spec, 0, sizeof(spec));
+
+	if (!_timers.empty()) {
+		// zero value disarms timer, so use at least 1 microsecond
+		auto delta = std::max(uint64_t((next > now) ? (next - now).toMicros() : 0), uint64_t(1));
+		spec.it_value.tv_sec = delta / 1'000'000;
+		spec.it_value.tv_nsec = (delta % 1'000'000) * 1'000;
+	}
+
+	if (::timerfd_settime(_timerFd, 0, &spec, nullptr) != 0) {
+		log::error("ConnectionQueue", "Fail to arm timerfd");
+	}
+}
+
+UnixTlsContext *ConnectionQueue::getTlsContext(size_t listener) const {
+	return listener < _tls.size() ? _tls[listener] : nullptr;
+}
+
+bool ConnectionQueue::hasTlsListeners() const {
+	for (auto &it : _tls) {
+		if (it) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ConnectionQueue::initTls() {
+	_tls.resize(_listeners.size(), nullptr);
+
+	size_t ntls = 0;
+	for (auto &it : _config.listeners) {
+		if (!it.certificate.empty() && !it.privateKey.empty()) {
+			++ ntls;
+		}
+	}
+
+	if (ntls == 0) {
+		return true;
+	}
+
+	// sockets from the previous process are grouped in the order of its listeners,
+	// so they can be matched with the configuration only by index
+	if (_config.listeners.size() != _listeners.size()) {
+		log::error("ConnectionQueue", "Listeners do not match configuration, TLS is not available");
+		return false;
+	}
+
+	// in reverse order, so failed listeners can be removed without breaking indexes of the rest
+	for (size_t i = _config.listeners.size(); i > 0; -- i) {
+		auto &cfg = _config.listeners[i - 1];
+		if (cfg.certificate.empty() || cfg.privateKey.empty()) {
+			continue;
+		}
+
+		_tls[i - 1] = UnixTlsContext::create(_originPool, cfg.certificate, cfg.privateKey);
+		if (!_tls[i - 1]) {
+			// build without kTLS or invalid certificate: connections can not be served over TLS on this listener,
+			// so it's closed, and other listeners are still served
+			log::error("ConnectionQueue", "Fail to init TLS for ", cfg.address, ", listener is disabled");
+			for (auto &it : _listeners[i - 1]) {
+				::close(it);
+			}
+			_listeners.erase(_listeners.begin() + (i - 1));
+			_tls.erase(_tls.begin() + (i - 1));
+		}
+	}
+
+	if (_listeners.empty()) {
+		log::error("ConnectionQueue", "No listeners available");
+		return false;
+	}
+
+	if (_config.engine == UnixEngine::Uring && hasTlsListeners()) {
+		log::error("ConnectionQueue", "TLS handshake is performed with epoll, io_uring engine is disabled");
+	}
+
+	return true;
+}
+
+bool ConnectionQueue::openListener(const UnixListenerConfig &cfg) {
+	auto addr = cfg.address;
+	if (addr.starts_with("/") || addr.starts_with("unix:")) {
+		if (addr.starts_with("unix:")) {
+			addr = addr.sub("unix:"_len);
+		}
+
+		auto sock = openUnixSocket(addr, cfg.backlog);
+		if (sock < 0) {
+			return false;
+		}
+
+		_listeners.emplace_back(Vector<int>{ sock });
+		return true;
+	}
+
+	Vector<int> sockets;
+	auto nsockets = _config.reusePort ? _nWorkers : 1;
+	for (uint32_t i = 0; i < nsockets; ++ i) {
+		auto sock = openNetworkSocket(cfg, _config.reusePort);
+		if (sock < 0) {
+			break;
+		}
+		sockets.emplace_back(sock);
+	}
+
+	if (sockets.size() != nsockets) {
+		for (auto &it : sockets) {
+			close(it);
+		}
+		return false;
+	}
+
+	if (_config.reusePort && _config.pinWorkers && _config.cpuSteering) {
+		attachCpuSteering(sockets.front(), nsockets);
+	}
+
+	_listeners.emplace_back(move(sockets));
+	return true;
+}
+
+int ConnectionQueue::openUnixSocket(StringView addr, int backlog) {
 	if (filesystem::native::access_fn(addr, filesystem::Access::Exists)) {
 		// try unlink;
 		if (!filesystem::native::unlink_fn(addr)) {
@@ -240,22 +791,66 @@ int ConnectionQueue::openUnixSocket(StringView addr) {
 		return -1;
 	}
 
-	if (::listen(socket, SOMAXCONN) < 0) {
+	if (::listen(socket, backlog > 0 ? backlog : SOMAXCONN) < 0) {
 		log::error("Root:Socket", "Fail to listen on socket: ", addr);
 		filesystem::native::unlink_fn(addr);
 		close(socket);
 		return -1;
 	}
 
-	_socketPath = addr;
+	_socketPaths.emplace_back(addr);
 
 	return socket;
 }
 
-int ConnectionQueue::openNetworkSocket(StringView addr, uint16_t port) {
-	int socket = ::socket(AF_INET, SOCK_STREAM, 0);
+int ConnectionQueue::openNetworkSocket(const UnixListenerConfig &cfg, bool reusePort) {
+	// "[ipv6]:port" or "ipv4:port"
+	auto addr = cfg.address;
+	StringView host;
+	if (addr.is('[')) {
+		++ addr;
+		host = addr.readUntil<StringView::Chars<']'>>();
+		if (addr.is(']')) {
+			++ addr;
+		}
+	} else {
+		host = addr.readUntil<StringView::Chars<':'>>();
+	}
+
+	uint16_t port = 80;
+	if (addr.is(':')) {
+		++ addr;
+		port = uint16_t(addr.readInteger(10).get(80));
+	}
+
+	struct sockaddr_storage sockaddr;
+	socklen_t sockaddrLen = 0;
+	memset(&sockaddr, 0, sizeof(sockaddr));
+
+	auto hostStr = host.str<Interface>();
+	auto in = (struct sockaddr_in *)&sockaddr;
+	auto in6 = (struct sockaddr_in6 *)&sockaddr;
+	if (host.empty()) {
+		in->sin_family = AF_INET;
+		in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		in->sin_port = htons(port);
+		sockaddrLen = sizeof(struct sockaddr_in);
+	} else if (::inet_pton(AF_INET, hostStr.data(), &in->sin_addr) == 1) {
+		in->sin_family = AF_INET;
+		in->sin_port = htons(port);
+		sockaddrLen = sizeof(struct sockaddr_in);
+	} else if (::inet_pton(AF_INET6, hostStr.data(), &in6->sin6_addr) == 1) {
+		in6->sin6_family = AF_INET6;
+		in6->sin6_port = htons(port);
+		sockaddrLen = sizeof(struct sockaddr_in6);
+	} else {
+		log::error("Root:Socket", "Invalid listen address: ", cfg.address);
+		return -1;
+	}
+
+	int socket = ::socket(sockaddr.ss_family, SOCK_STREAM, 0);
 	if (socket == -1) {
-		log::error("Root:Socket", "Fail to open socket");
+		log::error("Root:Socket", "Fail to open socket: ", cfg.address);
 		return -1;
 	}
 
@@ -266,29 +861,102 @@ int ConnectionQueue::openNetworkSocket(StringView addr, uint16_t port) {
 		return -1;
 	}
 
-	struct sockaddr_in sockaddr;
-	memset(&addr, 0, sizeof(addr));
-	sockaddr.sin_family = AF_INET;
-	sockaddr.sin_addr.s_addr = !addr.empty() ? inet_addr(addr.data()) : htonl(INADDR_LOOPBACK);
-	sockaddr.sin_port = htons(port);
-	if (::bind(socket, (struct sockaddr *) &sockaddr, sizeof(sockaddr)) < 0) {
-		log::error("Root:Socket", "Fail to bind socket");
+	if (reusePort && setsockopt(socket, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == -1) {
+		log::error("Root:Socket", "Fail to set SO_REUSEPORT");
+		close(socket);
+		return -1;
+	}
+
+	if (sockaddr.ss_family == AF_INET6) {
+		// dual-stack socket accepts IPv4 connections as IPv4-mapped addresses
+		int v6only = cfg.ipv6Only ? 1 : 0;
+		if (setsockopt(socket, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only)) == -1) {
+			log::error("Root:Socket", "Fail to set IPV6_V6ONLY: ", cfg.address);
+		}
+	}
+
+	if (::bind(socket, (struct sockaddr *) &sockaddr, sockaddrLen) < 0) {
+		log::error("Root:Socket", "Fail to bind socket: ", cfg.address);
 		close(socket);
 		return -1;
 	}
 
 	if (!setNonblocking(socket)) {
-		log::error("Root:Socket", "Fail to set socket nonblock");
+		log::error("Root:Socket", "Fail to set socket nonblock: ", cfg.address);
 		close(socket);
 		return -1;
 	}
 
-	if (::listen(socket, SOMAXCONN) < 0) {
-		log::error("Root:Socket", "Fail to listen on socket");
+	// options below are optimizations, server works without them
+	if (cfg.deferAccept) {
+		// worker is woken up only when request data has arrived
+		int timeout = std::max(int((cfg.deferAccept.toMicros() + 999'999) / 1'000'000), 1);
+		if (setsockopt(socket, IPPROTO_TCP, TCP_DEFERACCEPT, &timeout, sizeof(timeout)) == -1) {
+			log::error("Root:Socket", "Fail to set TCP_DEFERACCEPT: ", cfg.address);
+		}
+	}
+
+	if (cfg.fastOpen) {
+		// request can be sent with SYN, saving a round trip for the repeating clients
+		int qlen = int(cfg.fastOpen);
+		if (setsockopt(socket, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen)) == -1) {
+			log::error("Root:Socket", "Fail to set TCP_FASTOPEN: ", cfg.address);
+		}
+	}
+
+	if (::listen(socket, cfg.backlog > 0 ? cfg.backlog : SOMAXCONN) < 0) {
+		log::error("Root:Socket", "Fail to listen on socket: ", cfg.address);
 		close(socket);
 		return -1;
 	}
 	return socket;
 }
 
+void ConnectionQueue::initCpus() {
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	if (::sched_getaffinity(0, sizeof(cpu_set_t), &cpuset) != 0) {
+		log::error("ConnectionQueue", "Fail to read CPU affinity, workers are not pinned");
+		return;
+	}
+
+	for (int i = 0; i < CPU_SETSIZE; ++ i) {
+		if (CPU_ISSET(i, &cpuset)) {
+			_cpus.emplace_back(i);
+		}
+	}
+}
+
+bool ConnectionQueue::attachCpuSteering(int socket, uint32_t nsockets) {
+	// every CPU should have exactly one worker, otherwise some workers would never receive connections,
+	// or connection would be steered to the worker on the other CPU
+	if (_cpus.empty() || _cpus.size() != nsockets || _cpus.size() > (BPF_MAXINSNS - 2) / 2) {
+		log::error("Root:Socket", "CPU steering requires one worker for every CPU of the process affinity (",
+				_cpus.size(), " CPU, ", nsockets, " workers), steering is disabled");
+		return false;
+	}
+
+	// select socket N in reuseport group for _cpus[N], sockets are indexed in order of bind;
+	// out-of-range result for other CPUs falls back to hash-based distribution
+	Vector<struct sock_filter> code;
+	code.reserve(_cpus.size() * 2 + 2);
+	code.emplace_back(sock_filter{ BPF_LD | BPF_W | BPF_ABS, 0, 0, uint32_t(SKF_AD_OFF + SKF_AD_CPU) });
+	for (uint32_t i = 0; i < _cpus.size(); ++ i) {
+		code.emplace_back(sock_filter{ BPF_JMP | BPF_JEQ | BPF_K, 0, 1, uint32_t(_cpus[i]) });
+		code.emplace_back(sock_filter{ BPF_RET | BPF_K, 0, 0, i });
+	}
+	code.emplace_back(sock_filter{ BPF_RET | BPF_K, 0, 0, nsockets });
+
+	struct sock_fprog prog;
+	prog.len = uint16_t(code.size());
+	prog.filter = code.data();
+
+	if (setsockopt(socket, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == -1) {
+		// not fatal, kernel uses hash-based distribution
+		log::error("Root:Socket", "Fail to attach SO_ATTACH_REUSEPORT_CBPF program");
+		return false;
+	}
+	return true;
+}
+
 }
@@ -24,13 +24,16 @@
 #define EXTRA_WEBSERVER_UNIX_SPWEBUNIXCONNECTIONQUEUE_H_
 
 #include "SPWebUnixRoot.h"
-#include "SPMemPriorityQueue.h"
+#include "SPWebUnixTimerWheel.h"
+#include "SPWebUnixTaskQueue.h"
 
 #include <signal.h>
 
 namespace STAPPLER_VERSIONIZED stappler::web {
 
 class ConnectionWorker;
+class UnixHandlerPool;
+class UnixTlsContext;
 
 class SP_PUBLIC ConnectionQueue : public AllocBase {
 public:
@@ -43,6 +46,18 @@ public:
 	bool run();
 	void cancel();
 
+	// notify workers, that hosts were replaced
+	void reload();
+
+	// start new process with args, pass listening sockets to it, then stop accepting connections
+	bool handover(SpanView<StringView> args);
+
+	// notify previous process, that hosts are ready, when sockets were received from it
+	void completeHandover();
+
+	// false when listening sockets were handed over to the new process
+	bool isAccepting() const { return _accepting.load(); }
+
 	void retainSignals();
 	void releaseSignals();
 
@@ -51,16 +66,73 @@ public:
 	void finalize();
 
 	void pushTask(AsyncTask *);
-	AsyncTask * popTask();
 	void releaseTask(AsyncTask *);
 
+	// task from worker's own deque, or stolen from another worker
+	AsyncTask * popTask(ConnectionWorker *);
+
+	// any of the workers has task, that waits to be performed
+	bool hasQueuedTasks() const;
+
+	// task is pushed into queue when interval expires
+	void scheduleTask(AsyncTask *, TimeInterval);
+
+	// called by worker, when timer fd is signaled
+	void processTimers();
+
+	int getTimerFd() const { return _timerFd; }
+
 	bool hasTasks();
 
 	size_t getWorkersCount() const { return _workers.size(); }
 
+	size_t getConnectionsCount() const;
+
+	// Uring only if every started worker runs io_uring
+	UnixEngine getEngine() const;
+
+	// nullptr if requests are processed by I/O workers
+	UnixHandlerPool *getHandlerPool() const { return _handlers; }
+
+	const UnixRoot::Config &getConfig() const { return _config; }
+
+	// nullptr for the plaintext listener
+	UnixTlsContext *getTlsContext(size_t listener) const;
+
+	bool hasTlsListeners() const;
+
 protected:
-	int openUnixSocket(StringView);
-	int openNetworkSocket(StringView, uint16_t port);
+	struct TimerTask : TimerWheel::Node {
+		AsyncTask *task = nullptr;
+	};
+
+	void enqueueTask(AsyncTask *);
+
+	// rearm timer fd for the next wheel tick, should be called with timer mutex locked
+	void updateTimer(Time now);
+
+	// sockets from the previous process, when it was started with handover,
+	// returns descriptor to notify previous process, when workers are started
+	int receiveSockets();
+	bool sendSockets(int fd);
+
+	// workers stop accepting connections, and drain existing ones
+	void stopAccept();
+
+	// open sockets for the listener, one or one per worker with reusePort
+	bool openListener(const UnixListenerConfig &);
+
+	int openUnixSocket(StringView, int backlog);
+	int openNetworkSocket(const UnixListenerConfig &, bool reusePort);
+
+	// CPUs from the process affinity mask, worker N is pinned to _cpus[N % size]
+	void initCpus();
+
+	bool attachCpuSteering(int socket, uint32_t nsockets);
+
+	// TLS contexts for the listeners from the configuration, in the same order;
+	// listener, that can not be served over TLS, is closed and removed, returns false if no listeners left
+	bool initTls();
 
 	UnixRoot *_root = nullptr;
 
@@ -70,21 +142,34 @@ protected:
 	UnixRoot::Config _config;
 
 	std::atomic<bool> _finalized;
+	std::atomic<bool> _accepting = true;
 	std::atomic<int32_t> _refCount = 1;
 
 	Vector<ConnectionWorker *> _workers;
+	Vector<int> _cpus;
+	UnixHandlerPool *_handlers = nullptr;
+
+	// workers are started while the list is filled, so they see only this many of them
+	std::atomic<uint32_t> _workersStarted = 0;
 
 	std::atomic<size_t> _taskCounter;
-	memory::PriorityQueue<AsyncTask *> _inputQueue;
-	std::mutex _inputMutexQueue;
-	std::mutex _inputMutexFree;
+	std::atomic<uint32_t> _nextWorker = 0;
 	std::thread _thread;
 
 	int _pipe[2] = { -1, -1 };
-	int _eventFd = -1;
-	int _socket = -1;
+	int _timerFd = -1;
+	int _handoverFd = -1;
+	// for every listener: single shared socket or one socket per worker with SO_REUSEPORT
+	Vector<Vector<int>> _listeners;
+	Vector<UnixTlsContext *> _tls;
 	Time _start = Time::now();
 
+	std::mutex _timerMutex;
+	TimerWheel _timers;
+	Time _timerArmed;
+	TimerWheel::Node _heartbeat;
+	pool_t *_heartbeatPool = nullptr;
+
 	uint32_t _sigCounter = 0;
 	struct sigaction _sharedSigAction;
 	struct sigaction _sharedSigOldUsr1Action;
@@ -92,7 +177,7 @@ protected:
 	struct sigaction _sharedSigOldPipeAction;
 	sigset_t _oldmask;
 
-	StringView _socketPath;
+	Vector<StringView> _socketPaths;
 };
 
 }
@@ -24,7 +24,12 @@
 #include "SPWebUnixConfig.h"
 #include "SPWebUnixConnectionWorker.h"
 #include "SPWebUnixConnectionQueue.h"
+#include "SPWebUnixHandlerPool.h"
+#include "SPWebUnixHttp2.h"
 #include "SPWebUnixRequest.h"
+#include "SPWebUnixTls.h"
+#include "SPWebUnixUring.h"
+#include "SPWebUnixWebsocket.h"
 #include "SPWebRequestFilter.h"
 #include "SPWebInputFilter.h"
 
@@ -32,6 +37,8 @@
 #include <sys/eventfd.h>
 #include <sys/ioctl.h>
 #include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <sys/un.h>
 #include <sys/socket.h>
@@ -39,6 +46,8 @@
 #include <netinet/in.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
 
 namespace STAPPLER_VERSIONIZED stappler::web {
 
@@ -77,11 +86,63 @@ static StringView s_getSignalName(int sig) {
 	return StringView();
 }
 
-ConnectionWorker::ConnectionWorker(ConnectionQueue *queue, UnixRoot *h, int socket, int pipe, int event)
+static thread_local ConnectionWorker *tl_currentWorker = nullptr;
+
+ConnectionWorker *ConnectionWorker::getCurrent() {
+	return tl_currentWorker;
+}
+
+StringView ConnectionWorker::getPeerAddress(const struct sockaddr_storage &addr, char *buf, size_t bufSize, uint16_t &port) {
+	buf[0] = 0;
+	port = 0;
+
+	switch (addr.ss_family) {
+	case AF_INET: {
+		auto in = (const struct sockaddr_in *)&addr;
+		inet_ntop(AF_INET, &in->sin_addr, buf, bufSize);
+		port = ntohs(in->sin_port);
+		break;
+	}
+	case AF_INET6: {
+		auto in6 = (const struct sockaddr_in6 *)&addr;
+		if (IN6_IS_ADDR_V4MAPPED(&in6->sin6_addr)) {
+			inet_ntop(AF_INET, &in6->sin6_addr.s6_addr[12], buf, bufSize);
+		} else {
+			inet_ntop(AF_INET6, &in6->sin6_addr, buf, bufSize);
+		}
+		port = ntohs(in6->sin6_port);
+		break;
+	}
+	default:
+		// unix socket peers have no address
+		break;
+	}
+
+	return StringView(buf);
+}
+
+ConnectionWorker::ConnectionWorker(ConnectionQueue *queue, UnixRoot *h, SpanView<int> sockets, int pipe, uint32_t index, int cpu)
 : _queue(queue), _root(h)
-, _inputClient(socket, EPOLLIN | EPOLLEXCLUSIVE)
 , _cancelClient(pipe, EPOLLIN | EPOLLET)
-, _eventClient(event, EPOLLIN | EPOLLET | EPOLLEXCLUSIVE) {
+, _wakeupClient(-1, EPOLLIN | EPOLLET)
+, _timerClient(queue->getTimerFd(), EPOLLIN | EPOLLET | EPOLLEXCLUSIVE)
+, _notifyClient(h->getFileCache() ? h->getFileCache()->getNotify() : -1, EPOLLIN | EPOLLET | EPOLLEXCLUSIVE)
+, _keepAliveTimeout(queue->getConfig().keepAliveTimeout)
+, _keepAliveMaxRequests(queue->getConfig().keepAliveMaxRequests)
+, _requestHeaderTimeout(queue->getConfig().requestHeaderTimeout)
+, _requestBodyTimeout(queue->getConfig().requestBodyTimeout)
+, _requestBodyMinRate(queue->getConfig().requestBodyMinRate)
+, _writeTimeout(queue->getConfig().writeTimeout)
+, _http2(queue->getConfig().http2)
+, _retryAfter(queue->getConfig().retryAfter)
+, _deadlines(Time::now(), config::UNIX_TIMER_WHEEL_TICK) {
+	_index = index;
+	_cpu = cpu;
+	for (size_t i = 0; i < sockets.size(); ++ i) {
+		auto &client = _inputClients.emplace_back(sockets[i], EPOLLIN | EPOLLEXCLUSIVE);
+		client.listener = true;
+		client.tlsContext = queue->getTlsContext(i);
+	}
 	run(thread::ThreadFlags::Joinable);
 	_queue->retain();
 }
@@ -93,17 +154,54 @@ ConnectionWorker::~ConnectionWorker() {
 void ConnectionWorker::threadInit() {
 	Thread::threadInit();
 
+	tl_currentWorker = this;
+
+	// child of the thread pool, released with it
+	_compressionPool = pool::create(thread::ThreadInfo::getThreadInfo()->threadPool);
+
+	if (_cpu >= 0) {
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		CPU_SET(_cpu, &cpuset);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0) {
+			log::error("ConnectionWorker", "Fail to pin worker to CPU ", _cpu);
+		}
+	}
+
 	sigset_t sigset;
 	sigfillset(&sigset);
 
 	_signalFd = ::signalfd(-1, &sigset, 0);
 	ConnectionQueue::setNonblocking(_signalFd);
 
-	_epollFd = epoll_create1(0);
+	_wakeupClient.fd = ::eventfd(0, EFD_NONBLOCK);
+
+	// TLS handshake is performed on the ready socket, so it requires epoll
+	if (_queue->getConfig().engine == UnixEngine::Uring && !_queue->hasTlsListeners()) {
+		_uring = new UringQueue;
+		if (!_uring->init(config::UNIX_URING_QUEUE_SIZE, config::UNIX_URING_BUFFERS, config::UNIX_CLIENT_BUFFER_SIZE)) {
+			log::error("ConnectionWorker", "io_uring is not available, fallback to epoll");
+			delete _uring;
+			_uring = nullptr;
+		} else {
+			_engine = UnixEngine::Uring;
+		}
+	}
+
+	if (!_uring) {
+		_epollFd = epoll_create1(0);
+
+		// io_uring reads socket with multishot recv, so splice is used only with epoll
+		openSplicePipe();
+	}
 
-	addClient(_inputClient);
+	for (auto &it : _inputClients) {
+		addClient(it);
+	}
 	addClient(_cancelClient);
-	addClient(_eventClient);
+	addClient(_wakeupClient);
+	addClient(_timerClient);
+	addClient(_notifyClient);
 }
 
 void ConnectionWorker::threadDispose() {
@@ -111,10 +209,20 @@ void ConnectionWorker::threadDispose() {
 		close(_signalFd);
 		_signalFd = -1;
 	}
+	if (_wakeupClient.fd >= 0) {
+		close(_wakeupClient.fd);
+		_wakeupClient.fd = -1;
+	}
 	if (_epollFd >= 0) {
 		close(_epollFd);
 		_epollFd = -1;
 	}
+	if (_uring) {
+		delete _uring;
+		_uring = nullptr;
+	}
+	closeSplicePipe();
+	tl_currentWorker = nullptr;
 }
 
 bool ConnectionWorker::worker() {
@@ -122,7 +230,7 @@ bool ConnectionWorker::worker() {
 		return false;
 	}
 
-	while (poll(_epollFd)) {
+	while (_uring ? pollUring() : poll(_epollFd)) {
 		struct signalfd_siginfo si;
 		int nr = ::read(_signalFd, &si, sizeof si);
 		while (nr == sizeof si) {
@@ -140,82 +248,60 @@ bool ConnectionWorker::poll(int epollFd) {
 	std::array<struct epoll_event, ConnectionWorker::MaxEvents> _events;
 
 	while (!_shouldClose) {
-		int nevents = epoll_wait(epollFd, _events.data(), ConnectionWorker::MaxEvents, -1);
+		int nevents = epoll_wait(epollFd, _events.data(), ConnectionWorker::MaxEvents, performTasks());
+		_idle = false;
+
 		if (nevents == -1 && errno != EINTR) {
 			char buf[256] = { 0 };
 			log::error("ConnectionWorker", "epoll_wait() failed with errno ", errno, " (", strerror_r(errno, buf, 255), ")");
 			return false;
-		} else if (errno == EINTR) {
+		} else if (nevents == -1) {
 			return true;
 		}
 
-		/// process high-priority events
-		for (int i = 0; i < nevents; i++) {
-			Client *client = static_cast<Client *>(_events[i].data.ptr);
-
-			if ((_events[i].events & EPOLLIN)) {
-				if (client == &_eventClient) {
-					uint64_t value = 0;
-					auto sz = read(_eventClient.fd, &value, sizeof(uint64_t));
-					if (sz == 8 && value) {
-						auto ev = _queue->popTask();
-						if (value > 1) {
-							value -= 1;
-							// forward event to another worker
-							if (write(_eventClient.fd, &value, sizeof(uint64_t)) == 0) {
-								log::error("ConnectionWorker", "Fail to forward next event to eventfd");
-							}
-						}
-						if (ev) {
-							runTask(ev);
-						}
-					}
-				}
-			}
-		}
-
 		for (int i = 0; i < nevents; i++) {
 			Client *client = static_cast<Client *>(_events[i].data.ptr);
 			if ((_events[i].events & EPOLLERR)) {
-				if (client == &_inputClient) {
+				if (client->listener) {
 					log::error("ConnectionWorker", "epoll error on server socket ", client->fd);
 					_shouldClose = true;
 				} else {
 					log::error("ConnectionWorker", "epoll error on socket ", client->fd);
-					client->gen->releaseClient(client);
+					removeClient(*client);
 				}
 				continue;
 			}
 
 			if ((_events[i].events & EPOLLIN)) {
-				if (client == &_inputClient) {
-					char str[INET_ADDRSTRLEN + 1];
+				if (client->listener) {
+					char str[INET6_ADDRSTRLEN + 1];
 
-					struct sockaddr client_addr;
-					socklen_t client_addr_len = sizeof(client_addr);
-					int newClient = ::accept(_inputClient.fd, &client_addr, &client_addr_len);
+					struct sockaddr_storage clientAddr;
+					socklen_t clientAddrLen = sizeof(clientAddr);
+					int newClient = ::accept(client->fd, (struct sockaddr *)&clientAddr, &clientAddrLen);
 					while (newClient != -1) {
-						struct sockaddr_in* pV4Addr = (struct sockaddr_in*)&client_addr;
-						struct in_addr ipAddr = pV4Addr->sin_addr;
+						uint16_t port = 0;
+						auto addr = getPeerAddress(clientAddr, str, sizeof(str), port);
 
-						memset(str, 0, INET_ADDRSTRLEN + 1);
-						inet_ntop( AF_INET, &ipAddr, str, INET_ADDRSTRLEN );
+						pushFd(epollFd, newClient, addr, port, client->tlsContext);
 
-						pushFd(epollFd, newClient, StringView(str), pV4Addr->sin_port);
-						newClient = ::accept(_inputClient.fd, &client_addr, &client_addr_len);
+						clientAddrLen = sizeof(clientAddr);
+						newClient = ::accept(client->fd, (struct sockaddr *)&clientAddr, &clientAddrLen);
 					}
-					if (errno == EAGAIN || errno == EWOULDBLOCK) {
-						// we processed all of the connections
-						break;
-					} else {
+					if (errno != EAGAIN && errno != EWOULDBLOCK) {
 						log::error("ConnectionWorker", "accept() failed");
-						break;
 					}
+					// other listeners and clients in this batch should still be processed
+					continue;
 				} else if (client == &_cancelClient) {
 					//onError("Received end signal");
 					_shouldClose = true;
-				} else if (client == &_eventClient) {
-					// do nothing
+				} else if (client == &_wakeupClient) {
+					processWakeup();
+				} else if (client == &_timerClient) {
+					_queue->processTimers();
+				} else if (client == &_notifyClient) {
+					_root->getFileCache()->update();
 				} else {
 					client->performRead();
 				}
@@ -226,32 +312,291 @@ bool ConnectionWorker::poll(int epollFd) {
 			}
 
 			if ((_events[i].events & EPOLLHUP) || (_events[i].events & EPOLLRDHUP)) {
-				if (client != &_eventClient && client != &_cancelClient) {
+				if (!client->system) {
 					removeClient(*client);
+					continue;
 				}
 			}
 
-			if (!client->system && !client->valid) {
-				client->shutdownAll();
+			if (client->system) {
+				continue;
 			}
 
-			if (client->shutdownReadSend && client->shutdownWriteSend) {
-				removeClient(*client);
-			}
+			updateClient(*client);
+		}
+
+		if (!_deadlines.empty()) {
+			releaseExpired(Time::now());
+		}
+
+		if (_draining) {
+			releaseDrained(Time::now());
 		}
 	}
 
 	if (_shouldClose) {
-		auto gen = _generation;
-		while (gen) {
-			gen->releaseAll();
-			gen = _generation->prev;
-		}
+		releaseGenerations();
 	}
 
 	return !_shouldClose;
 }
 
+int ConnectionWorker::performTasks() {
+	for (uint32_t i = 0; i < config::UNIX_TASK_BATCH; ++ i) {
+		auto task = _queue->popTask(this);
+		if (!task) {
+			_idle = true;
+			// task can be pushed to the busy worker right before we become idle
+			if (_queue->hasQueuedTasks()) {
+				_idle = false;
+				return 0;
+			}
+			return getPollTimeout();
+		}
+		runTask(task);
+	}
+
+	// batch is completed, process network events without waiting, then continue with tasks
+	return 0;
+}
+
+bool ConnectionWorker::wakeupIdle() {
+	if (!_idle.exchange(false)) {
+		return false;
+	}
+
+	wakeup();
+	return true;
+}
+
+void ConnectionWorker::wakeup() {
+	uint64_t value = 1;
+	if (write(_wakeupClient.fd, &value, sizeof(uint64_t)) != sizeof(uint64_t)) {
+		log::error("ConnectionWorker", "Fail to write wakeup event");
+	}
+}
+
+void ConnectionWorker::scheduleWakeup(UnixWebsocketConnection *conn) {
+	bool notify = false;
+
+	_wakeupMutex.lock();
+	if (!conn->_wakeupScheduled) {
+		conn->_wakeupScheduled = true;
+		notify = _wakeupQueue.empty();
+		_wakeupQueue.emplace_back(conn);
+	}
+	_wakeupMutex.unlock();
+
+	if (notify) {
+		wakeup();
+	}
+}
+
+void ConnectionWorker::cancelWakeup(UnixWebsocketConnection *conn) {
+	_wakeupMutex.lock();
+	if (conn->_wakeupScheduled) {
+		conn->_wakeupScheduled = false;
+		_wakeupQueue.erase(std::remove(_wakeupQueue.begin(), _wakeupQueue.end(), conn), _wakeupQueue.end());
+	}
+	_wakeupMutex.unlock();
+}
+
+void ConnectionWorker::processWakeup() {
+	uint64_t value = 0;
+	if (read(_wakeupClient.fd, &value, sizeof(uint64_t)) != sizeof(uint64_t)) {
+		return;
+	}
+
+	processCompletions();
+	updateGeneration();
+
+	std::vector<UnixWebsocketConnection *> queue;
+
+	_wakeupMutex.lock();
+	queue.swap(_wakeupQueue);
+	for (auto &it : queue) {
+		it->_wakeupScheduled = false;
+	}
+	_wakeupMutex.unlock();
+
+	for (auto &it : queue) {
+		// connection can be released within handleWakeup or updateClient
+		auto client = it->getClient();
+		it->handleWakeup();
+		if (client) {
+			updateClient(*client);
+		}
+	}
+}
+
+void ConnectionWorker::processCompletions() {
+	std::vector<std::pair<Client *, Status>> completions;
+
+	_completionMutex.lock();
+	completions.swap(_completions);
+	_completionMutex.unlock();
+
+	for (auto &it : completions) {
+		auto client = it.first;
+		client->requestState = Client::RequestProcess;
+		if (client->valid) {
+			if (client->processRequestResult(it.second)) {
+				// edge-triggered events were skipped while request was processed, check socket now
+				client->performRead();
+			}
+			client->performWrite();
+		}
+		updateClient(*client);
+	}
+}
+
+void ConnectionWorker::updateClient(Client &client) {
+	if (client.requestState == Client::RequestOffload) {
+		return;
+	}
+
+	if (!client.valid) {
+		client.shutdownAll();
+	}
+
+	if (client.shutdownReadSend && client.shutdownWriteSend) {
+		removeClient(client);
+	} else if (client.isIdle()) {
+		if (!client.idle) {
+			// response was sent, wait for the next request on persistent connection
+			client.reset();
+			client.idle = true;
+			setDeadline(client, Client::Deadline::Idle, _keepAliveTimeout, 0);
+		}
+	} else {
+		client.idle = false;
+		updateDeadline(client);
+		if (_uring && client.output && !client.shutdownWriteSend) {
+			// no edge-triggered EPOLLOUT with io_uring, wait for socket readiness explicitly
+			pollUringOutput(client);
+		}
+	}
+}
+
+void ConnectionWorker::updateGeneration() {
+	if (!_acceptStopped && !_queue->isAccepting()) {
+		stopAccept();
+	}
+
+	if (!_generation || _generation->endOfLife) {
+		return;
+	}
+
+	if (_acceptStopped || _generation->hosts != _root->getHosts()) {
+		// connections of the previous configuration are closed after the current request,
+		// idle ones can still send one more request until drain deadline
+		_generation->endOfLife = true;
+		_generation->drainDeadline = Time::now() + _queue->getConfig().drainTimeout;
+		_draining = true;
+		if (!_drainTimer.isScheduled()) {
+			_deadlines.schedule(&_drainTimer, _generation->drainDeadline);
+		}
+	}
+}
+
+void ConnectionWorker::releaseDrained(Time now) {
+	Time next;
+	_draining = false;
+
+	auto gen = _generation;
+	while (gen) {
+		auto prev = gen->prev;
+		if (gen->endOfLife) {
+			if (gen->drainDeadline <= now) {
+				auto client = gen->active;
+				while (client) {
+					// client can be released by removeClient, so next one is taken first
+					auto nextClient = client->next;
+					removeClient(*client);
+					client = nextClient;
+				}
+			}
+
+			if (gen->activeClients == 0) {
+				if (gen->next) {
+					gen->next->prev = gen->prev;
+				}
+				if (gen->prev) {
+					gen->prev->next = gen->next;
+				}
+				if (gen == _generation) {
+					_generation = gen->prev;
+				}
+
+				gen->releaseAll();
+				pool::destroy(gen->pool);
+			} else {
+				// closed connections, that wait for io_uring or handler thread, are checked on next poll
+				_draining = true;
+				if (gen->drainDeadline > now && (!next || gen->drainDeadline < next)) {
+					next = gen->drainDeadline;
+				}
+			}
+		}
+		gen = prev;
+	}
+
+	if (next && !_drainTimer.isScheduled()) {
+		_deadlines.schedule(&_drainTimer, next);
+	}
+}
+
+void ConnectionWorker::stopAccept() {
+	_acceptStopped = true;
+
+	if (_uring) {
+		cancelUringAccept();
+		return;
+	}
+
+	for (auto &it : _inputClients) {
+		if (::epoll_ctl(_epollFd, EPOLL_CTL_DEL, it.fd, &it.event) == -1) {
+			char buf[256] = { 0 };
+			log::error("ConnectionWorker", "Failed to remove server socket epoll_ctl("
+					, it.fd,  ", EPOLL_CTL_DEL): ",  strerror_r(errno, buf, 255));
+		}
+	}
+}
+
+void ConnectionWorker::releaseGenerations() {
+	// handler threads are stopped before workers, returned clients are released with generations
+	_completionMutex.lock();
+	_completions.clear();
+	_completionMutex.unlock();
+
+	auto gen = _generation;
+	while (gen) {
+		gen->releaseAll();
+		gen = gen->prev;
+	}
+}
+
+bool ConnectionWorker::openSplicePipe() {
+	if (::pipe2(_splicePipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+		_splicePipe[0] = _splicePipe[1] = -1;
+		log::error("ConnectionWorker", "Fail to create splice pipe, uploads will be copied");
+		return false;
+	}
+
+	// failure is not critical, default capacity is used
+	::fcntl(_splicePipe[1], F_SETPIPE_SZ, int(config::UNIX_SPLICE_PIPE_SIZE));
+	return true;
+}
+
+void ConnectionWorker::closeSplicePipe() {
+	for (auto &it : _splicePipe) {
+		if (it >= 0) {
+			::close(it);
+			it = -1;
+		}
+	}
+}
+
 void ConnectionWorker::runTask(AsyncTask *task) {
 	auto host = task->getHost();
 	perform([&] {
@@ -260,18 +605,57 @@ void ConnectionWorker::runTask(AsyncTask *task) {
 	_queue->releaseTask(task);
 }
 
+ssize_t ConnectionWorker::spliceToFile(int sock, int file, off_t *offset, size_t len) {
+	size_t total = 0;
+	while (total < len && _splicePipe[0] >= 0) {
+		auto ret = ::splice(sock, nullptr, _splicePipe[1], nullptr,
+				std::min(len - total, config::UNIX_SPLICE_PIPE_SIZE), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (ret == 0) {
+			break; // peer closed connection
+		} else if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			char tmp[256] = { 0 };
+			log::error("ConnectionWorker", "Fail to splice from client: ", strerror_r(errno, tmp, 255));
+			return -1;
+		}
+
+		// pipe is shared between clients, so it should be drained completely
+		auto pending = ret;
+		while (pending > 0) {
+			auto written = ::splice(_splicePipe[0], nullptr, file, offset, pending, SPLICE_F_MOVE);
+			if (written < 0 && errno == EINTR) {
+				continue;
+			} else if (written <= 0) {
+				char tmp[256] = { 0 };
+				log::error("ConnectionWorker", "Fail to splice into file: ", strerror_r(errno, tmp, 255));
+				// data is stuck in the pipe, replace it
+				closeSplicePipe();
+				openSplicePipe();
+				return -1;
+			}
+			pending -= written;
+		}
+		total += ret;
+	}
+	return total;
+}
+
 UnixRequestController *ConnectionWorker::readRequest(Client *client, BufferChain &chain) {
 	RequestInfo info;
 
-	StringView str;
 	pool_t *tmpPool = nullptr;
+	size_t lineLen = chain.getBytesRead() - client->bytesRead;
 
-	if (chain.isSingle()) {
-		str = StringView((const char *)chain.front->buf, chain.getBytesRead());
-	} else {
+	// line is copied only when it spans buffer boundary
+	StringView str = chain.view(client->bytesRead, lineLen).toStringView();
+	if (str.empty()) {
 		tmpPool = pool::create(client->pool);
 
-		auto data = chain.extract(tmpPool, 0, std::min(chain.getBytesRead(), config::UNIX_MAX_REQUEST_LINE));
+		auto data = chain.extract(tmpPool, client->bytesRead, std::min(lineLen, config::UNIX_MAX_REQUEST_LINE));
 		str = data.toStringView();
 	}
 
@@ -285,7 +669,8 @@ UnixRequestController *ConnectionWorker::readRequest(Client *client, BufferChain
 	}
 
 	UnixRequestController *cfg = nullptr;
-	auto p = pool::create(thread::ThreadInfo::getThreadInfo()->threadPool);
+	// request, that can be passed to handler thread, should not use worker's allocator
+	auto p = client->alloc ? pool::create(client->rootPool) : pool::create(thread::ThreadInfo::getThreadInfo()->threadPool);
 	perform([&] {
 		cfg = new (p) UnixRequestController(p, info.clone(p), client);
 	}, p);
@@ -295,6 +680,7 @@ UnixRequestController *ConnectionWorker::readRequest(Client *client, BufferChain
 	}
 
 	client->bytesRead = chain.getBytesRead();
+	client->headerColon = maxOf<size_t>();
 	chain.releaseEmpty();
 
 	return cfg;
@@ -304,13 +690,15 @@ Status ConnectionWorker::parseRequestHeader(UnixRequestController *cfg, Client *
 	StringView name;
 	StringView value;
 
-	BytesView str;
 	pool_t *tmpPool = nullptr;
 	size_t headerLen = chain.getBytesRead() - client->bytesRead;
 
-	if (chain.isSingle()) {
-		str = BytesView(chain.front->buf + (client->bytesRead - chain.front->absolute), headerLen);
-	} else {
+	auto colon = client->headerColon;
+	client->headerColon = maxOf<size_t>();
+
+	// line is copied only when it spans buffer boundary
+	BytesView str = chain.view(client->bytesRead, headerLen);
+	if (str.empty()) {
 		tmpPool = pool::create(client->pool);
 
 		str = chain.extract(tmpPool, client->bytesRead, std::min(headerLen, config::UNIX_MAX_HEADER_LINE));
@@ -319,11 +707,14 @@ Status ConnectionWorker::parseRequestHeader(UnixRequestController *cfg, Client *
 	if (str.size() == 2 && str.equals((const uint8_t *)"\r\n", 2)) {
 		client->bytesRead += headerLen;
 		chain.releaseEmpty();
+		if (tmpPool) {
+			pool::destroy(tmpPool);
+		}
 		return DONE;
 	}
 
-	auto headerLineLength = RequestFilter::readRequestHeader(str, name, value);
-	if (headerLineLength == 0) {
+	// colon position was found by checkForHeader, line is not scanned again
+	if (colon < client->bytesRead || !UnixHttpParser::splitHeaderLine(str, colon - client->bytesRead, name, value)) {
 		if (tmpPool) {
 			pool::destroy(tmpPool);
 		}
@@ -343,7 +734,68 @@ Status ConnectionWorker::parseRequestHeader(UnixRequestController *cfg, Client *
 	return OK;
 }
 
+bool ConnectionWorker::isOffloadEnabled() const {
+	// io_uring delivers received data immediately, it can not wait for handler thread
+	return _queue->getHandlerPool() && !_uring;
+}
+
+bool ConnectionWorker::offloadRequest(Client *client) {
+	if (!client->alloc || !isOffloadEnabled() || _root->isInlineRequest(client->request)) {
+		return false;
+	}
+
+	clearDeadline(*client);
+	client->requestState = Client::RequestOffload;
+	if (!_queue->getHandlerPool()->push(client)) {
+		client->requestState = Client::RequestProcess;
+		return false;
+	}
+	return true;
+}
+
+void ConnectionWorker::completeRequest(Client *client, Status status) {
+	_completionMutex.lock();
+	_completions.emplace_back(client, status);
+	_completionMutex.unlock();
+
+	wakeup();
+}
+
+Status ConnectionWorker::admitRequest(UnixRequestController *req) {
+	if (req->isAdmitted()) {
+		return OK;
+	}
+
+	if (_root->admitRequest(req, _requestsInFlight) != OK) {
+		return rejectRequest(req);
+	}
+
+	++ _requestsInFlight;
+
+	if (_root->isTraceEnabled()) {
+		req->startTrace();
+		req->setServerTiming(_root->isServerTimingEnabled());
+	}
+	return OK;
+}
+
+void ConnectionWorker::writeTrace(UnixRequestController *req) {
+	_root->writeTrace(req, _index);
+}
+
+Status ConnectionWorker::rejectRequest(UnixRequestController *req) {
+	auto seconds = _retryAfter.toSeconds();
+	perform([&] {
+		req->setErrorHeader("Retry-After", toString(seconds ? seconds : 1));
+	}, req->getPool());
+	return HTTP_SERVICE_UNAVAILABLE;
+}
+
 Status ConnectionWorker::processRequest(UnixRequestController *req) {
+	if (req->hasUnsupportedExpectation()) {
+		return HTTP_EXPECTATION_FAILED;
+	}
+
 	return perform([&, this] {
 		auto ret = _root->processRequest(req);
 		switch (ret) {
@@ -360,16 +812,36 @@ Status ConnectionWorker::processRequest(UnixRequestController *req) {
 	}, req->getPool(), config::TAG_REQUEST, req);
 }
 
-void ConnectionWorker::pushFd(int epollFd, int fd, StringView addr, uint16_t port) {
-	if (!_generation) {
-		_generation = makeGeneration();
+void ConnectionWorker::pushFd(int epollFd, int fd, StringView addr, uint16_t port, UnixTlsContext *tls) {
+	// hosts can be replaced before wakeup event is processed
+	updateGeneration();
+
+	if (!_generation || _generation->endOfLife) {
+		auto gen = makeGeneration();
+		gen->prev = _generation;
+		if (_generation) {
+			_generation->next = gen;
+		}
+		_generation = gen;
 	}
 
 	auto c = _generation->pushFd(fd, addr, port);
+	if (tls) {
+		c->secure = true;
+		c->tls = tls->accept(fd);
+		if (!c->tls) {
+			c->release();
+			return;
+		}
+	}
+
 	if (addClient(*c)) {
 		++ _fdCount;
+		// wait for the first request same way as for the next one
+		c->idle = true;
+		setDeadline(*c, Client::Deadline::Idle, _keepAliveTimeout, 0);
 	} else {
-		c->gen->releaseClient(c);
+		c->release();
 	}
 }
 
@@ -378,6 +850,10 @@ bool ConnectionWorker::addClient(Client &client) {
 		return false;
 	}
 
+	if (_uring) {
+		return addUringClient(client);
+	}
+
 	int err = ::epoll_ctl(_epollFd, EPOLL_CTL_ADD, client.fd, &client.event);
 	if (err == -1) {
 		char buf[256] = { 0 };
@@ -393,6 +869,17 @@ void ConnectionWorker::removeClient(Client &client) {
 		return;
 	}
 
+	if (client.requestState == Client::RequestOffload) {
+		// client is owned by handler thread, it will be removed when request is returned
+		client.valid = false;
+		return;
+	}
+
+	if (_uring) {
+		removeUringClient(client);
+		return;
+	}
+
 	int err = ::epoll_ctl(_epollFd, EPOLL_CTL_DEL, client.fd, &client.event);
 	if (err == -1) {
 		char buf[256] = { 0 };
@@ -400,9 +887,138 @@ void ConnectionWorker::removeClient(Client &client) {
 				, client.fd,  ", EPOLL_CTL_DEL): ",  strerror_r(errno, buf, 255));
 	}
 
+	clearDeadline(client);
+
+	-- _fdCount;
 	client.release();
 }
 
+void ConnectionWorker::updateDeadline(Client &client) {
+	if (client.output && !client.shutdownWriteSend) {
+		// peer should accept some of the pending output within timeout
+		if (client.deadline != Client::Deadline::Write || client.deadlineMark != client.bytesSent) {
+			setDeadline(client, Client::Deadline::Write, _writeTimeout, client.bytesSent);
+		}
+		return;
+	}
+
+	switch (client.requestState) {
+	case Client::RequestLine:
+	case Client::RequestHeaders:
+		// trickling does not extend deadline, whole header block should be received in time
+		if (client.deadline != Client::Deadline::Header || client.deadlineMark != client.requestsCount) {
+			setDeadline(client, Client::Deadline::Header, _requestHeaderTimeout, client.requestsCount);
+		}
+		break;
+	case Client::RequestInput:
+		if (client.deadline != Client::Deadline::Body) {
+			setDeadline(client, Client::Deadline::Body, _requestBodyTimeout, client.input.getBytesReceived());
+		}
+		break;
+	case Client::RequestWebsocket:
+		if (client.websocket && (client.deadline != Client::Deadline::Websocket
+				|| client.deadlineMark != client.input.getBytesReceived())) {
+			setDeadline(client, Client::Deadline::Websocket, client.websocket->getTtl(), client.input.getBytesReceived());
+		}
+		break;
+	case Client::RequestHttp2:
+		if (client.http2 && client.http2->hasActiveStreams()) {
+			// streams wait for flow control window or request body, connection should make progress
+			auto mark = client.bytesSent + client.input.getBytesReceived();
+			if (client.deadline != Client::Deadline::Write || client.deadlineMark != mark) {
+				setDeadline(client, Client::Deadline::Write, _writeTimeout, mark);
+			}
+		} else if (client.deadline != Client::Deadline::Idle || client.deadlineMark != client.requestsCount) {
+			// no streams, same as persistent HTTP/1.1 connection between requests
+			setDeadline(client, Client::Deadline::Idle, _keepAliveTimeout ? _keepAliveTimeout : _requestHeaderTimeout,
+					client.requestsCount);
+		}
+		break;
+	default:
+		// request is processed by handler, no deadline
+		clearDeadline(client);
+		break;
+	}
+}
+
+void ConnectionWorker::setDeadline(Client &client, Client::Deadline deadline, TimeInterval ival, size_t mark) {
+	client.deadline = deadline;
+	client.deadlineMark = mark;
+	if (ival) {
+		_deadlines.schedule(&client.timer, Time::now() + ival);
+	} else {
+		_deadlines.cancel(&client.timer);
+	}
+}
+
+void ConnectionWorker::clearDeadline(Client &client) {
+	client.deadline = Client::Deadline::None;
+	_deadlines.cancel(&client.timer);
+}
+
+void ConnectionWorker::releaseExpired(Time now) {
+	_deadlines.advance(now, [&, this] (TimerWheel::Node *node) {
+		if (node == &_drainTimer) {
+			// generations are checked with releaseDrained
+			return;
+		}
+		expireClient(*static_cast<Client::Timer *>(node)->client);
+	});
+}
+
+void ConnectionWorker::expireClient(Client &client) {
+	switch (client.deadline) {
+	case Client::Deadline::Body: {
+		auto received = client.input.getBytesReceived();
+		auto required = _requestBodyMinRate * _requestBodyTimeout.toMicros() / 1'000'000;
+		if (received - client.deadlineMark >= required) {
+			setDeadline(client, Client::Deadline::Body, _requestBodyTimeout, received);
+			return;
+		}
+		break;
+	}
+	case Client::Deadline::Websocket:
+		if (client.websocket && !client.websocket->isClosing()) {
+			// same as httpd: no input within TTL, close with Away status
+			client.websocket->expire();
+			clearDeadline(client);
+			updateClient(client);
+			return;
+		}
+		break;
+	case Client::Deadline::Idle:
+		if (client.http2 && !client.shutdownWriteSend) {
+			// GOAWAY, connection is closed when it's sent
+			client.http2->shutdown();
+			clearDeadline(client);
+			updateClient(client);
+			return;
+		}
+		break;
+	default:
+		break;
+	}
+
+	// slow or stalled client, drop connection without response
+	client.shutdownAll();
+	removeClient(client);
+}
+
+int ConnectionWorker::getPollTimeout() const {
+	if (_deadlines.empty()) {
+		return -1;
+	}
+
+	auto next = _deadlines.getNextTime();
+	auto now = Time::now();
+	if (next <= now) {
+		return 0;
+	}
+
+	// round up, so we will not wake up before deadline
+	return int(((next - now).toMicros() + 999) / 1000);
+}
+
 ConnectionWorker::Buffer *ConnectionWorker::Buffer::create(pool_t *p, size_t abs) {
 	auto requestSize = config::UNIX_CLIENT_BUFFER_SIZE;
 	auto block = pool::palloc(p, requestSize);
@@ -420,8 +1036,14 @@ ConnectionWorker::Buffer *ConnectionWorker::Buffer::create(pool_t *p, size_t abs
 	return b;
 }
 
-ConnectionWorker::Buffer *ConnectionWorker::Buffer::create(pool_t *p, StringView path, off_t rangeStart, size_t rangeLen, size_t abs) {
-	if (!filesystem::exists(path)) {
+ConnectionWorker::Buffer *ConnectionWorker::Buffer::create(pool_t *p, UnixFileCache *cache, StringView path, off_t rangeStart, size_t rangeLen, size_t abs) {
+	UnixFileCache::File *cached = nullptr;
+	if (cache) {
+		cached = cache->open(path);
+		if (!cached) {
+			return nullptr;
+		}
+	} else if (!filesystem::exists(path)) {
 		return nullptr;
 	}
 
@@ -439,24 +1061,80 @@ ConnectionWorker::Buffer *ConnectionWorker::Buffer::create(pool_t *p, StringView
 	b->flags |= IsOutFile;
 
 	BufferFile *file = new (b->buf) BufferFile;
-	filesystem::stat(path, file->stat);
-	file->fd = ::open(path.data(), O_RDONLY);
+	if (cached) {
+		// fd is shared with other responses, sendfile does not change file position
+		file->stat = cached->stat;
+		file->fd = cached->fd;
+		file->cached = cached;
+	} else {
+		filesystem::stat(path, file->stat);
+		file->fd = ::open(path.data(), O_RDONLY);
+	}
 	file->extraBuffer = b->buf + sizeof(BufferFile);
 	b->capacity -= sizeof(BufferFile);
 
-	b->size = std::min(rangeLen, file->stat.size - rangeStart);
+	// offset and size are positions within file, as for memory buffers
+	if (size_t(rangeStart) < file->stat.size) {
+		b->size = rangeStart + std::min(rangeLen, file->stat.size - rangeStart);
+	} else {
+		b->size = rangeStart;
+	}
+
+	return b;
+}
+
+ConnectionWorker::Buffer *ConnectionWorker::Buffer::create(pool_t *p, const BufferFile &source, off_t rangeStart, size_t rangeLen, size_t abs) {
+	int fd = -1;
+	if (source.cached) {
+		source.cached->retain();
+		fd = source.cached->fd;
+	} else {
+		fd = ::dup(source.fd);
+		if (fd < 0) {
+			return nullptr;
+		}
+	}
+
+	auto requestSize = config::UNIX_CLIENT_BUFFER_SIZE;
+	auto block = pool::palloc(p, requestSize);
+
+	auto b = new (block) Buffer();
+
+	b->next = nullptr;
+	b->pool = p;
+	b->buf = (uint8_t *)block + sizeof(Buffer);
+	b->capacity = requestSize - sizeof(Buffer) - sizeof(BufferFile);
+	b->offset = rangeStart;
+	b->size = rangeStart + rangeLen;
+	b->absolute = abs;
+	b->flags |= IsOutFile;
+
+	BufferFile *file = new (b->buf) BufferFile;
+	file->stat = source.stat;
+	file->fd = fd;
+	file->cached = source.cached;
+	file->extraBuffer = b->buf + sizeof(BufferFile);
 
 	return b;
 }
 
 void ConnectionWorker::Buffer::release() {
+	if ((flags & Borrowed) != None) {
+		return;
+	}
+
 	if (auto f = getFile()) {
-		if (f->fd >= 0) {
+		if (f->cached) {
+			f->cached->release();
+			f->cached = nullptr;
+			f->fd = -1;
+		} else if (f->fd >= 0) {
 			::close(f->fd);
 			f->fd = -1;
 		}
 	}
-	pool::free(pool, this, capacity + sizeof(this));
+	// memory and file buffers both use a single block of UNIX_CLIENT_BUFFER_SIZE
+	pool::free(pool, this, config::UNIX_CLIENT_BUFFER_SIZE);
 }
 
 StringView ConnectionWorker::Buffer::str() const {
@@ -531,7 +1209,7 @@ size_t ConnectionWorker::BufferChain::size() const {
 	size_t ret = 0;
 	auto b = front;
 	while (b) {
-		ret += b->size;
+		ret += b->availableForRead();
 		b = b->next;
 	}
 	return ret;
@@ -541,7 +1219,7 @@ ConnectionWorker::Buffer *ConnectionWorker::BufferChain::getWriteTarget(pool_t *
 	if (back && back->availableForWrite() > 0) {
 		return back;
 	} else {
-		auto b = Buffer::create(pool, back ? back->absolute + back->capacity : 0);
+		auto b = Buffer::create(pool, back ? back->absolute + back->capacity : absolute);
 
 		if (back) {
 			back->next = b;
@@ -601,6 +1279,10 @@ bool ConnectionWorker::BufferChain::write(Buffer *newBuf) {
 }
 
 bool ConnectionWorker::BufferChain::write(BufferChain &chain) {
+	if (!chain.front) {
+		return true;
+	}
+
 	if (back) {
 		back->next = chain.front;
 		back = chain.back;
@@ -616,6 +1298,40 @@ bool ConnectionWorker::BufferChain::write(BufferChain &chain) {
 	return true;
 }
 
+bool ConnectionWorker::BufferChain::split(pool_t *p, BufferChain &target, size_t len) {
+	while (front && len > 0) {
+		auto b = front;
+		auto size = b->availableForRead();
+		if (size == 0) {
+			releaseFront();
+		} else if (size <= len) {
+			// whole buffer is moved without copying
+			front = b->next;
+			if (b == back) {
+				back = nullptr;
+				tail = nullptr;
+				absolute = b->absolute + b->size;
+			}
+			b->next = nullptr;
+			target.write(b);
+			len -= size;
+		} else if (b->isOutFile()) {
+			auto range = Buffer::create(p, *b->getFile(), b->offset, len, b->absolute);
+			if (!range) {
+				return false;
+			}
+			target.write(range);
+			b->offset += len;
+			len = 0;
+		} else {
+			target.write(p, b->readSource(), len);
+			b->offset += len;
+			len = 0;
+		}
+	}
+	return len == 0;
+}
+
 bool ConnectionWorker::BufferChain::readFromFd(pool_t *p, int fd) {
 	int sz = 0;
 	::ioctl (fd, FIONREAD, &sz);
@@ -645,6 +1361,30 @@ bool ConnectionWorker::BufferChain::readFromFd(pool_t *p, int fd) {
 	return true;
 }
 
+bool ConnectionWorker::BufferChain::readFromTls(pool_t *p, int fd) {
+	while (true) {
+		Buffer *targetBuffer = getWriteTarget(p);
+
+		auto sz = ::read(fd, targetBuffer->writeTarget(), targetBuffer->availableForWrite());
+		if (sz > 0) {
+			targetBuffer->size += sz;
+		} else if (sz == 0) {
+			// end of stream, connection is closed with EPOLLRDHUP
+			return true;
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return true;
+		} else {
+			// EIO for the TLS control record (alert or key update), that kernel can not process
+			if (errno != EIO) {
+				char tmp[256] = { 0 };
+				log::error("ConnectionWorker", "Fail to read from TLS client: ", strerror_r(errno, tmp, 255));
+			}
+			return false;
+		}
+	}
+	return true;
+}
+
 Status ConnectionWorker::BufferChain::read(const Callback<int(const Buffer *, const uint8_t *, size_t)> &cb, bool release) {
 	auto buf = front;
 	while (buf) {
@@ -663,15 +1403,7 @@ Status ConnectionWorker::BufferChain::read(const Callback<int(const Buffer *, co
 				eos = true;
 			}
 			if (release) {
-				auto f = front;
-				front = front->next;
-				if (&f->next ==tail) {
-					tail = nullptr;
-				}
-				if (f == back) {
-					back = nullptr;
-				}
-				f->release();
+				releaseFront();
 				buf = front;
 			} else {
 				buf = buf->next;
@@ -690,31 +1422,107 @@ Status ConnectionWorker::BufferChain::read(const Callback<int(const Buffer *, co
 }
 
 Status ConnectionWorker::BufferChain::writeToFd(int fd, size_t &bytesWritten) {
-	return read([&] (const Buffer *source, const uint8_t *buf, size_t size) {
+	static_assert(config::UNIX_WRITE_IOV_MAX <= IOV_MAX);
+
+	struct iovec iov[config::UNIX_WRITE_IOV_MAX];
+
+	while (front) {
+		// drop completed buffers
+		if (front->availableForRead() == 0) {
+			if ((front->flags & Buffer::Eos) != Buffer::None) {
+				eos = true;
+			}
+			releaseFront();
+			if (eos) {
+				return DONE;
+			}
+			continue;
+		}
+
 		ssize_t ret = 0;
-		if (auto f = source->getFile()) {
-			off_t offset = source->offset;
-			ret = ::sendfile(fd, f->fd, &offset, source->size);
+		if (auto f = front->getFile()) {
+			off_t offset = front->offset;
+			ret = ::sendfile(fd, f->fd, &offset, front->availableForRead());
+			if (ret == 0) {
+				// file was truncated, we can not send promised data
+				return DECLINED;
+			}
 		} else {
-			ret = ::write(fd, buf, size);
+			// gather memory buffers up to the next file or the end of stream
+			int iovcnt = 0;
+			auto b = front;
+			while (b && !b->isOutFile() && iovcnt < int(config::UNIX_WRITE_IOV_MAX)) {
+				if (auto s = b->availableForRead()) {
+					iov[iovcnt].iov_base = b->buf + b->offset;
+					iov[iovcnt].iov_len = s;
+					++ iovcnt;
+				}
+				if ((b->flags & Buffer::Eos) != Buffer::None) {
+					b = nullptr;
+					break;
+				}
+				b = b->next;
+			}
+
+			if (b && b->isOutFile()) {
+				// headers should share a segment with the beginning of the file
+				struct msghdr msg;
+				memset(&msg, 0, sizeof(msg));
+				msg.msg_iov = iov;
+				msg.msg_iovlen = iovcnt;
+				ret = ::sendmsg(fd, &msg, MSG_MORE | MSG_NOSIGNAL);
+			} else {
+				ret = ::writev(fd, iov, iovcnt);
+			}
 		}
-		if (ret >= 0) {
-			bytesWritten += ret;
-			return int(ret);
-		} else {
-			if (errno != EAGAIN && errno != EWOULDBLOCK) {
-				return int(SUSPENDED);
+
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			} else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				// unrecoverable error
+				return DECLINED;
 			}
-			return int(DECLINED);
+			// wait for EPOLLOUT
+			return SUSPENDED;
 		}
-	}, true);
+
+		bytesWritten += ret;
+
+		// partial write can end in the middle of any buffer
+		size_t written = ret;
+		while (written > 0) {
+			auto n = std::min(written, front->availableForRead());
+			front->offset += n;
+			written -= n;
+			if (front->availableForRead() == 0) {
+				if ((front->flags & Buffer::Eos) != Buffer::None) {
+					eos = true;
+				}
+				releaseFront();
+				if (eos) {
+					return DONE;
+				}
+			}
+		}
+	}
+	return OK;
 }
 
 size_t ConnectionWorker::BufferChain::getBytesRead() const {
-	if (front) {
-		return front->absolute + front->offset;
+	auto b = front;
+	while (b) {
+		// buffers are not released when read without release flag, skip them
+		if (b->availableForRead() > 0 || !b->next) {
+			return b->absolute + b->offset;
+		}
+		b = b->next;
 	}
-	return 0;
+	return absolute;
+}
+
+size_t ConnectionWorker::BufferChain::getBytesReceived() const {
+	return back ? back->absolute + back->size : absolute;
 }
 
 BytesView ConnectionWorker::BufferChain::extract(pool_t *pool, size_t initOffset, size_t blockSize) const {
@@ -736,7 +1544,7 @@ BytesView ConnectionWorker::BufferChain::extract(pool_t *pool, size_t initOffset
 	auto target = block;
 
 	Buffer *first = front;
-	while (first->absolute + first->capacity < initOffset) {
+	while (first->absolute + first->capacity <= initOffset) {
 		first = first->next;
 	}
 
@@ -754,6 +1562,19 @@ BytesView ConnectionWorker::BufferChain::extract(pool_t *pool, size_t initOffset
 	return BytesView(block, targetSize);
 }
 
+BytesView ConnectionWorker::BufferChain::view(size_t initOffset, size_t blockSize) const {
+	auto b = front;
+	while (b && b->absolute + b->size <= initOffset) {
+		b = b->next;
+	}
+
+	if (!b || b->isOutFile() || b->absolute > initOffset || initOffset + blockSize > b->absolute + b->size) {
+		return BytesView();
+	}
+
+	return BytesView(b->buf + (initOffset - b->absolute), blockSize);
+}
+
 /*void ConnectionWorker::BufferChain::release(size_t offset) {
 	while (front && offset > 0) {
 		if (front->size < front->offset + offset) {
@@ -777,38 +1598,42 @@ BytesView ConnectionWorker::BufferChain::extract(pool_t *pool, size_t initOffset
 
 void ConnectionWorker::BufferChain::releaseEmpty() {
 	while (front && front->availableForRead() == 0) {
-		auto f = front;
-		front = front->next;
-		if (&f->next ==tail) {
-			tail = nullptr;
-		}
-		if (f == back) {
-			back = nullptr;
-		}
-		f->release();
+		releaseFront();
 	}
 }
 
 void ConnectionWorker::BufferChain::clear() {
 	while (front) {
-		auto f = front;
-		front = front->next;
-		if (&f->next ==tail) {
-			tail = nullptr;
-		}
-		if (f == back) {
-			back = nullptr;
-		}
-		f->release();
+		releaseFront();
+	}
+	eos = false;
+}
+
+void ConnectionWorker::BufferChain::releaseFront() {
+	auto f = front;
+	front = front->next;
+	if (&f->next ==tail) {
+		tail = nullptr;
 	}
+	if (f == back) {
+		back = nullptr;
+		absolute = f->absolute + f->size;
+	}
+	f->release();
 }
 
-ConnectionWorker::Client::Client(Generation *g, pool_t *p, int ifd, StringView inAddr, uint16_t inPort)
-: gen(g), pool(p), addr(inAddr.pdup(p)), port(inPort) {
+ConnectionWorker::Client::Client(Generation *g, pool_t *root, pool_t *p, int ifd, StringView inAddr, uint16_t inPort)
+: gen(g), rootPool(root), pool(p), port(inPort) {
+	auto len = std::min(inAddr.size(), sizeof(addrBuffer) - 1);
+	memcpy(addrBuffer, inAddr.data(), len);
+	addrBuffer[len] = 0;
+	addr = StringView(addrBuffer, len);
+
 	memset(&event, 0, sizeof(event));
 	event.data.ptr = this;
 	event.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
 	fd = ifd;
+	timer.client = this;
 
 	ConnectionQueue::setNonblocking(fd);
 }
@@ -824,14 +1649,14 @@ ConnectionWorker::Client::Client(int f, int mode) {
 void ConnectionWorker::Client::shutdownRead() {
 	if (!shutdownReadSend) {
 		shutdownReadSend = true;
-		::shutdown(event.data.fd, SHUT_RD);
+		::shutdown(fd, SHUT_RD);
 	}
 }
 
 void ConnectionWorker::Client::shutdownWrite() {
 	if (!shutdownWriteSend) {
 		shutdownWriteSend = true;
-		::shutdown(event.data.fd, SHUT_WR);
+		::shutdown(fd, SHUT_WR);
 	}
 }
 
@@ -839,7 +1664,7 @@ void ConnectionWorker::Client::shutdownAll() {
 	if (!shutdownReadSend && !shutdownWriteSend) {
 		shutdownWriteSend = true;
 		shutdownReadSend = true;
-		::shutdown(event.data.fd, SHUT_RDWR);
+		::shutdown(fd, SHUT_RDWR);
 	} else {
 		shutdownRead();
 		shutdownWrite();
@@ -847,6 +1672,11 @@ void ConnectionWorker::Client::shutdownAll() {
 }
 
 void ConnectionWorker::Client::release() {
+	if (websocket) {
+		websocket->end();
+		websocket = nullptr;
+	}
+
 	if (request) {
 		auto p = request->getPool();
 		request->finalize();
@@ -854,14 +1684,71 @@ void ConnectionWorker::Client::release() {
 		request = nullptr;
 	}
 
-	close(event.data.fd);
+	// close file descriptors, opened for output
+	input.clear();
+	output.clear();
+	response.clear();
+
+	if (http2) {
+		// output was cleared, so streams can be released with their buffers
+		http2->end();
+		http2 = nullptr;
+	}
+
+	if (tls) {
+		// handshake was not completed
+		UnixTlsContext::release(tls);
+		tls = nullptr;
+	}
+
+	close(fd);
+	fd = -1;
+
 	if (gen) {
 		gen->releaseClient(this);
+		if (gen->recycleClient(this)) {
+			return;
+		}
+	}
+
+	if (rootPool) {
+		auto a = alloc;
+		pool::destroy(rootPool);
+		if (a) {
+			allocator::destroy(a);
+		}
+	}
+}
+
+void ConnectionWorker::Client::reset() {
+	input.clear();
+	output.clear();
+	response.clear();
+
+	input.absolute = 0;
+	output.absolute = 0;
+	response.absolute = 0;
+	bytesRead = 0;
+
+	pool::clear(pool);
+}
+
+bool ConnectionWorker::Client::isIdle() const {
+	return requestState == RequestLine && !request && !input && !output
+			&& !shutdownReadSend && !shutdownWriteSend;
+}
+
+bool ConnectionWorker::Client::canKeepAlive() const {
+	if (requestState == ReqeustInvalid || shutdownReadSend || shutdownWriteSend) {
+		return false;
 	}
 
-	if (pool) {
-		pool::destroy(pool);
+	if (!gen || gen->endOfLife || !gen->worker->getKeepAliveTimeout()) {
+		return false;
 	}
+
+	auto max = gen->worker->getKeepAliveMaxRequests();
+	return max == 0 || requestsCount + 1 < max;
 }
 
 bool ConnectionWorker::Client::performRead() {
@@ -869,28 +1756,105 @@ bool ConnectionWorker::Client::performRead() {
 		return false;
 	}
 
-	input.readFromFd(pool, fd);
+	if (requestState == RequestOffload) {
+		// socket is checked again, when request is returned from handler thread
+		return true;
+	}
+
+	if (tls) {
+		if (!performHandshake()) {
+			return false;
+		}
+		if (tls) {
+			return true;
+		}
+		// request can be already received with the last handshake flight
+	}
+
+	if (requestState == RequestInput && !input && request->isInputSpliced()) {
+		// request body goes from socket into the upload file, without reading into buffers
+		auto ret = request->spliceInput();
+		switch (ret) {
+		case OK:
+		case SUSPENDED:
+			return true;
+			break;
+		case DONE:
+			if (!finalizeRequest(DONE)) {
+				return true;
+			}
+			// pipelined request can follow the body
+			break;
+		default:
+			requestState = ReqeustInvalid;
+			finalizeRequest((ret == DECLINED) ? HTTP_BAD_REQUEST : ret);
+			shutdownRead();
+			return false;
+			break;
+		}
+	}
+
+	if (secure) {
+		if (!input.readFromTls(pool, fd)) {
+			// no more data can be read from the kernel after alert
+			shutdownRead();
+		}
+	} else {
+		input.readFromFd(pool, fd);
+	}
+
+	return processInput();
+}
+
+bool ConnectionWorker::Client::performRead(BytesView data) {
+	if (shutdownReadSend) {
+		return false;
+	}
+
+	if (input) {
+		// incomplete data from previous read, append to it
+		input.write(pool, data.data(), data.size());
+		return processInput();
+	}
+
+	// process data in place, without copying to the client's pool
+	Buffer buf;
+	buf.buf = const_cast<uint8_t *>(data.data());
+	buf.capacity = buf.size = data.size();
+	buf.absolute = input.absolute;
+	buf.flags = Buffer::Borrowed;
+
+	input.write(&buf);
+
+	auto ret = processInput();
+
+	if (input.front == &buf) {
+		// data is owned by the caller, copy the rest into the pool
+		input.front = input.back = nullptr;
+		input.tail = nullptr;
+		input.absolute = buf.absolute + buf.offset;
+		if (buf.availableForRead() > 0) {
+			input.write(pool, buf.readSource(), buf.availableForRead());
+		}
+	}
+
+	return ret;
+}
 
+bool ConnectionWorker::Client::processInput() {
 	if (input) {
 		auto ret = runInputFilter(input);
 		switch (ret) {
 		case OK:
 		case SUSPENDED:
+		case DONE: // response for the last request was submitted, read side is closed
 			break;
 		case DECLINED:
 			shutdownRead();
 			break;
-		case DONE:
-			perform([&] {
-				request->submitResponse(ret);
-			}, request->getPool(), config::TAG_REQUEST, request);
-			shutdownRead();
-			break;
 		default:
 			if (request) {
-				perform([&] {
-					request->submitResponse(ret);
-				}, request->getPool(), config::TAG_REQUEST, request);
+				finalizeRequest(ret);
 			} else {
 				cancelWithResult(ret);
 			}
@@ -903,7 +1867,18 @@ bool ConnectionWorker::Client::performRead() {
 }
 
 bool ConnectionWorker::Client::performWrite() {
-	if (!output || !valid) {
+	if (tls && valid) {
+		if (!performHandshake()) {
+			return false;
+		}
+		if (!tls) {
+			// handshake was waiting for the output, so input readiness was already reported
+			return performRead();
+		}
+		return true;
+	}
+
+	if (!output || !valid || requestState == RequestOffload) {
 		return true;
 	}
 
@@ -919,25 +1894,48 @@ bool ConnectionWorker::Client::performWrite() {
 		break;
 	}
 
+	if (http2 && !output) {
+		// socket accepts more data, send frames, that was waiting for it
+		http2->update();
+	}
+
 	return true;
 }
 
+bool ConnectionWorker::Client::performHandshake() {
+	switch (UnixTlsContext::handshake(tls)) {
+	case SUSPENDED:
+		return true;
+		break;
+	case DONE:
+		// kernel handles records for both directions, OpenSSL state is no longer needed
+		UnixTlsContext::release(tls);
+		tls = nullptr;
+		return true;
+		break;
+	default:
+		break;
+	}
+
+	UnixTlsContext::release(tls);
+	tls = nullptr;
+	requestState = ReqeustInvalid;
+	shutdownAll();
+	return false;
+}
+
 bool ConnectionWorker::Client::write(BufferChain &target, BufferChain &source) {
 	if (output.isEos() || shutdownWriteSend) {
 		return false;
 	}
 
-	if (!target) {
+	if (!target && &target == &output) {
 		auto ret = source.writeToFd(fd, bytesSent);
 		switch (ret) {
-		case DONE:
+		case DONE: // eos found
 			shutdownWrite();
 			return true;
 			break;
-		case OK:
-		case SUSPENDED:
-			return true;
-			break;
 		case DECLINED:
 			shutdownWrite();
 			return false;
@@ -945,11 +1943,10 @@ bool ConnectionWorker::Client::write(BufferChain &target, BufferChain &source) {
 		default:
 			break;
 		}
+	}
 
-		if (source) {
-			target.write(source);
-		}
-	} else {
+	// store data, that was not sent
+	if (source) {
 		target.write(source);
 	}
 	return true;
@@ -960,9 +1957,10 @@ bool ConnectionWorker::Client::write(BufferChain &chain, const uint8_t *buf, siz
 		return false;
 	}
 
-	if (!chain && &chain == &output) {
+	if (!chain && &chain == &output && size > 0) {
 		auto ret = ::write(fd, buf, size);
 		while (ret > 0) {
+			bytesSent += ret;
 			buf += ret; size -= ret;
 			if (size > 0) {
 				ret = ::write(fd, buf, size);
@@ -977,15 +1975,14 @@ bool ConnectionWorker::Client::write(BufferChain &chain, const uint8_t *buf, siz
 				size = 0;
 				flags = Buffer::Flags::Eos;
 			}
-		} else {
-			bytesSent += ret;
 		}
 	}
 
 	if (size > 0) {
 		return chain.write(pool, buf, size, flags);
 	} else if (size == 0 && flags != Buffer::None) {
-		if (&chain == &output && (flags & Buffer::Eos) != Buffer::None) {
+		if (&chain == &output && !chain && (flags & Buffer::Eos) != Buffer::None) {
+			// all data was sent
 			shutdownWrite();
 			return true;
 		} else {
@@ -1008,26 +2005,28 @@ bool ConnectionWorker::Client::writeFile(BufferChain &chain, StringView filename
 		return false;
 	}
 
-	auto buf = Buffer::create(pool, filename, offset, size, bytesSent);
-	buf->flags |= flags;
+	auto buf = Buffer::create(pool, gen->worker->getFileCache(), filename, offset, size, bytesSent);
 	if (!buf) {
 		return false;
 	}
 
+	buf->flags |= flags;
+
+	bool direct = !chain && &chain == &output;
+
 	if (!chain.write(buf)) {
 		buf->release();
 		return false;
 	}
 
-	if (!chain && &chain == &output) {
+	if (direct) {
 		auto ret = chain.writeToFd(fd, bytesSent);
 		switch (ret) {
-		case DONE:
-		case SUSPENDED:
+		case DONE: // eos found
+			shutdownWrite();
 			return true;
 			break;
 		case DECLINED:
-			// eos found
 			shutdownWrite();
 			return false;
 			break;
@@ -1046,14 +2045,28 @@ Status ConnectionWorker::Client::runInputFilter(BufferChain &chain) {
 	while (!chain.empty()) {
 		switch (requestState) {
 		case RequestLine: {
+			if (requestsCount == 0 && bytesRead == 0 && !secure && gen->worker->isHttp2Enabled()) {
+				// HTTP/2 with prior knowledge starts with the connection preface instead of request line
+				auto ret = UnixHttp2Session::checkPreface(chain);
+				if (ret == SUSPENDED) {
+					return SUSPENDED;
+				} else if (ret == DONE) {
+					http2 = UnixHttp2Session::create(this);
+					requestState = RequestHttp2;
+					break;
+				}
+			}
+
 			auto ret = checkForReqeust(chain);
 			switch (ret) {
 			case DECLINED:
+				requestState = ReqeustInvalid;
 				return HTTP_REQUEST_ENTITY_TOO_LARGE;
 				break;
 			case DONE:
 				request = gen->worker->readRequest(this, chain);
 				if (!request) {
+					requestState = ReqeustInvalid;
 					shutdownRead();
 					return HTTP_BAD_REQUEST;
 				} else {
@@ -1069,12 +2082,14 @@ Status ConnectionWorker::Client::runInputFilter(BufferChain &chain) {
 			auto ret = checkForHeader(chain);
 			switch (ret) {
 			case DECLINED:
+				requestState = ReqeustInvalid;
 				return HTTP_REQUEST_ENTITY_TOO_LARGE;
 				break;
 			case DONE:
 				ret = gen->worker->parseRequestHeader(request, this, chain);
 				switch (ret) {
 				case DECLINED:
+					requestState = ReqeustInvalid;
 					return HTTP_INTERNAL_SERVER_ERROR;
 					break;
 				case OK:
@@ -1083,6 +2098,7 @@ Status ConnectionWorker::Client::runInputFilter(BufferChain &chain) {
 					requestState = RequestProcess;
 					break;
 				default:
+					requestState = ReqeustInvalid;
 					return ret;
 					break;
 				}
@@ -1092,10 +2108,23 @@ Status ConnectionWorker::Client::runInputFilter(BufferChain &chain) {
 			}
 			break;
 		}
-		case RequestProcess: {
+		case RequestProcess:
+		case RequestOffload: {
 			return HTTP_INTERNAL_SERVER_ERROR;
 			break;
 		}
+		case RequestWebsocket:
+			if (websocket->processInput(chain) == DECLINED) {
+				// Close frame was sent, wait for it to be written
+				return DONE;
+			}
+			break;
+		case RequestHttp2:
+			if (http2->processInput(chain) == DECLINED) {
+				// GOAWAY was sent, wait for it to be written
+				return DONE;
+			}
+			break;
 		case RequestInput: {
 			auto ret = request->processInput(chain);
 			switch (ret) {
@@ -1108,11 +2137,9 @@ Status ConnectionWorker::Client::runInputFilter(BufferChain &chain) {
 			case SUSPENDED:
 				break;
 			case DONE:
-				if (!response.empty()) {
-					write(response, nullptr, 0, Buffer::Flags::Eos);
+				if (!finalizeRequest(DONE)) {
+					return DONE;
 				}
-				requestState = ReqeustInvalid;
-				return DONE;
 				break;
 			default:
 				requestState = ReqeustInvalid;
@@ -1131,53 +2158,150 @@ Status ConnectionWorker::Client::runInputFilter(BufferChain &chain) {
 			break;
 		}
 		if (requestState == RequestProcess) {
-			auto ret = gen->worker->processRequest(request);
-			switch (ret) {
-			case OK:
-			case SUSPENDED:
-				if (request->getInputFilter() && request->getInfo().contentLength > 0) {
-					perform([&] {
-						ret = request->getInputFilter()->init();
-					}, request->getInputFilter()->getPool());
-					if (ret == OK) {
-						requestState = RequestInput;
-					}
+			if (upgradeHttp2()) {
+				// rest of the input is HTTP/2 from the client
+				continue;
+			}
+
+			auto admission = gen->worker->admitRequest(request);
+			if (admission != OK) {
+				// overloaded server answers without processing, so rejection is cheap
+				if (!finalizeRequest(admission)) {
+					return DONE;
 				}
-				break;
-			default:
-				return ret;
-				break;
+				continue;
+			}
+
+			if (gen->worker->offloadRequest(this)) {
+				// rest of the input is processed, when request is returned from handler thread
+				return SUSPENDED;
+			}
+
+			if (!processRequestResult(gen->worker->processRequest(request))) {
+				return DONE;
 			}
 		}
 	}
 	return SUSPENDED;
 }
 
+bool ConnectionWorker::Client::processRequestResult(Status ret) {
+	if (ret == OK || ret == SUSPENDED) {
+		if (request->getInputFilter() && request->getInfo().contentLength > 0) {
+			perform([&] {
+				ret = request->getInputFilter()->init();
+			}, request->getInputFilter()->getPool());
+			if (ret == OK) {
+				// request passed access checks and input limits, client can send the body now;
+				// if body was already sent without waiting, interim response is not needed
+				if (input.empty()) {
+					request->sendContinue();
+				}
+				requestState = RequestInput;
+				request->initInputSplice();
+				return true;
+			}
+		} else {
+			// no input expected, response is ready
+			ret = DONE;
+		}
+	}
+
+	return finalizeRequest(ret);
+}
+
+bool ConnectionWorker::Client::upgradeHttp2() {
+	if (!UnixHttp2Session::isUpgradeRequest(request)) {
+		return false;
+	}
+
+	auto session = UnixHttp2Session::upgrade(this, request);
+	if (!session) {
+		return false;
+	}
+
+	// request was moved into stream 1, HTTP/1.1 request is not needed anymore
+	auto p = request->getPool();
+	request->finalize();
+	pool::destroy(p);
+	request = nullptr;
+
+	http2 = session;
+	requestState = RequestHttp2;
+	bytesRead = input.getBytesRead();
+	input.releaseEmpty();
+	return true;
+}
+
+bool ConnectionWorker::Client::finalizeRequest(Status status) {
+	auto req = request;
+	auto reqPool = req->getPool();
+
+	perform([&] {
+		req->submitResponse(status);
+	}, reqPool, config::TAG_REQUEST, req);
+
+	bool keepAlive = req->isKeepAlive();
+	auto ws = req->getWebsocket();
+
+	request = nullptr;
+	++ requestsCount;
+
+	req->finalize();
+	pool::destroy(reqPool);
+
+	if (ws) {
+		// 101 response was sent, the rest of the input belongs to websocket
+		requestState = RequestWebsocket;
+		websocket = ws;
+		bytesRead = input.getBytesRead();
+		input.releaseEmpty();
+		websocket->begin();
+		return true;
+	}
+
+	if (!keepAlive) {
+		requestState = ReqeustClosed;
+		shutdownRead();
+		return false;
+	}
+
+	// pipelined requests can already be in input, continue from the end of the current one
+	requestState = RequestLine;
+	bytesRead = input.getBytesRead();
+	input.releaseEmpty();
+	return true;
+}
+
 Status ConnectionWorker::Client::checkForReqeust(BufferChain &chain) {
 	bool found = false;
-	return chain.read([&] (const Buffer *buf, const uint8_t *b, size_t s) {
+	auto ret = chain.read([&, this] (const Buffer *buf, const uint8_t *b, size_t s) {
 		if (found) {
 			return int(DONE);
 		}
 
-		if (buf->absolute > config::UNIX_MAX_REQUEST_LINE) {
+		// request line can start in the middle of the buffer on persistent connection
+		auto lineOffset = buf->absolute + buf->offset - bytesRead;
+		if (lineOffset > config::UNIX_MAX_REQUEST_LINE) {
 			return int(DECLINED);
 		}
 
-		StringView r((const char *)b, std::min(s, config::UNIX_MAX_REQUEST_LINE - buf->absolute));
-		r.skipUntil<StringView::Chars<'\n'>>();
-		if (r.is('\n')) {
+		auto len = std::min(s, config::UNIX_MAX_REQUEST_LINE - lineOffset);
+		if (auto lf = UnixHttpParser::findLineEnd(b, len)) {
 			found = true;
-			++ r;
-			return int((const uint8_t *)r.data() - b);
+			return int(lf + 1 - b);
 		}
 
-		if (buf->absolute + s >= config::UNIX_MAX_REQUEST_LINE) {
+		if (lineOffset + s >= config::UNIX_MAX_REQUEST_LINE) {
 			return int(DECLINED);
 		}
 
-		return int((const uint8_t *)r.data() - b);
+		return int(len);
 	}, false);
+	if (ret == OK) {
+		return found ? DONE : OK;
+	}
+	return ret;
 }
 
 Status ConnectionWorker::Client::checkForHeader(BufferChain &chain) {
@@ -1187,23 +2311,34 @@ Status ConnectionWorker::Client::checkForHeader(BufferChain &chain) {
 			return int(DONE);
 		}
 
-		if (buf->absolute > config::UNIX_MAX_HEADER_LINE + bytesRead) {
+		auto lineOffset = buf->absolute + buf->offset - bytesRead;
+		if (lineOffset > config::UNIX_MAX_HEADER_LINE) {
 			return int(DECLINED);
 		}
 
-		StringView r((const char *)b, std::min(s, config::UNIX_MAX_REQUEST_LINE - buf->absolute));
-		r.skipUntil<StringView::Chars<'\n'>>();
-		if (r.is('\n')) {
+		// single pass: colon position is stored for parseRequestHeader, then search continues for the line end
+		auto end = b + std::min(s, config::UNIX_MAX_HEADER_LINE - lineOffset);
+		const uint8_t *lf = nullptr;
+		if (headerColon == maxOf<size_t>()) {
+			lf = UnixHttpParser::findHeaderDelimiter(b, end - b);
+			if (lf && *lf == ':') {
+				headerColon = buf->absolute + buf->offset + (lf - b);
+				lf = UnixHttpParser::findLineEnd(lf + 1, end - lf - 1);
+			}
+		} else {
+			lf = UnixHttpParser::findLineEnd(b, end - b);
+		}
+
+		if (lf) {
 			found = true;
-			++ r;
-			return int((const uint8_t *)r.data() - b);
+			return int(lf + 1 - b);
 		}
 
-		if ((buf->absolute + s) >= config::UNIX_MAX_REQUEST_LINE + bytesRead) {
+		if (lineOffset + s >= config::UNIX_MAX_HEADER_LINE) {
 			return int(DECLINED);
 		}
 
-		return int((const uint8_t *)r.data() - b);
+		return int(end - b);
 	}, false);
 	if (ret == OK) {
 		return found ? DONE : OK;
@@ -1251,18 +2386,39 @@ void ConnectionWorker::Client::cancelWithResult(Status status) {
 
 		write(output, data, Buffer::Flags::Eos);
 	}, pool);
-	shutdownWrite();
 }
 
 ConnectionWorker::Generation::Generation(ConnectionWorker *w, pool_t *p)
 : pool(p), worker(w) { }
 
 ConnectionWorker::Client *ConnectionWorker::Generation::pushFd(int fd, StringView addr, uint16_t port) {
-	auto clientPool = pool::create(pool);
 	ConnectionWorker::Client *ret = nullptr;
 
-	auto memBlock = pool::palloc(clientPool, sizeof(Client));
-	ret = new (memBlock) Client(this, clientPool, fd, addr, port);
+	if (freeList) {
+		// pools of recycled client are already cleared, only the state should be reset
+		ret = freeList;
+		freeList = ret->next;
+		-- freeClients;
+
+		auto alloc = ret->alloc;
+		auto rootPool = ret->rootPool;
+		auto clientPool = ret->pool;
+
+		ret->~Client();
+		ret = new (ret) Client(this, rootPool, clientPool, fd, addr, port);
+		ret->alloc = alloc;
+	} else if (worker->isOffloadEnabled()) {
+		// client's memory is used by handler threads, so it can not share worker's allocator
+		auto alloc = allocator::create();
+		auto rootPool = pool::create(alloc);
+		auto memBlock = pool::palloc(rootPool, sizeof(Client));
+		ret = new (memBlock) Client(this, rootPool, pool::create(rootPool), fd, addr, port);
+		ret->alloc = alloc;
+	} else {
+		auto rootPool = pool::create(pool);
+		auto memBlock = pool::palloc(rootPool, sizeof(Client));
+		ret = new (memBlock) Client(this, rootPool, pool::create(rootPool), fd, addr, port);
+	}
 
 	ret->next = active;
 	ret->prev = nullptr;
@@ -1286,15 +2442,46 @@ void ConnectionWorker::Generation::releaseClient(Client *client) {
 	-- activeClients;
 }
 
+bool ConnectionWorker::Generation::recycleClient(Client *client) {
+	if (endOfLife || freeClients >= config::UNIX_CLIENT_FREE_LIST_SIZE) {
+		return false;
+	}
+
+	// runs cleanups for the response data, pool keeps its memory block for the next connection
+	pool::clear(client->pool);
+
+	client->prev = nullptr;
+	client->next = freeList;
+	freeList = client;
+	++ freeClients;
+	return true;
+}
+
 void ConnectionWorker::Generation::releaseAll() {
+	// clients, left active on shutdown, are not recycled: release closes them and unlinks from
+	// the active list, offload clients also destroy their own root pool and allocator
+	endOfLife = true;
 	while (active) {
-		releaseClient(active);
+		active->release();
+	}
+
+	while (freeList) {
+		auto client = freeList;
+		auto alloc = client->alloc;
+		freeList = client->next;
+		pool::destroy(client->rootPool);
+		if (alloc) {
+			allocator::destroy(alloc);
+		}
 	}
+	freeClients = 0;
 }
 
 ConnectionWorker::Generation *ConnectionWorker::makeGeneration() {
 	auto p = pool::create(thread::ThreadInfo::getThreadInfo()->threadPool);
-	return new (p) Generation(this, p);
+	auto gen = new (p) Generation(this, p);
+	gen->hosts = _root->getHosts();
+	return gen;
 }
 
 }
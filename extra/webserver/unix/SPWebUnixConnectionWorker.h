@@ -24,15 +24,26 @@
 #define EXTRA_WEBSERVER_UNIX_SPWEBUNIXCONNECTIONWORKER_H_
 
 #include "SPWebUnixRoot.h"
+#include "SPWebUnixTimerWheel.h"
+#include "SPWebUnixTaskQueue.h"
+#include "SPWebUnixHttpParser.h"
 #include "SPWebRequestController.h"
 #include "SPThread.h"
 
 #include <sys/epoll.h>
+#include <sys/socket.h>
+#include <deque>
+
+struct ssl_st;
 
 namespace STAPPLER_VERSIONIZED stappler::web {
 
 class UnixRequestController;
+class UnixWebsocketConnection;
 class ConnectionQueue;
+class UringQueue;
+class UnixTlsContext;
+class UnixHttp2Session;
 
 class SP_PUBLIC ConnectionWorker : public thread::Thread {
 public:
@@ -44,6 +55,7 @@ public:
 		filesystem::Stat stat;
 		int fd = -1;
 		uint8_t *extraBuffer;
+		UnixFileCache::File *cached = nullptr; // fd is owned by cache
 	};
 
 	struct Buffer : AllocBase {
@@ -51,6 +63,7 @@ public:
 			None = 0,
 			Eos = 1 << 0,
 			IsOutFile = 1 << 1,
+			Borrowed = 1 << 2, // memory is not owned by buffer and should not be freed
 		};
 
 		Buffer *next = nullptr;
@@ -64,7 +77,10 @@ public:
 		Flags flags = Flags::None;
 
 		static Buffer *create(pool_t *, size_t = 0);
-		static Buffer *create(pool_t *, StringView path, off_t rangeStart, size_t rangeLen = maxOf<size_t>(), size_t = 0);
+		// cache is optional, file is opened directly without it
+		static Buffer *create(pool_t *, UnixFileCache *, StringView path, off_t rangeStart, size_t rangeLen = maxOf<size_t>(), size_t = 0);
+		// range of the file from another buffer, cached file is retained, own descriptor is duplicated
+		static Buffer *create(pool_t *, const BufferFile &, off_t rangeStart, size_t rangeLen, size_t = 0);
 
 		void release();
 
@@ -88,6 +104,9 @@ public:
 		Buffer *back = nullptr;
 		Buffer **tail = nullptr;
 
+		// stream offset for the next buffer, when chain is empty
+		size_t absolute = 0;
+
 		bool eos = false;
 
 		explicit operator bool() const { return front != nullptr; }
@@ -105,17 +124,33 @@ public:
 		bool write(pool_t *, const uint8_t *, size_t, Buffer::Flags flags = Buffer::None);
 		bool write(Buffer *);
 		bool write(BufferChain &);
+
+		// move first bytes into target; buffer on the boundary is split: memory is copied, file range shares descriptor
+		bool split(pool_t *, BufferChain &target, size_t);
+
 		bool readFromFd(pool_t *, int);
 
+		// kTLS socket: FIONREAD counts encrypted bytes, so socket is read until EAGAIN
+		bool readFromTls(pool_t *, int);
+
 		Status read(const Callback<int(const Buffer *, const uint8_t *, size_t)> &, bool release);
 		Status writeToFd(int, size_t &);
 
 		size_t getBytesRead() const;
 
+		// stream offset of the end of the received data
+		size_t getBytesReceived() const;
+
 		BytesView extract(pool_t *, size_t initOffset, size_t blockSize) const;
 
+		// block within a single buffer without copying, empty if block spans buffer boundary
+		BytesView view(size_t initOffset, size_t blockSize) const;
+
 		void releaseEmpty();
 		void clear();
+
+	protected:
+		void releaseFront();
 	};
 
 	struct Client : AllocBase {
@@ -123,16 +158,40 @@ public:
 			RequestLine,
 			RequestHeaders,
 			RequestProcess,
+			RequestOffload, // request is processed on handler thread, client should not be touched by worker
 			RequestInput,
+			RequestWebsocket, // connection was upgraded, input is processed by websocket
+			RequestHttp2, // connection is served with HTTP/2, input is processed by session
 			ReqeustClosed,
 			ReqeustInvalid,
 		};
 
+		// phase of the connection, limited with deadline
+		enum class Deadline {
+			None,
+			Idle, // waiting for the next request
+			Header, // receiving request line and headers
+			Body, // receiving request body with the minimal rate
+			Write, // waiting for the peer to accept pending output
+			Websocket, // no input within websocket TTL
+		};
+
+		struct Timer : TimerWheel::Node {
+			Client *client = nullptr;
+		};
+
 		Client *next = nullptr;
 		Client *prev = nullptr;
 
+		Timer timer;
+		Deadline deadline = Deadline::None;
+		size_t deadlineMark = 0; // progress counter, when deadline was set
+		bool idle = false;
+
 		Generation *gen = nullptr;
-		pool_t *pool = nullptr;
+		allocator_t *alloc = nullptr; // own allocator, when client can be processed on handler thread
+		pool_t *rootPool = nullptr; // connection lifetime pool
+		pool_t *pool = nullptr; // buffers pool, cleared between requests
 
 		BufferChain input;
 		BufferChain output;
@@ -140,20 +199,40 @@ public:
 
 		StringView addr;
 		uint16_t port = 0;
+		char addrBuffer[48]; // fits INET6_ADDRSTRLEN, so client can be reused without allocation
 
 		int fd = -1;
 		struct epoll_event event;
 		bool system = false;
+		bool listener = false; // listening socket, new connections are accepted from it
 		bool valid = true;
 		bool shutdownReadSend = false;
 		bool shutdownWriteSend = false;
+		bool secure = false; // connection was accepted with TLS
+
+		// listener: context for the accepted connections; connection: handshake state,
+		// released when records are handled by the kernel, then socket is used as plaintext
+		UnixTlsContext *tlsContext = nullptr;
+		ssl_st *tls = nullptr;
+
+		// io_uring engine state
+		uint32_t uringOps = 0; // operations in flight, client can not be released until they are completed
+		bool uringRecv = false;
+		bool uringPollOut = false;
+		bool uringClosing = false;
 
 		RequestReadState requestState = RequestReadState::RequestLine;
 		UnixRequestController *request = nullptr;
+		UnixWebsocketConnection *websocket = nullptr;
+		UnixHttp2Session *http2 = nullptr;
 		size_t bytesSent = 0;
 		size_t bytesRead = 0;
 
-		Client(Generation *, pool_t *, int, StringView addr, uint16_t port);
+		// stream offset of ':' in the current header line, found while searching for the line end
+		size_t headerColon = maxOf<size_t>();
+		uint32_t requestsCount = 0;
+
+		Client(Generation *, pool_t *rootPool, pool_t *pool, int, StringView addr, uint16_t port);
 		Client(int fd, int mode);
 
 		void init(int);
@@ -161,10 +240,20 @@ public:
 		void shutdownWrite();
 		void shutdownAll();
 		void release();
+		void reset();
+
+		bool isIdle() const;
+		bool canKeepAlive() const;
 
 		bool performRead();
+		bool performRead(BytesView); // process data, received outside of client
 		bool performWrite();
 
+		// false if handshake failed, and connection should be closed
+		bool performHandshake();
+
+		bool processInput();
+
 		bool write(BufferChain &, BufferChain &);
 		bool write(BufferChain &, const uint8_t *, size_t, Buffer::Flags = Buffer::None);
 		bool write(BufferChain &, StringView, Buffer::Flags = Buffer::None);
@@ -172,6 +261,13 @@ public:
 		bool writeFile(BufferChain &, StringView filename, size_t offset = 0, size_t size = maxOf<size_t>(), Buffer::Flags = Buffer::None);
 
 		Status runInputFilter(BufferChain &);
+		bool finalizeRequest(Status);
+
+		// start reading request body or finalize request, returns false if read side was closed
+		bool processRequestResult(Status);
+
+		// switch to HTTP/2, if request asks for it with Upgrade: h2c
+		bool upgradeHttp2();
 
 		Status checkForReqeust(BufferChain &);
 		Status checkForHeader(BufferChain &);
@@ -185,20 +281,39 @@ public:
 		Client *active = nullptr;
 		size_t activeClients = 0;
 
+		// released clients with cleared pools, reused for the new connections
+		Client *freeList = nullptr;
+		size_t freeClients = 0;
+
 		pool_t *pool = nullptr;
 		ConnectionWorker *worker = nullptr;
+		const UnixRoot::HostSet *hosts = nullptr;
+
+		// generation was replaced on reload or upgrade: no new connections, no keep-alive,
+		// remaining connections are closed after drainDeadline
 		bool endOfLife = false;
+		Time drainDeadline;
 
 		Generation(ConnectionWorker *, pool_t *);
 
 		Client *pushFd(int, StringView addr, uint16_t port);
 		void releaseClient(Client *);
+
+		// returns false if client should be destroyed
+		bool recycleClient(Client *);
 		void releaseAll();
 	};
 
 	static constexpr size_t MaxEvents = 16;
 
-	ConnectionWorker(ConnectionQueue *queue, UnixRoot *, int socket, int pipe, int event);
+	// worker, that runs on the current thread, or nullptr
+	static ConnectionWorker *getCurrent();
+
+	// peer address as text, IPv4 clients of dual-stack sockets are shown as IPv4
+	static StringView getPeerAddress(const struct sockaddr_storage &, char *buf, size_t bufSize, uint16_t &port);
+
+	// one socket for every listener, cpu >= 0 - pin worker thread to the CPU
+	ConnectionWorker(ConnectionQueue *queue, UnixRoot *, SpanView<int> sockets, int pipe, uint32_t index, int cpu = -1);
 	~ConnectionWorker();
 
 	virtual void threadInit() override;
@@ -206,39 +321,179 @@ public:
 	virtual bool worker() override;
 
 	bool poll(int);
+	bool pollUring();
 
 	Root *getRoot() const { return _root; }
+	ConnectionQueue *getQueue() const { return _queue; }
+
+	uint32_t getIndex() const { return _index; }
+
+	TaskDeque &getTasks() { return _tasks; }
+
+	// thread-safe, returns false if worker is busy and will check the tasks by itself
+	bool wakeupIdle();
+
+	// thread-safe, wake up worker unconditionally
+	void wakeup();
+
+	size_t getConnectionsCount() const { return _fdCount.load(); }
+
+	// engine, that was initialized by the worker thread (io_uring falls back to epoll, when not available)
+	UnixEngine getEngine() const { return _engine.load(); }
+
+	UnixFileCache *getFileCache() const { return _root->getFileCache(); }
 
 	std::thread & thread() { return _thisThread; }
 
+	TimeInterval getKeepAliveTimeout() const { return _keepAliveTimeout; }
+	uint32_t getKeepAliveMaxRequests() const { return _keepAliveMaxRequests; }
+
 	void runTask(AsyncTask *);
 
+	bool isWorkerThread() const { return std::this_thread::get_id() == _thisThread.get_id(); }
+
+	// memory for response encoders, reused between requests on this worker
+	pool_t *getCompressionPool() const { return _compressionPool; }
+
+	bool canSplice() const { return _splicePipe[0] >= 0; }
+
+	bool isHttp2Enabled() const { return _http2; }
+
+	// move up to len bytes from socket into file at offset through the worker's pipe,
+	// returns number of bytes written into file (0 if socket is drained) or -1 on error
+	ssize_t spliceToFile(int sock, int file, off_t *offset, size_t len);
+
+	// thread-safe, websocket will be processed on worker thread
+	void scheduleWakeup(UnixWebsocketConnection *);
+	void cancelWakeup(UnixWebsocketConnection *);
+
 	UnixRequestController *readRequest(Client *, BufferChain &chain);
 	Status parseRequestHeader(UnixRequestController *, Client *, BufferChain &chain);
 	Status processRequest(UnixRequestController *);
 
+	// requests can be processed on handler threads
+	bool isOffloadEnabled() const;
+
+	// pass request to handler thread, returns false if it should be processed inline
+	bool offloadRequest(Client *);
+
+	// thread-safe, called by handler thread, client is returned to the worker
+	void completeRequest(Client *, Status);
+
+	// admission control before processing: request is counted as in flight until it's finalized,
+	// admitted request is traced, when tracing is enabled;
+	// returns OK or HTTP_SERVICE_UNAVAILABLE with Retry-After, then request should be finalized without processing
+	Status admitRequest(UnixRequestController *);
+
+	// called, when admitted request is finalized
+	void releaseRequest() { -- _requestsInFlight; }
+
+	// thread-safe for the request's owner, answer request with 503 without processing
+	Status rejectRequest(UnixRequestController *);
+
+	// append spans of the finalized request into the trace log
+	void writeTrace(UnixRequestController *);
+
 protected:
 	Generation *makeGeneration();
-	void pushFd(int epollFd, int fd, StringView addr, uint16_t port);
+	void pushFd(int epollFd, int fd, StringView addr, uint16_t port, UnixTlsContext * = nullptr);
+
+	// start draining current generation, if hosts were replaced or sockets were handed over
+	void updateGeneration();
+
+	// release drained generations, close connections of generations with expired deadline
+	void releaseDrained(Time);
+
+	void stopAccept();
 
 	bool addClient(Client &);
 	void removeClient(Client &);
+	void updateClient(Client &);
+
+	bool addUringClient(Client &);
+	void removeUringClient(Client &);
+	void pollUringOutput(Client &);
+	bool recvUring(Client &);
+	void cancelUringAccept();
+	void processUringCompletion(uint64_t data, int32_t res, uint32_t flags);
+
+	// perform batch of async tasks, returns timeout for the next poll
+	int performTasks();
+	void processWakeup();
+	void processCompletions();
+
+	bool openSplicePipe();
+	void closeSplicePipe();
+	void releaseGenerations();
+
+	// select deadline for the current phase of the connection
+	void updateDeadline(Client &);
+	void setDeadline(Client &, Client::Deadline, TimeInterval, size_t mark);
+	void clearDeadline(Client &);
+	void releaseExpired(Time);
+	void expireClient(Client &);
+
+	int getPollTimeout() const;
 
 	ConnectionQueue *_queue;
 
 	UnixRoot *_root = nullptr;
 
-	Client _inputClient;
+	std::deque<Client> _inputClients;
 	Client _cancelClient;
-	Client _eventClient;
+	Client _wakeupClient;
+	Client _timerClient;
+	Client _notifyClient;
 
 	bool _shouldClose = false;
+	uint32_t _index = 0;
+	int _cpu = -1;
 	int _epollFd = -1;
 	int _signalFd = -1;
 
-	size_t _fdCount = 0;
+	UringQueue *_uring = nullptr;
+
+	pool_t *_compressionPool = nullptr;
+
+	int _splicePipe[2] = { -1, -1 };
+
+	std::atomic<size_t> _fdCount = 0;
+	std::atomic<UnixEngine> _engine = UnixEngine::Epoll;
+
+	TimeInterval _keepAliveTimeout;
+	uint32_t _keepAliveMaxRequests = 0;
+
+	TimeInterval _requestHeaderTimeout;
+	TimeInterval _requestBodyTimeout;
+	size_t _requestBodyMinRate = 0;
+	TimeInterval _writeTimeout;
+	bool _http2 = false;
+
+	// admitted requests of this worker, that are not yet finalized
+	uint32_t _requestsInFlight = 0;
+	TimeInterval _retryAfter;
+
+	std::mutex _wakeupMutex;
+	std::vector<UnixWebsocketConnection *> _wakeupQueue;
+
+	TaskDeque _tasks;
+
+	// requests, processed by handler threads
+	std::mutex _completionMutex;
+	std::vector<std::pair<Client *, Status>> _completions;
+
+	// worker waits for network events, new task should wake it up
+	std::atomic<bool> _idle = false;
+
+	// per-client deadlines, so expired clients are found without scanning generations
+	TimerWheel _deadlines;
 
 	Generation *_generation = nullptr;
+
+	// wakes worker on the nearest drain deadline
+	TimerWheel::Node _drainTimer;
+	bool _draining = false;
+	bool _acceptStopped = false;
 };
 
 SP_DEFINE_ENUM_AS_MASK(ConnectionWorker::Buffer::Flags)
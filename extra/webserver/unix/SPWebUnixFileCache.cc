@@ -0,0 +1,231 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#include "SPWebUnixFileCache.h"
+
+#include <sys/inotify.h>
+
+#ifndef SP_TERMINATED_DATA
+#define SP_TERMINATED_DATA(view) (view.terminated()?view.data():view.str<memory::StandartInterface>().data())
+#endif
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+// IN_ATTRIB is also sent when file is unlinked or replaced with rename, while we keep it open
+static constexpr uint32_t s_FileNotifyMask = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF;
+
+void UnixFileCache::File::release() {
+	if (-- refs == 0) {
+		if (fd >= 0) {
+			::close(fd);
+			fd = -1;
+		}
+		delete this;
+	}
+}
+
+UnixFileCache::~UnixFileCache() {
+	while (!_lru.empty()) {
+		drop(_lru.back());
+	}
+
+	if (_notify >= 0) {
+		::close(_notify);
+		_notify = -1;
+	}
+}
+
+void UnixFileCache::init(size_t limit) {
+	_limit = limit;
+	if (_limit > 0 && _notify < 0) {
+		_notify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (_notify < 0) {
+			log::error("UnixFileCache", "inotify is not available: fall back to timed checks");
+		}
+	}
+}
+
+UnixFileCache::File *UnixFileCache::open(StringView path) {
+	if (_limit == 0) {
+		return nullptr;
+	}
+
+	std::unique_lock lock(_mutex);
+
+	auto it = _files.find(path);
+	if (it != _files.end()) {
+		auto file = it->second;
+		if (file->watch >= 0 || revalidate(file, Time::now())) {
+			_lru.splice(_lru.begin(), _lru, file->lru);
+			file->retain();
+			return file;
+		}
+		drop(file);
+	}
+
+	auto file = load(path);
+	if (file) {
+		file->retain();
+	}
+	return file;
+}
+
+bool UnixFileCache::stat(StringView path, filesystem::Stat &stat) {
+	if (auto file = open(path)) {
+		stat = file->stat;
+		file->release();
+		return true;
+	}
+
+	// not a regular file or cache is disabled
+	if (!filesystem::exists(path)) {
+		return false;
+	}
+
+	filesystem::stat(path, stat);
+	return true;
+}
+
+void UnixFileCache::update() {
+	if (_notify < 0) {
+		return;
+	}
+
+	char buf[4_KiB] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+	std::unique_lock lock(_mutex);
+
+	auto len = ::read(_notify, buf, sizeof(buf));
+	while (len > 0) {
+		const struct inotify_event *event = nullptr;
+		for (char *ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + event->len) {
+			event = (const struct inotify_event *)ptr;
+
+			std::vector<File *> files;
+			auto range = _watches.equal_range(event->wd);
+			for (auto it = range.first; it != range.second; ++ it) {
+				files.emplace_back(it->second);
+			}
+
+			// in-flight responses keep their references, new requests will open file again
+			for (auto &file : files) {
+				drop(file);
+			}
+		}
+		len = ::read(_notify, buf, sizeof(buf));
+	}
+}
+
+UnixFileCache::File *UnixFileCache::load(StringView path) {
+	auto removeWatch = [&, this] (int watch) {
+		if (watch >= 0 && _watches.find(watch) == _watches.end()) {
+			::inotify_rm_watch(_notify, watch);
+		}
+	};
+
+	// watch is added before open, so we will not miss modifications
+	int watch = -1;
+	if (_notify >= 0) {
+		watch = ::inotify_add_watch(_notify, SP_TERMINATED_DATA(path), s_FileNotifyMask);
+		if (watch < 0 && errno == ENOSPC) {
+			log::error("UnixFileCache", "inotify limit is reached: fall back to timed checks");
+		}
+	}
+
+	int fd = ::open(SP_TERMINATED_DATA(path), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		removeWatch(watch);
+		return nullptr;
+	}
+
+	filesystem::Stat stat;
+	filesystem::stat(path, stat);
+	if (stat.type != filesystem::FileType::File) {
+		::close(fd);
+		removeWatch(watch);
+		return nullptr;
+	}
+
+	while (_lru.size() >= _limit) {
+		drop(_lru.back());
+	}
+
+	auto file = new File;
+	file->path = path.str<memory::StandartInterface>();
+	file->stat = stat;
+	file->fd = fd;
+	file->watch = watch;
+	file->checked = Time::now();
+
+	_lru.emplace_front(file);
+	file->lru = _lru.begin();
+
+	_files.emplace(file->path, file);
+	if (watch >= 0) {
+		_watches.emplace(watch, file);
+	}
+
+	return file;
+}
+
+bool UnixFileCache::revalidate(File *file, Time now) {
+	if (now - file->checked < config::UNIX_FILE_CACHE_CHECK_INTERVAL) {
+		return true;
+	}
+
+	filesystem::Stat stat;
+	if (!filesystem::exists(file->path)) {
+		return false;
+	}
+
+	filesystem::stat(file->path, stat);
+	if (stat.mtime != file->stat.mtime || stat.size != file->stat.size) {
+		return false;
+	}
+
+	file->checked = now;
+	return true;
+}
+
+void UnixFileCache::drop(File *file) {
+	_files.erase(file->path);
+	_lru.erase(file->lru);
+
+	if (file->watch >= 0) {
+		auto range = _watches.equal_range(file->watch);
+		for (auto it = range.first; it != range.second; ++ it) {
+			if (it->second == file) {
+				_watches.erase(it);
+				break;
+			}
+		}
+
+		// watch is shared by all paths for the same inode
+		if (_watches.find(file->watch) == _watches.end()) {
+			::inotify_rm_watch(_notify, file->watch);
+		}
+	}
+
+	file->release();
+}
+
+}
@@ -0,0 +1,85 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#ifndef EXTRA_WEBSERVER_UNIX_SPWEBUNIXFILECACHE_H_
+#define EXTRA_WEBSERVER_UNIX_SPWEBUNIXFILECACHE_H_
+
+#include "SPWebUnixConfig.h"
+#include "SPFilesystem.h"
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+// Cache of open file descriptors and stat results for static files, shared between workers
+// Entries are invalidated with inotify, or rechecked with stat, when inotify watch is not available
+class SP_PUBLIC UnixFileCache {
+public:
+	struct File {
+		mem_std::String path;
+		filesystem::Stat stat;
+		int fd = -1;
+		int watch = -1;
+		Time checked;
+		std::atomic<uint32_t> refs = 1; // reference from cache and from every in-flight buffer
+		std::list<File *>::iterator lru;
+
+		void retain() { ++ refs; }
+
+		// file is closed with the last reference
+		void release();
+	};
+
+	~UnixFileCache();
+
+	// limit is a max number of open files, zero disables cache
+	void init(size_t limit);
+
+	bool isEnabled() const { return _limit > 0; }
+
+	// fd for the worker's event loop
+	int getNotify() const { return _notify; }
+
+	// acquire open regular file, should be released with File::release
+	File *open(StringView path);
+
+	// stat for the path, returns false if file does not exist
+	bool stat(StringView path, filesystem::Stat &);
+
+	// process inotify events, drop modified files
+	void update();
+
+protected:
+	File *load(StringView path);
+	bool revalidate(File *, Time now);
+	void drop(File *);
+
+	std::mutex _mutex;
+	int _notify = -1;
+	size_t _limit = 0;
+
+	std::map<mem_std::String, File *, std::less<>> _files;
+	std::multimap<int, File *> _watches; // same inode can be cached with different paths
+	std::list<File *> _lru; // most recent at front
+};
+
+}
+
+#endif /* EXTRA_WEBSERVER_UNIX_SPWEBUNIXFILECACHE_H_ */
@@ -0,0 +1,122 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#include "SPWebUnixHandlerPool.h"
+#include "SPWebUnixRequest.h"
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+UnixHandlerPool::Thread::Thread(UnixHandlerPool *pool) : _pool(pool) {
+	run(thread::ThreadFlags::Joinable);
+}
+
+bool UnixHandlerPool::Thread::worker() {
+	bool rejected = false;
+	auto client = _pool->pop(rejected);
+	if (!client) {
+		return false;
+	}
+
+	auto worker = client->gen->worker;
+	if (rejected) {
+		worker->completeRequest(client, worker->rejectRequest(client->request));
+	} else {
+		worker->completeRequest(client, worker->processRequest(client->request));
+	}
+	return true;
+}
+
+UnixHandlerPool::UnixHandlerPool(pool_t *pool, uint32_t nthreads, TimeInterval delayTarget, TimeInterval delayInterval)
+: _delayTarget(delayTarget), _delayInterval(std::max(delayInterval, delayTarget)), _lastEmpty(Time::now()) {
+	_threads.reserve(nthreads);
+	for (uint32_t i = 0; i < nthreads; ++ i) {
+		_threads.emplace_back(new (pool) Thread(this));
+	}
+}
+
+UnixHandlerPool::~UnixHandlerPool() {
+	cancel();
+}
+
+void UnixHandlerPool::cancel() {
+	_mutex.lock();
+	_finalized = true;
+	_mutex.unlock();
+	_condition.notify_all();
+
+	for (auto &it : _threads) {
+		if (it->thread().joinable()) {
+			it->thread().join();
+		}
+		delete it;
+	}
+	_threads.clear();
+}
+
+bool UnixHandlerPool::push(ConnectionWorker::Client *client) {
+	std::unique_lock lock(_mutex);
+	if (_finalized) {
+		return false;
+	}
+
+	auto now = Time::now();
+	if (_queue.empty()) {
+		_lastEmpty = now;
+	}
+
+	_queue.emplace_back(Entry{client, now});
+	lock.unlock();
+
+	_condition.notify_one();
+	return true;
+}
+
+ConnectionWorker::Client *UnixHandlerPool::pop(bool &rejected) {
+	std::unique_lock lock(_mutex);
+	_condition.wait(lock, [this] {
+		return _finalized || !_queue.empty();
+	});
+
+	if (_queue.empty()) {
+		return nullptr;
+	}
+
+	auto entry = _queue.front();
+	_queue.pop_front();
+
+	auto now = Time::now();
+	if (_delayTarget && !_finalized) {
+		auto priority = entry.client->request->getPriority();
+		auto budget = _delayInterval;
+		if (now - _lastEmpty > _delayInterval || priority == RequestPriority::Low) {
+			budget = _delayTarget;
+		}
+		rejected = priority != RequestPriority::High && now - entry.queued > budget;
+	}
+
+	if (_queue.empty()) {
+		_lastEmpty = now;
+	}
+	return entry.client;
+}
+
+}
@@ -0,0 +1,84 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#ifndef EXTRA_WEBSERVER_UNIX_SPWEBUNIXHANDLERPOOL_H_
+#define EXTRA_WEBSERVER_UNIX_SPWEBUNIXHANDLERPOOL_H_
+
+#include "SPWebUnixConnectionWorker.h"
+
+#include <condition_variable>
+#include <deque>
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+// Threads for request handlers, so slow handler does not stall other connections of the I/O worker
+// Client is owned by handler thread until request is processed, then it's returned to the worker
+class SP_PUBLIC UnixHandlerPool : public AllocBase {
+public:
+	class Thread : public thread::Thread {
+	public:
+		Thread(UnixHandlerPool *);
+
+		virtual bool worker() override;
+
+		std::thread & thread() { return _thisThread; }
+
+	protected:
+		UnixHandlerPool *_pool = nullptr;
+	};
+
+	// delayTarget - queue delay budget for the admission control, zero disables it
+	UnixHandlerPool(pool_t *, uint32_t nthreads, TimeInterval delayTarget = TimeInterval(), TimeInterval delayInterval = TimeInterval());
+	~UnixHandlerPool();
+
+	// process already queued requests, then stop threads
+	void cancel();
+
+	// thread-safe, returns false if pool was stopped, request should be processed by worker itself
+	bool push(ConnectionWorker::Client *);
+
+protected:
+	struct Entry {
+		ConnectionWorker::Client *client;
+		Time queued;
+	};
+
+	// blocks until request is available, returns nullptr when pool is stopped;
+	// rejected - request waited too long and should be answered without processing
+	ConnectionWorker::Client *pop(bool &rejected);
+
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	std::deque<Entry> _queue;
+	std::vector<Thread *> _threads;
+	bool _finalized = false;
+
+	// CoDel-style queue delay control: while queue was empty within the interval, request can wait for
+	// the whole interval; standing queue means overload, then requests can wait only for the target delay
+	TimeInterval _delayTarget;
+	TimeInterval _delayInterval;
+	Time _lastEmpty;
+};
+
+}
+
+#endif /* EXTRA_WEBSERVER_UNIX_SPWEBUNIXHANDLERPOOL_H_ */
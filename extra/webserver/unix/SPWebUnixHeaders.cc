@@ -0,0 +1,308 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#include "SPWebUnixHeaders.h"
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+// should be sorted, index in this table defines iteration order
+static constexpr const char *s_knownHeaders[] = {
+	"accept",
+	"accept-charset",
+	"accept-encoding",
+	"accept-language",
+	"accept-ranges",
+	"access-control-allow-origin",
+	"age",
+	"authorization",
+	"cache-control",
+	"connection",
+	"content-disposition",
+	"content-encoding",
+	"content-language",
+	"content-length",
+	"content-location",
+	"content-md5",
+	"content-range",
+	"content-security-policy",
+	"content-type",
+	"cookie",
+	"date",
+	"etag",
+	"expect",
+	"expires",
+	"forwarded",
+	"host",
+	"if-match",
+	"if-modified-since",
+	"if-none-match",
+	"if-range",
+	"if-unmodified-since",
+	"keep-alive",
+	"last-modified",
+	"link",
+	"location",
+	"origin",
+	"pragma",
+	"range",
+	"referer",
+	"retry-after",
+	"sec-websocket-accept",
+	"sec-websocket-extensions",
+	"sec-websocket-key",
+	"sec-websocket-protocol",
+	"sec-websocket-version",
+	"server",
+	"server-timing",
+	"set-cookie",
+	"strict-transport-security",
+	"te",
+	"trailer",
+	"transfer-encoding",
+	"upgrade",
+	"user-agent",
+	"vary",
+	"via",
+	"www-authenticate",
+	"x-content-type-options",
+	"x-forwarded-for",
+	"x-forwarded-host",
+	"x-forwarded-proto",
+	"x-frame-options",
+	"x-real-ip",
+	"x-request-id",
+	"x-requested-with",
+};
+
+static_assert(sizeof(s_knownHeaders) / sizeof(const char *) == UnixHeaders::KnownCount);
+
+// seed was selected to make FNV-1a slots unique for the known names
+static constexpr uint32_t s_knownHeadersSeed = 12999;
+
+static constexpr size_t s_knownHeaderLength(const char *str) {
+	size_t len = 0;
+	while (str[len]) {
+		++ len;
+	}
+	return len;
+}
+
+static constexpr uint8_t s_lowerHeaderChar(uint8_t c) {
+	return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static constexpr size_t s_knownHeaderSlot(const char *str, size_t len) {
+	uint32_t h = s_knownHeadersSeed;
+	for (size_t i = 0; i < len; ++ i) {
+		h = (h ^ s_lowerHeaderChar(uint8_t(str[i]))) * 16777619u;
+	}
+	return (h >> 16) & (UnixHeaders::SlotCount - 1);
+}
+
+struct UnixKnownHeadersTable {
+	uint8_t slots[UnixHeaders::SlotCount];
+	bool valid = true;
+};
+
+static constexpr UnixKnownHeadersTable s_makeKnownHeadersTable() {
+	UnixKnownHeadersTable ret = { };
+	for (auto &it : ret.slots) {
+		it = 0xFF;
+	}
+
+	for (size_t i = 0; i < UnixHeaders::KnownCount; ++ i) {
+		auto slot = s_knownHeaderSlot(s_knownHeaders[i], s_knownHeaderLength(s_knownHeaders[i]));
+		if (ret.slots[slot] != 0xFF) {
+			ret.valid = false;
+		}
+		ret.slots[slot] = uint8_t(i);
+
+		// names should be sorted for the ordered iteration
+		if (i > 0) {
+			auto prev = s_knownHeaders[i - 1];
+			auto next = s_knownHeaders[i];
+			while (*prev && *prev == *next) {
+				++ prev; ++ next;
+			}
+			if (uint8_t(*prev) >= uint8_t(*next)) {
+				ret.valid = false;
+			}
+		}
+	}
+	return ret;
+}
+
+static constexpr UnixKnownHeadersTable s_knownHeadersTable = s_makeKnownHeadersTable();
+
+static_assert(s_knownHeadersTable.valid, "Known headers should be sorted and should have a perfect hash, select another seed");
+
+static bool s_isEqualLowercase(StringView name, StringView lower) {
+	if (name.size() != lower.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < name.size(); ++ i) {
+		if (s_lowerHeaderChar(uint8_t(name[i])) != uint8_t(lower[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// compares arbitrary case name with lowercased one
+static int s_compareLowercase(StringView name, StringView lower) {
+	auto len = std::min(name.size(), lower.size());
+	for (size_t i = 0; i < len; ++ i) {
+		auto a = s_lowerHeaderChar(uint8_t(name[i]));
+		auto b = uint8_t(lower[i]);
+		if (a != b) {
+			return (a < b) ? -1 : 1;
+		}
+	}
+	return (name.size() == lower.size()) ? 0 : ((name.size() < lower.size()) ? -1 : 1);
+}
+
+int UnixHeaders::getKnownIndex(StringView name) {
+	if (name.empty()) {
+		return -1;
+	}
+
+	auto idx = s_knownHeadersTable.slots[s_knownHeaderSlot(name.data(), name.size())];
+	if (idx == 0xFF || !s_isEqualLowercase(name, StringView(s_knownHeaders[idx]))) {
+		return -1;
+	}
+	return idx;
+}
+
+StringView UnixHeaders::getKnownName(size_t idx) {
+	return (idx < KnownCount) ? StringView(s_knownHeaders[idx]) : StringView();
+}
+
+UnixHeaders::UnixHeaders(pool_t *p) : _pool(p) { }
+
+StringView UnixHeaders::get(StringView name) const {
+	auto idx = getKnownIndex(name);
+	if (idx >= 0) {
+		return _knownMask.test(idx) ? _known[idx] : StringView();
+	}
+
+	auto it = std::lower_bound(_other.begin(), _other.end(), name, [] (const Pair<StringView, StringView> &l, StringView r) {
+		return s_compareLowercase(r, l.first) > 0;
+	});
+	if (it != _other.end() && s_isEqualLowercase(name, it->first)) {
+		return it->second;
+	}
+	return StringView();
+}
+
+bool UnixHeaders::contains(StringView name) const {
+	auto idx = getKnownIndex(name);
+	if (idx >= 0) {
+		return _knownMask.test(idx);
+	}
+
+	auto it = std::lower_bound(_other.begin(), _other.end(), name, [] (const Pair<StringView, StringView> &l, StringView r) {
+		return s_compareLowercase(r, l.first) > 0;
+	});
+	return it != _other.end() && s_isEqualLowercase(name, it->first);
+}
+
+StringView UnixHeaders::set(StringView name, StringView value) {
+	auto idx = getKnownIndex(name);
+	if (idx >= 0) {
+		_known[idx] = value.pdup(_pool);
+		_knownMask.set(idx);
+		return StringView(s_knownHeaders[idx]);
+	}
+
+	auto it = std::lower_bound(_other.begin(), _other.end(), name, [] (const Pair<StringView, StringView> &l, StringView r) {
+		return s_compareLowercase(r, l.first) > 0;
+	});
+	if (it != _other.end() && s_isEqualLowercase(name, it->first)) {
+		it->second = value.pdup(_pool);
+		return it->first;
+	}
+
+	auto buf = (char *)pool::palloc(_pool, name.size() + 1);
+	for (size_t i = 0; i < name.size(); ++ i) {
+		buf[i] = char(s_lowerHeaderChar(uint8_t(name[i])));
+	}
+	buf[name.size()] = 0;
+
+	it = _other.emplace(it, StringView(buf, name.size()), value.pdup(_pool));
+	return it->first;
+}
+
+bool UnixHeaders::erase(StringView name) {
+	auto idx = getKnownIndex(name);
+	if (idx >= 0) {
+		if (!_knownMask.test(idx)) {
+			return false;
+		}
+		_knownMask.reset(idx);
+		_known[idx] = StringView();
+		return true;
+	}
+
+	auto it = std::lower_bound(_other.begin(), _other.end(), name, [] (const Pair<StringView, StringView> &l, StringView r) {
+		return s_compareLowercase(r, l.first) > 0;
+	});
+	if (it != _other.end() && s_isEqualLowercase(name, it->first)) {
+		_other.erase(it);
+		return true;
+	}
+	return false;
+}
+
+void UnixHeaders::clear() {
+	_knownMask.reset();
+	_other.clear();
+}
+
+bool UnixHeaders::empty() const {
+	return _knownMask.none() && _other.empty();
+}
+
+void UnixHeaders::foreach(const Callback<void(StringView, StringView)> &cb) const {
+	// merge of two sorted sequences
+	size_t known = 0;
+	auto other = _other.begin();
+
+	auto nextKnown = [&] {
+		while (known < KnownCount && !_knownMask.test(known)) {
+			++ known;
+		}
+	};
+
+	nextKnown();
+	while (known < KnownCount || other != _other.end()) {
+		if (other == _other.end() || (known < KnownCount && StringView(s_knownHeaders[known]) < other->first)) {
+			cb(StringView(s_knownHeaders[known]), _known[known]);
+			++ known;
+			nextKnown();
+		} else {
+			cb(other->first, other->second);
+			++ other;
+		}
+	}
+}
+
+}
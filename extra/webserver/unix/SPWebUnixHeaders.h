@@ -0,0 +1,68 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#ifndef EXTRA_WEBSERVER_UNIX_SPWEBUNIXHEADERS_H_
+#define EXTRA_WEBSERVER_UNIX_SPWEBUNIXHEADERS_H_
+
+#include "SPWebUnixConfig.h"
+
+#include <bitset>
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+// Case-insensitive header table: well-known names are found with a compile-time perfect hash,
+// other names are stored in a sorted overflow vector. Names are stored lowercased.
+// Iteration is in name order, as for Map<StringView, StringView>
+class SP_PUBLIC UnixHeaders {
+public:
+	static constexpr size_t KnownCount = 65;
+	static constexpr size_t SlotCount = 256;
+
+	// index of a well-known header name, or -1
+	static int getKnownIndex(StringView);
+	static StringView getKnownName(size_t);
+
+	UnixHeaders(pool_t *);
+
+	StringView get(StringView) const;
+	bool contains(StringView) const;
+
+	// returns stored lowercased name
+	StringView set(StringView, StringView);
+
+	bool erase(StringView);
+	void clear();
+
+	bool empty() const;
+
+	void foreach(const Callback<void(StringView, StringView)> &) const;
+
+protected:
+	pool_t *_pool = nullptr;
+	std::bitset<KnownCount> _knownMask;
+	StringView _known[KnownCount];
+	Vector<Pair<StringView, StringView>> _other;
+};
+
+}
+
+#endif /* EXTRA_WEBSERVER_UNIX_SPWEBUNIXHEADERS_H_ */
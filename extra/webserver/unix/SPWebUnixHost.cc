@@ -53,6 +53,20 @@ UnixHostController::UnixHostController(Root *root, pool_t *p, UnixHostConfig &cf
 	}
 }
 
+bool UnixHostController::acquireRequest(uint32_t limit) {
+	auto current = _requestsInFlight.load();
+	do {
+		if (limit && current >= limit) {
+			return false;
+		}
+	} while (!_requestsInFlight.compare_exchange_weak(current, current + 1));
+	return true;
+}
+
+void UnixHostController::releaseRequest() {
+	-- _requestsInFlight;
+}
+
 bool UnixHostController::simulateWebsocket(UnixWebsocketSim *sim, StringView url) {
 	auto tmp = url;
 	auto sub = tmp.readUntil<StringView::Chars<'?'>>();
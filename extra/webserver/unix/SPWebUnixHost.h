@@ -35,6 +35,13 @@ public:
 	UnixHostController(Root *, pool_t *, UnixHostConfig &);
 
 	bool simulateWebsocket(UnixWebsocketSim *sim, StringView url);
+
+	// thread-safe, in-flight requests of the host across all workers; zero limit - request is only counted
+	bool acquireRequest(uint32_t limit);
+	void releaseRequest();
+
+protected:
+	std::atomic<uint32_t> _requestsInFlight = 0;
 };
 
 }
@@ -0,0 +1,1626 @@
+/**
+ Copyright (c) 2025 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#include "SPWebUnixHttp2.h"
+#include "SPWebUnixConfig.h"
+#include "SPWebRequestFilter.h"
+#include "SPWebInputFilter.h"
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+static constexpr uint8_t HTTP2_FLAG_END_STREAM = 0x1;
+static constexpr uint8_t HTTP2_FLAG_ACK = 0x1;
+static constexpr uint8_t HTTP2_FLAG_END_HEADERS = 0x4;
+static constexpr uint8_t HTTP2_FLAG_PADDED = 0x8;
+static constexpr uint8_t HTTP2_FLAG_PRIORITY = 0x20;
+
+static constexpr uint16_t HTTP2_SETTINGS_ENABLE_PUSH = 0x2;
+static constexpr uint16_t HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS = 0x3;
+static constexpr uint16_t HTTP2_SETTINGS_INITIAL_WINDOW_SIZE = 0x4;
+static constexpr uint16_t HTTP2_SETTINGS_MAX_FRAME_SIZE = 0x5;
+static constexpr uint16_t HTTP2_SETTINGS_MAX_HEADER_LIST_SIZE = 0x6;
+
+static constexpr int64_t HTTP2_MAX_WINDOW = 0x7fff'ffff;
+static constexpr size_t HTTP2_DEFAULT_WINDOW = 65'535;
+
+// we do not announce larger SETTINGS_MAX_FRAME_SIZE, so it's the limit for the input frames
+static constexpr size_t HTTP2_MAX_FRAME_SIZE = 16_KiB;
+
+struct HpackStaticEntry {
+	StringView name;
+	StringView value;
+};
+
+// RFC 7541 Appendix A
+static constexpr HpackStaticEntry s_hpackStaticTable[] = {
+	{ ":authority", "" },
+	{ ":method", "GET" },
+	{ ":method", "POST" },
+	{ ":path", "/" },
+	{ ":path", "/index.html" },
+	{ ":scheme", "http" },
+	{ ":scheme", "https" },
+	{ ":status", "200" },
+	{ ":status", "204" },
+	{ ":status", "206" },
+	{ ":status", "304" },
+	{ ":status", "400" },
+	{ ":status", "404" },
+	{ ":status", "500" },
+	{ "accept-charset", "" },
+	{ "accept-encoding", "gzip, deflate" },
+	{ "accept-language", "" },
+	{ "accept-ranges", "" },
+	{ "accept", "" },
+	{ "access-control-allow-origin", "" },
+	{ "age", "" },
+	{ "allow", "" },
+	{ "authorization", "" },
+	{ "cache-control", "" },
+	{ "content-disposition", "" },
+	{ "content-encoding", "" },
+	{ "content-language", "" },
+	{ "content-length", "" },
+	{ "content-location", "" },
+	{ "content-range", "" },
+	{ "content-type", "" },
+	{ "cookie", "" },
+	{ "date", "" },
+	{ "etag", "" },
+	{ "expect", "" },
+	{ "expires", "" },
+	{ "from", "" },
+	{ "host", "" },
+	{ "if-match", "" },
+	{ "if-modified-since", "" },
+	{ "if-none-match", "" },
+	{ "if-range", "" },
+	{ "if-unmodified-since", "" },
+	{ "last-modified", "" },
+	{ "link", "" },
+	{ "location", "" },
+	{ "max-forwards", "" },
+	{ "proxy-authenticate", "" },
+	{ "proxy-authorization", "" },
+	{ "range", "" },
+	{ "referer", "" },
+	{ "refresh", "" },
+	{ "retry-after", "" },
+	{ "server", "" },
+	{ "set-cookie", "" },
+	{ "strict-transport-security", "" },
+	{ "transfer-encoding", "" },
+	{ "user-agent", "" },
+	{ "vary", "" },
+	{ "via", "" },
+	{ "www-authenticate", "" },
+};
+
+static constexpr size_t HPACK_STATIC_TABLE_SIZE = sizeof(s_hpackStaticTable) / sizeof(HpackStaticEntry);
+
+struct HpackHuffmanCode {
+	uint32_t code;
+	uint8_t len;
+};
+
+// RFC 7541 Appendix B, the last one is EOS
+static constexpr HpackHuffmanCode s_hpackHuffmanCodes[257] = {
+	{ 0x1ff8, 13 }, { 0x7fffd8, 23 }, { 0xfffffe2, 28 }, { 0xfffffe3, 28 },
+	{ 0xfffffe4, 28 }, { 0xfffffe5, 28 }, { 0xfffffe6, 28 }, { 0xfffffe7, 28 },
+	{ 0xfffffe8, 28 }, { 0xffffea, 24 }, { 0x3ffffffc, 30 }, { 0xfffffe9, 28 },
+	{ 0xfffffea, 28 }, { 0x3ffffffd, 30 }, { 0xfffffeb, 28 }, { 0xfffffec, 28 },
+	{ 0xfffffed, 28 }, { 0xfffffee, 28 }, { 0xfffffef, 28 }, { 0xffffff0, 28 },
+	{ 0xffffff1, 28 }, { 0xffffff2, 28 }, { 0x3ffffffe, 30 }, { 0xffffff3, 28 },
+	{ 0xffffff4, 28 }, { 0xffffff5, 28 }, { 0xffffff6, 28 }, { 0xffffff7, 28 },
+	{ 0xffffff8, 28 }, { 0xffffff9, 28 }, { 0xffffffa, 28 }, { 0xffffffb, 28 },
+	{ 0x14, 6 }, { 0x3f8, 10 }, { 0x3f9, 10 }, { 0xffa, 12 },
+	{ 0x1ff9, 13 }, { 0x15, 6 }, { 0xf8, 8 }, { 0x7fa, 11 },
+	{ 0x3fa, 10 }, { 0x3fb, 10 }, { 0xf9, 8 }, { 0x7fb, 11 },
+	{ 0xfa, 8 }, { 0x16, 6 }, { 0x17, 6 }, { 0x18, 6 },
+	{ 0x0, 5 }, { 0x1, 5 }, { 0x2, 5 }, { 0x19, 6 },
+	{ 0x1a, 6 }, { 0x1b, 6 }, { 0x1c, 6 }, { 0x1d, 6 },
+	{ 0x1e, 6 }, { 0x1f, 6 }, { 0x5c, 7 }, { 0xfb, 8 },
+	{ 0x7ffc, 15 }, { 0x20, 6 }, { 0xffb, 12 }, { 0x3fc, 10 },
+	{ 0x1ffa, 13 }, { 0x21, 6 }, { 0x5d, 7 }, { 0x5e, 7 },
+	{ 0x5f, 7 }, { 0x60, 7 }, { 0x61, 7 }, { 0x62, 7 },
+	{ 0x63, 7 }, { 0x64, 7 }, { 0x65, 7 }, { 0x66, 7 },
+	{ 0x67, 7 }, { 0x68, 7 }, { 0x69, 7 }, { 0x6a, 7 },
+	{ 0x6b, 7 }, { 0x6c, 7 }, { 0x6d, 7 }, { 0x6e, 7 },
+	{ 0x6f, 7 }, { 0x70, 7 }, { 0x71, 7 }, { 0x72, 7 },
+	{ 0xfc, 8 }, { 0x73, 7 }, { 0xfd, 8 }, { 0x1ffb, 13 },
+	{ 0x7fff0, 19 }, { 0x1ffc, 13 }, { 0x3ffc, 14 }, { 0x22, 6 },
+	{ 0x7ffd, 15 }, { 0x3, 5 }, { 0x23, 6 }, { 0x4, 5 },
+	{ 0x24, 6 }, { 0x5, 5 }, { 0x25, 6 }, { 0x26, 6 },
+	{ 0x27, 6 }, { 0x6, 5 }, { 0x74, 7 }, { 0x75, 7 },
+	{ 0x28, 6 }, { 0x29, 6 }, { 0x2a, 6 }, { 0x7, 5 },
+	{ 0x2b, 6 }, { 0x76, 7 }, { 0x2c, 6 }, { 0x8, 5 },
+	{ 0x9, 5 }, { 0x2d, 6 }, { 0x77, 7 }, { 0x78, 7 },
+	{ 0x79, 7 }, { 0x7a, 7 }, { 0x7b, 7 }, { 0x7ffe, 15 },
+	{ 0x7fc, 11 }, { 0x3ffd, 14 }, { 0x1ffd, 13 }, { 0xffffffc, 28 },
+	{ 0xfffe6, 20 }, { 0x3fffd2, 22 }, { 0xfffe7, 20 }, { 0xfffe8, 20 },
+	{ 0x3fffd3, 22 }, { 0x3fffd4, 22 }, { 0x3fffd5, 22 }, { 0x7fffd9, 23 },
+	{ 0x3fffd6, 22 }, { 0x7fffda, 23 }, { 0x7fffdb, 23 }, { 0x7fffdc, 23 },
+	{ 0x7fffdd, 23 }, { 0x7fffde, 23 }, { 0xffffeb, 24 }, { 0x7fffdf, 23 },
+	{ 0xffffec, 24 }, { 0xffffed, 24 }, { 0x3fffd7, 22 }, { 0x7fffe0, 23 },
+	{ 0xffffee, 24 }, { 0x7fffe1, 23 }, { 0x7fffe2, 23 }, { 0x7fffe3, 23 },
+	{ 0x7fffe4, 23 }, { 0x1fffdc, 21 }, { 0x3fffd8, 22 }, { 0x7fffe5, 23 },
+	{ 0x3fffd9, 22 }, { 0x7fffe6, 23 }, { 0x7fffe7, 23 }, { 0xffffef, 24 },
+	{ 0x3fffda, 22 }, { 0x1fffdd, 21 }, { 0xfffe9, 20 }, { 0x3fffdb, 22 },
+	{ 0x3fffdc, 22 }, { 0x7fffe8, 23 }, { 0x7fffe9, 23 }, { 0x1fffde, 21 },
+	{ 0x7fffea, 23 }, { 0x3fffdd, 22 }, { 0x3fffde, 22 }, { 0xfffff0, 24 },
+	{ 0x1fffdf, 21 }, { 0x3fffdf, 22 }, { 0x7fffeb, 23 }, { 0x7fffec, 23 },
+	{ 0x1fffe0, 21 }, { 0x1fffe1, 21 }, { 0x3fffe0, 22 }, { 0x1fffe2, 21 },
+	{ 0x7fffed, 23 }, { 0x3fffe1, 22 }, { 0x7fffee, 23 }, { 0x7fffef, 23 },
+	{ 0xfffea, 20 }, { 0x3fffe2, 22 }, { 0x3fffe3, 22 }, { 0x3fffe4, 22 },
+	{ 0x7ffff0, 23 }, { 0x3fffe5, 22 }, { 0x3fffe6, 22 }, { 0x7ffff1, 23 },
+	{ 0x3ffffe0, 26 }, { 0x3ffffe1, 26 }, { 0xfffeb, 20 }, { 0x7fff1, 19 },
+	{ 0x3fffe7, 22 }, { 0x7ffff2, 23 }, { 0x3fffe8, 22 }, { 0x1ffffec, 25 },
+	{ 0x3ffffe2, 26 }, { 0x3ffffe3, 26 }, { 0x3ffffe4, 26 }, { 0x7ffffde, 27 },
+	{ 0x7ffffdf, 27 }, { 0x3ffffe5, 26 }, { 0xfffff1, 24 }, { 0x1ffffed, 25 },
+	{ 0x7fff2, 19 }, { 0x1fffe3, 21 }, { 0x3ffffe6, 26 }, { 0x7ffffe0, 27 },
+	{ 0x7ffffe1, 27 }, { 0x3ffffe7, 26 }, { 0x7ffffe2, 27 }, { 0xfffff2, 24 },
+	{ 0x1fffe4, 21 }, { 0x1fffe5, 21 }, { 0x3ffffe8, 26 }, { 0x3ffffe9, 26 },
+	{ 0xffffffd, 28 }, { 0x7ffffe3, 27 }, { 0x7ffffe4, 27 }, { 0x7ffffe5, 27 },
+	{ 0xfffec, 20 }, { 0xfffff3, 24 }, { 0xfffed, 20 }, { 0x1fffe6, 21 },
+	{ 0x3fffe9, 22 }, { 0x1fffe7, 21 }, { 0x1fffe8, 21 }, { 0x7ffff3, 23 },
+	{ 0x3fffea, 22 }, { 0x3fffeb, 22 }, { 0x1ffffee, 25 }, { 0x1ffffef, 25 },
+	{ 0xfffff4, 24 }, { 0xfffff5, 24 }, { 0x3ffffea, 26 }, { 0x7ffff4, 23 },
+	{ 0x3ffffeb, 26 }, { 0x7ffffe6, 27 }, { 0x3ffffec, 26 }, { 0x3ffffed, 26 },
+	{ 0x7ffffe7, 27 }, { 0x7ffffe8, 27 }, { 0x7ffffe9, 27 }, { 0x7ffffea, 27 },
+	{ 0x7ffffeb, 27 }, { 0xffffffe, 28 }, { 0x7ffffec, 27 }, { 0x7ffffed, 27 },
+	{ 0x7ffffee, 27 }, { 0x7ffffef, 27 }, { 0x7fffff0, 27 }, { 0x3ffffee, 26 },
+	{ 0x3fffffff, 30 }
+};
+
+// decoding tree for the Huffman code: internal nodes, leaf is stored as negative (symbol + 1)
+struct HpackHuffmanTree {
+	int16_t nodes[256][2];
+
+	HpackHuffmanTree() {
+		::memset(nodes, 0, sizeof(nodes));
+
+		int16_t count = 1;
+		for (int16_t sym = 0; sym < 257; ++ sym) {
+			auto &c = s_hpackHuffmanCodes[sym];
+			int16_t node = 0;
+			for (auto bit = c.len - 1; bit > 0; -- bit) {
+				auto b = (c.code >> bit) & 1;
+				if (nodes[node][b] == 0) {
+					nodes[node][b] = count ++;
+				}
+				node = nodes[node][b];
+			}
+			nodes[node][c.code & 1] = -(sym + 1);
+		}
+	}
+};
+
+static bool s_decodeHpackHuffman(const uint8_t *data, size_t len, mem_std::String &out) {
+	static HpackHuffmanTree tree;
+
+	int16_t node = 0;
+	uint32_t padBits = 0;
+	bool padOnes = true;
+
+	for (size_t i = 0; i < len; ++ i) {
+		for (int bit = 7; bit >= 0; -- bit) {
+			auto b = (data[i] >> bit) & 1;
+			auto next = tree.nodes[node][b];
+			if (next < 0) {
+				auto sym = -next - 1;
+				if (sym == 256) {
+					// EOS in the string is a decoding error
+					return false;
+				}
+				out.push_back(char(sym));
+				node = 0;
+				padBits = 0;
+				padOnes = true;
+			} else {
+				node = next;
+				++ padBits;
+				padOnes = padOnes && b;
+			}
+		}
+	}
+
+	// padding should be the most significant bits of EOS, not longer than 7 bits
+	return padBits <= 7 && padOnes;
+}
+
+static bool s_readHpackInteger(const uint8_t *&ptr, const uint8_t *end, uint8_t prefix, uint32_t &out) {
+	if (ptr >= end) {
+		return false;
+	}
+
+	uint32_t mask = (1 << prefix) - 1;
+	uint64_t value = *(ptr ++) & mask;
+	if (value < mask) {
+		out = uint32_t(value);
+		return true;
+	}
+
+	uint32_t shift = 0;
+	while (ptr < end) {
+		auto b = *(ptr ++);
+		value += uint64_t(b & 0x7f) << shift;
+		if (value > maxOf<uint32_t>()) {
+			return false;
+		}
+		if ((b & 0x80) == 0) {
+			out = uint32_t(value);
+			return true;
+		}
+		shift += 7;
+		if (shift > 28) {
+			return false;
+		}
+	}
+	return false;
+}
+
+// raw string is returned without copying, Huffman-encoded one is decoded into buffer
+static bool s_readHpackString(const uint8_t *&ptr, const uint8_t *end, mem_std::String &buf, StringView &out) {
+	if (ptr >= end) {
+		return false;
+	}
+
+	bool huffman = (*ptr & 0x80) != 0;
+	uint32_t len = 0;
+	if (!s_readHpackInteger(ptr, end, 7, len) || len > size_t(end - ptr)) {
+		return false;
+	}
+
+	if (huffman) {
+		buf.clear();
+		if (!s_decodeHpackHuffman(ptr, len, buf)) {
+			return false;
+		}
+		out = StringView(buf.data(), buf.size());
+	} else {
+		out = StringView((const char *)ptr, len);
+	}
+	ptr += len;
+	return true;
+}
+
+static void s_writeHpackInteger(mem_std::Bytes &out, uint8_t flags, uint8_t prefix, uint32_t value) {
+	uint32_t mask = (1 << prefix) - 1;
+	if (value < mask) {
+		out.push_back(uint8_t(flags | value));
+		return;
+	}
+
+	out.push_back(uint8_t(flags | mask));
+	value -= mask;
+	while (value >= 0x80) {
+		out.push_back(uint8_t(0x80 | (value & 0x7f)));
+		value >>= 7;
+	}
+	out.push_back(uint8_t(value));
+}
+
+// RFC 9113 8.2.2: connection-specific fields are not used in HTTP/2
+static bool s_isConnectionHeader(StringView name) {
+	return name == "connection" || name == "keep-alive" || name == "proxy-connection"
+			|| name == "transfer-encoding" || name == "upgrade";
+}
+
+static bool s_hasUpgradeToken(StringView value, StringView token) {
+	bool found = false;
+	string::split(value, ",", [&] (StringView v) {
+		v.trimChars<StringView::WhiteSpace>();
+		if (v.size() == token.size() && ::strncasecmp(v.data(), token.data(), v.size()) == 0) {
+			found = true;
+		}
+	});
+	return found;
+}
+
+static void s_writeUint32(uint8_t *buf, uint32_t value) {
+	buf[0] = uint8_t(value >> 24);
+	buf[1] = uint8_t(value >> 16);
+	buf[2] = uint8_t(value >> 8);
+	buf[3] = uint8_t(value);
+}
+
+static uint32_t s_readUint32(const uint8_t *buf) {
+	return (uint32_t(buf[0]) << 24) | (uint32_t(buf[1]) << 16) | (uint32_t(buf[2]) << 8) | uint32_t(buf[3]);
+}
+
+static void s_writeFrameHeader(uint8_t *buf, size_t len, UnixHttp2Session::FrameType type, uint8_t flags, uint32_t id) {
+	buf[0] = uint8_t(len >> 16);
+	buf[1] = uint8_t(len >> 8);
+	buf[2] = uint8_t(len);
+	buf[3] = uint8_t(type);
+	buf[4] = flags;
+	s_writeUint32(buf + 5, id & 0x7fff'ffff);
+}
+
+static void s_writeSetting(uint8_t *buf, uint16_t id, uint32_t value) {
+	buf[0] = uint8_t(id >> 8);
+	buf[1] = uint8_t(id);
+	s_writeUint32(buf + 2, value);
+}
+
+bool UnixHpackDecoder::decode(BytesView block, const Callback<void(StringView, StringView)> &cb) {
+	mem_std::String nameBuf;
+	mem_std::String valueBuf;
+
+	auto ptr = block.data();
+	auto end = ptr + block.size();
+	bool fieldFound = false;
+
+	while (ptr < end) {
+		auto b = *ptr;
+		StringView name;
+		StringView value;
+		uint32_t index = 0;
+
+		if ((b & 0x80) != 0) {
+			// indexed field
+			if (!s_readHpackInteger(ptr, end, 7, index) || !getEntry(index, name, value)) {
+				return false;
+			}
+			cb(name, value);
+		} else if ((b & 0xe0) == 0x20) {
+			// dynamic table size update, only at the beginning of the block
+			if (fieldFound || !s_readHpackInteger(ptr, end, 5, index) || index > TableSize) {
+				return false;
+			}
+			_maxTableSize = index;
+			evict(_maxTableSize);
+			continue;
+		} else {
+			// literal field: with incremental indexing, without indexing or never indexed
+			bool indexing = (b & 0xc0) == 0x40;
+			if (!s_readHpackInteger(ptr, end, indexing ? 6 : 4, index)) {
+				return false;
+			}
+
+			if (index > 0) {
+				StringView tmp;
+				if (!getEntry(index, name, tmp)) {
+					return false;
+				}
+			} else if (!s_readHpackString(ptr, end, nameBuf, name)) {
+				return false;
+			}
+
+			if (!s_readHpackString(ptr, end, valueBuf, value)) {
+				return false;
+			}
+
+			if (indexing) {
+				// name can refer to the entry, that will be evicted, so it's copied first
+				Entry entry{mem_std::String(name.data(), name.size()), mem_std::String(value.data(), value.size())};
+				cb(StringView(entry.name.data(), entry.name.size()), StringView(entry.value.data(), entry.value.size()));
+				insert(move(entry));
+			} else {
+				cb(name, value);
+			}
+		}
+		fieldFound = true;
+	}
+	return true;
+}
+
+bool UnixHpackDecoder::getEntry(uint32_t index, StringView &name, StringView &value) const {
+	if (index == 0) {
+		return false;
+	}
+
+	if (index <= HPACK_STATIC_TABLE_SIZE) {
+		name = s_hpackStaticTable[index - 1].name;
+		value = s_hpackStaticTable[index - 1].value;
+		return true;
+	}
+
+	index -= HPACK_STATIC_TABLE_SIZE + 1;
+	if (index >= _table.size()) {
+		return false;
+	}
+
+	auto &entry = _table[index];
+	name = StringView(entry.name.data(), entry.name.size());
+	value = StringView(entry.value.data(), entry.value.size());
+	return true;
+}
+
+void UnixHpackDecoder::insert(Entry &&entry) {
+	// RFC 7541 4.4: entry, larger than the table, just empties it
+	auto size = entry.name.size() + entry.value.size() + 32;
+	if (size > _maxTableSize) {
+		evict(0);
+		return;
+	}
+
+	evict(_maxTableSize - size);
+	_tableSize += size;
+	_table.emplace_front(move(entry));
+}
+
+void UnixHpackDecoder::evict(size_t maxSize) {
+	while (_tableSize > maxSize && !_table.empty()) {
+		auto &entry = _table.back();
+		_tableSize -= entry.name.size() + entry.value.size() + 32;
+		_table.pop_back();
+	}
+}
+
+void UnixHpackEncoder::writeStatus(mem_std::Bytes &out, int status) {
+	switch (status) {
+	case 200: out.push_back(0x80 | 8); return; break;
+	case 204: out.push_back(0x80 | 9); return; break;
+	case 206: out.push_back(0x80 | 10); return; break;
+	case 304: out.push_back(0x80 | 11); return; break;
+	case 400: out.push_back(0x80 | 12); return; break;
+	case 404: out.push_back(0x80 | 13); return; break;
+	case 500: out.push_back(0x80 | 14); return; break;
+	default: break;
+	}
+
+	if (status < 100 || status > 999) {
+		status = 500;
+	}
+
+	// literal without indexing with :status name from the static table
+	s_writeHpackInteger(out, 0x00, 4, 8);
+	s_writeHpackInteger(out, 0x00, 7, 3);
+	out.push_back(uint8_t('0' + status / 100));
+	out.push_back(uint8_t('0' + (status / 10) % 10));
+	out.push_back(uint8_t('0' + status % 10));
+}
+
+void UnixHpackEncoder::writeHeader(mem_std::Bytes &out, StringView name, StringView value) {
+	// HTTP/2 field names are lowercase
+	mem_std::String buf(name.data(), name.size());
+	string::apply_tolower_c(buf);
+
+	StringView lowercase(buf.data(), buf.size());
+	if (s_isConnectionHeader(lowercase)) {
+		return;
+	}
+
+	// name from the static table, pseudo-header entries are skipped
+	uint32_t index = 0;
+	for (size_t i = 14; i < HPACK_STATIC_TABLE_SIZE; ++ i) {
+		if (s_hpackStaticTable[i].name == lowercase) {
+			index = uint32_t(i + 1);
+			break;
+		}
+	}
+
+	s_writeHpackInteger(out, 0x00, 4, index);
+	if (index == 0) {
+		s_writeHpackInteger(out, 0x00, 7, uint32_t(lowercase.size()));
+		out.insert(out.end(), (const uint8_t *)lowercase.data(), (const uint8_t *)lowercase.data() + lowercase.size());
+	}
+
+	s_writeHpackInteger(out, 0x00, 7, uint32_t(value.size()));
+	out.insert(out.end(), (const uint8_t *)value.data(), (const uint8_t *)value.data() + value.size());
+}
+
+Status UnixHttp2Session::checkPreface(const ConnectionWorker::BufferChain &chain) {
+	size_t offset = 0;
+	auto b = chain.front;
+	while (b && offset < Preface.size()) {
+		auto len = std::min(b->availableForRead(), Preface.size() - offset);
+		if (len > 0 && ::memcmp(b->readSource(), Preface.data() + offset, len) != 0) {
+			return DECLINED;
+		}
+		offset += len;
+		b = b->next;
+	}
+	return (offset == Preface.size()) ? DONE : SUSPENDED;
+}
+
+bool UnixHttp2Session::isUpgradeRequest(UnixRequestController *req) {
+	auto client = req->getClient();
+	if (!client || client->secure || !client->gen->worker->isHttp2Enabled()) {
+		return false;
+	}
+
+	// body would be received as HTTP/1.1 after 101 response, such upgrade is ignored
+	auto &info = req->getInfo();
+	if (info.protocolVersion != 1001 || info.contentLength > 0 || !req->getRequestHeader("transfer-encoding").empty()) {
+		return false;
+	}
+
+	return s_hasUpgradeToken(req->getRequestHeader("upgrade"), "h2c") && !req->getRequestHeader("http2-settings").empty();
+}
+
+UnixHttp2Session *UnixHttp2Session::create(ConnectionWorker::Client *client) {
+	auto p = pool::create(client->rootPool);
+
+	UnixHttp2Session *ret = nullptr;
+	perform([&] {
+		ret = new (p) UnixHttp2Session(client, p);
+	}, p);
+
+	ret->begin();
+	return ret;
+}
+
+UnixHttp2Session *UnixHttp2Session::upgrade(ConnectionWorker::Client *client, UnixRequestController *req) {
+	auto settings = base64url::decode<memory::StandartInterface>(req->getRequestHeader("http2-settings"));
+	if (settings.size() % 6 != 0) {
+		return nullptr;
+	}
+
+	client->write(client->output, StringView("HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n"));
+
+	auto session = create(client);
+
+	// client's preface follows the 101 response
+	if (!session->applySettings(BytesView(settings.data(), settings.size()))) {
+		return session;
+	}
+
+	// request becomes stream 1, that is already half-closed by the client
+	auto s = session->createStream(1);
+	s->remoteClosed = true;
+	session->_lastStreamId = 1;
+
+	auto reqPool = pool::create(s->pool);
+	perform([&] {
+		auto info = req->getInfo().clone(reqPool);
+		info.protocol = StringView("HTTP/2.0");
+		info.protocolVersion = 2000;
+
+		auto r = new (reqPool) UnixHttp2Request(reqPool, move(info), client, session, s);
+		req->foreachRequestHeaders([&] (StringView name, StringView value) {
+			if (!s_isConnectionHeader(name) && name != "http2-settings") {
+				r->setRequestHeader(name, value);
+			}
+		});
+		s->request = r;
+	}, reqPool);
+
+	session->processStream(s);
+	return session;
+}
+
+UnixHttp2Session::~UnixHttp2Session() { }
+
+Status UnixHttp2Session::processInput(ConnectionWorker::BufferChain &chain) {
+	if (_state == State::Closed) {
+		chain.clear();
+		return DECLINED;
+	}
+
+	auto ret = chain.read([&, this] (const ConnectionWorker::Buffer *, const uint8_t *data, size_t len) {
+		size_t offset = 0;
+		while (offset < len) {
+			switch (_state) {
+			case State::Preface: {
+				auto size = std::min(len - offset, Preface.size() - _prefaceRead);
+				if (::memcmp(data + offset, Preface.data() + _prefaceRead, size) != 0) {
+					error(ErrorCode::ProtocolError);
+					return int(DECLINED);
+				}
+				_prefaceRead += size;
+				offset += size;
+				if (_prefaceRead == Preface.size()) {
+					_state = State::FrameHeader;
+				}
+				break;
+			}
+			case State::FrameHeader: {
+				auto size = std::min(len - offset, sizeof(_frameHeader) - _frameHeaderRead);
+				::memcpy(_frameHeader + _frameHeaderRead, data + offset, size);
+				_frameHeaderRead += size;
+				offset += size;
+				if (_frameHeaderRead < sizeof(_frameHeader)) {
+					break;
+				}
+
+				_frameHeaderRead = 0;
+				_frameLength = (uint32_t(_frameHeader[0]) << 16) | (uint32_t(_frameHeader[1]) << 8) | uint32_t(_frameHeader[2]);
+				_frameType = FrameType(_frameHeader[3]);
+				_frameFlags = _frameHeader[4];
+				_frameStream = s_readUint32(_frameHeader + 5) & 0x7fff'ffff;
+				_payloadRead = 0;
+
+				if (_frameLength > HTTP2_MAX_FRAME_SIZE) {
+					error(ErrorCode::FrameSizeError);
+					return int(DECLINED);
+				}
+
+				if (_frameLength > 0) {
+					_state = State::FramePayload;
+				} else if (!processFrame()) {
+					return int(DECLINED);
+				}
+				break;
+			}
+			case State::FramePayload: {
+				auto size = std::min(len - offset, _frameLength - _payloadRead);
+				::memcpy(_payload + _payloadRead, data + offset, size);
+				_payloadRead += size;
+				offset += size;
+				if (_payloadRead == _frameLength) {
+					_state = State::FrameHeader;
+					if (!processFrame()) {
+						return int(DECLINED);
+					}
+				}
+				break;
+			}
+			case State::Closed:
+				return int(DECLINED);
+				break;
+			}
+		}
+		return int(len);
+	}, true);
+
+	if (ret == DECLINED || _state == State::Closed) {
+		chain.clear();
+		return DECLINED;
+	}
+
+	update();
+	return OK;
+}
+
+void UnixHttp2Session::update() {
+	if (_state != State::Closed) {
+		if (!_goawaySent && _client->gen->endOfLife) {
+			// configuration was replaced: active streams are completed, new ones are not accepted
+			writeGoaway(ErrorCode::NoError);
+		}
+
+		flush();
+	}
+
+	if (!_client->output) {
+		// output does not reference stream's buffers anymore
+		releaseStreams(false);
+	}
+
+	if (_state != State::Closed && (_goawaySent || _goawayReceived) && _activeStreams == 0) {
+		_state = State::Closed;
+		_client->write(_client->output, nullptr, 0, ConnectionWorker::Buffer::Eos);
+		_client->shutdownRead();
+	}
+}
+
+void UnixHttp2Session::end() {
+	_state = State::Closed;
+	releaseStreams(true);
+
+	auto p = _pool;
+	this->~UnixHttp2Session();
+	pool::destroy(p);
+}
+
+void UnixHttp2Session::shutdown() {
+	if (_state != State::Closed && !_goawaySent) {
+		writeGoaway(ErrorCode::NoError);
+	}
+	update();
+}
+
+bool UnixHttp2Session::hasInputStreams() const {
+	for (auto s = _streams; s; s = s->next) {
+		if (s->input) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void UnixHttp2Session::writeHeaders(Stream *s, BytesView block, ConnectionWorker::BufferChain *body, bool streaming) {
+	if (s->closed) {
+		if (body) {
+			body->clear();
+		}
+		return;
+	}
+
+	auto buf = (uint8_t *)pool::palloc(s->pool, block.size());
+	::memcpy(buf, block.data(), block.size());
+	s->headers = BytesView(buf, block.size());
+
+	if (body) {
+		s->data.write(*body);
+	}
+
+	if (streaming) {
+		flush();
+	}
+}
+
+void UnixHttp2Session::writeInterim(Stream *s, BytesView block) {
+	if (!s->closed) {
+		writeHeaderBlock(s, block, false);
+	}
+}
+
+void UnixHttp2Session::writeData(Stream *s, ConnectionWorker::BufferChain &chain) {
+	if (s->closed) {
+		chain.clear();
+		return;
+	}
+
+	s->data.write(chain);
+	flush();
+}
+
+void UnixHttp2Session::writeEnd(Stream *s) {
+	if (!s->closed) {
+		s->ended = true;
+		flush();
+	}
+}
+
+UnixHttp2Session::UnixHttp2Session(ConnectionWorker::Client *client, pool_t *p)
+: _pool(p), _client(client) {
+	_payload = (uint8_t *)pool::palloc(_pool, HTTP2_MAX_FRAME_SIZE);
+}
+
+void UnixHttp2Session::begin() {
+	// streams get the whole window from the start, connection window is extended with WINDOW_UPDATE
+	uint8_t buf[18];
+	s_writeSetting(buf, HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, config::UNIX_HTTP2_MAX_STREAMS);
+	s_writeSetting(buf + 6, HTTP2_SETTINGS_INITIAL_WINDOW_SIZE, config::UNIX_HTTP2_WINDOW_SIZE);
+	s_writeSetting(buf + 12, HTTP2_SETTINGS_MAX_HEADER_LIST_SIZE, config::UNIX_HTTP2_MAX_HEADER_BLOCK);
+
+	writeFrame(FrameType::Settings, 0, 0, BytesView(buf, sizeof(buf)));
+	writeWindowUpdate(0, config::UNIX_HTTP2_WINDOW_SIZE - HTTP2_DEFAULT_WINDOW);
+}
+
+UnixHttp2Session::Stream *UnixHttp2Session::getStream(uint32_t id) const {
+	for (auto s = _streams; s; s = s->next) {
+		if (s->id == id) {
+			return s;
+		}
+	}
+	return nullptr;
+}
+
+UnixHttp2Session::Stream *UnixHttp2Session::createStream(uint32_t id) {
+	auto p = pool::create(_pool);
+	auto s = new (p) Stream;
+	s->pool = p;
+	s->id = id;
+	s->sendWindow = _initialWindow;
+
+	s->next = _streams;
+	_streams = s;
+	++ _activeStreams;
+	return s;
+}
+
+void UnixHttp2Session::closeStream(Stream *s) {
+	if (!s->closed) {
+		s->closed = true;
+		-- _activeStreams;
+		++ _client->requestsCount;
+	}
+}
+
+void UnixHttp2Session::completeStream(Stream *s) {
+	if (!s->remoteClosed) {
+		// RFC 9113 8.1: response is complete, rest of the request body is not needed
+		resetStream(s->id, ErrorCode::NoError);
+		return;
+	}
+	closeStream(s);
+}
+
+void UnixHttp2Session::resetStream(uint32_t id, ErrorCode code) {
+	uint8_t buf[4];
+	s_writeUint32(buf, uint32_t(code));
+	writeFrame(FrameType::RstStream, 0, id, BytesView(buf, sizeof(buf)));
+
+	if (auto s = getStream(id)) {
+		s->remoteClosed = true;
+		discardStream(s);
+	}
+}
+
+void UnixHttp2Session::discardStream(Stream *s) {
+	closeStream(s);
+
+	s->headers = BytesView();
+	s->data.clear();
+
+	if (s->request) {
+		// response is not sent for the closed stream, request is just finalized
+		s->input = false;
+		finalizeStream(s, HTTP_BAD_REQUEST);
+	}
+}
+
+void UnixHttp2Session::releaseStreams(bool all) {
+	auto link = &_streams;
+	while (auto s = *link) {
+		if (!all && (!s->closed || s->request)) {
+			link = &s->next;
+			continue;
+		}
+
+		*link = s->next;
+
+		if (s->request) {
+			auto p = s->request->getPool();
+			s->request->finalize();
+			pool::destroy(p);
+			s->request = nullptr;
+		}
+
+		if (!s->closed) {
+			s->closed = true;
+			-- _activeStreams;
+		}
+
+		// close file descriptors, opened for output
+		s->data.clear();
+		pool::destroy(s->pool);
+	}
+}
+
+void UnixHttp2Session::performWithStream(Stream *s, const Callback<void()> &cb) {
+	auto p = _client->pool;
+	_client->pool = s->pool;
+	cb();
+	_client->pool = p;
+}
+
+bool UnixHttp2Session::processFrame() {
+	if (_headerStream != 0 && _frameType != FrameType::Continuation) {
+		// header block can not be interleaved with other frames
+		return error(ErrorCode::ProtocolError);
+	}
+
+	if (!_settingsReceived && _frameType != FrameType::Settings) {
+		// client's preface should continue with SETTINGS
+		return error(ErrorCode::ProtocolError);
+	}
+
+	switch (_frameType) {
+	case FrameType::Data: return processData(); break;
+	case FrameType::Headers: return processHeaders(); break;
+	case FrameType::Priority:
+		// priorities are not used, frame is only validated
+		if (_frameStream == 0) {
+			return error(ErrorCode::ProtocolError);
+		} else if (_frameLength != 5) {
+			resetStream(_frameStream, ErrorCode::FrameSizeError);
+		}
+		break;
+	case FrameType::RstStream: return processRstStream(); break;
+	case FrameType::Settings: return processSettings(); break;
+	case FrameType::PushPromise:
+		// client can not push
+		return error(ErrorCode::ProtocolError);
+		break;
+	case FrameType::Ping: return processPing(); break;
+	case FrameType::Goaway: return processGoaway(); break;
+	case FrameType::WindowUpdate: return processWindowUpdate(); break;
+	case FrameType::Continuation: return processContinuation(); break;
+	default:
+		// unknown frame types are ignored
+		break;
+	}
+	return true;
+}
+
+bool UnixHttp2Session::processData() {
+	if (_frameStream == 0) {
+		return error(ErrorCode::ProtocolError);
+	}
+
+	auto data = _payload;
+	size_t len = _frameLength;
+	if ((_frameFlags & HTTP2_FLAG_PADDED) != 0) {
+		if (len == 0 || _payload[0] >= len) {
+			return error(ErrorCode::ProtocolError);
+		}
+		len -= 1 + _payload[0];
+		++ data;
+	}
+
+	// padding is counted by flow control, window is returned once half of it was consumed
+	if (_frameLength > config::UNIX_HTTP2_WINDOW_SIZE - _recvConsumed) {
+		return error(ErrorCode::FlowControlError);
+	}
+
+	_recvConsumed += _frameLength;
+	if (_recvConsumed >= config::UNIX_HTTP2_WINDOW_SIZE / 2) {
+		writeWindowUpdate(0, uint32_t(_recvConsumed));
+		_recvConsumed = 0;
+	}
+
+	auto s = getStream(_frameStream);
+	if (!s) {
+		if (_frameStream > _lastStreamId) {
+			return error(ErrorCode::ProtocolError);
+		}
+		// stream was completed or reset, data is dropped
+		return true;
+	}
+
+	if (s->closed) {
+		return true;
+	}
+
+	if (s->remoteClosed) {
+		resetStream(s->id, ErrorCode::StreamClosed);
+		return true;
+	}
+
+	if (_frameLength > config::UNIX_HTTP2_WINDOW_SIZE - s->recvConsumed) {
+		resetStream(s->id, ErrorCode::FlowControlError);
+		return true;
+	}
+
+	s->recvConsumed += _frameLength;
+	if ((_frameFlags & HTTP2_FLAG_END_STREAM) != 0) {
+		s->remoteClosed = true;
+	} else if (s->recvConsumed >= config::UNIX_HTTP2_WINDOW_SIZE / 2) {
+		writeWindowUpdate(s->id, uint32_t(s->recvConsumed));
+		s->recvConsumed = 0;
+	}
+
+	// RFC 9113 8.1.1: body is longer, than content-length; total for the stream is checked,
+	// input filter's counter can not be used, it stops with the declared length
+	s->recvLength += len;
+	if (s->contentLength >= 0 && s->recvLength > size_t(s->contentLength)) {
+		resetStream(s->id, ErrorCode::ProtocolError);
+		return true;
+	}
+
+	if (!s->input || !s->request) {
+		// body is not expected by the handler
+		return true;
+	}
+
+	if (len > 0) {
+		// frame payload is passed to the input filter without copying
+		ConnectionWorker::Buffer buf;
+		buf.buf = data;
+		buf.capacity = buf.size = len;
+		buf.flags = ConnectionWorker::Buffer::Borrowed;
+
+		ConnectionWorker::BufferChain chain;
+		chain.write(&buf);
+
+		Status ret = OK;
+		performWithStream(s, [&] {
+			ret = s->request->processInput(chain);
+		});
+
+		switch (ret) {
+		case DONE:
+			s->input = false;
+			finalizeStream(s, DONE);
+			return true;
+			break;
+		case DECLINED:
+			s->input = false;
+			finalizeStream(s, HTTP_BAD_REQUEST);
+			return true;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (s->remoteClosed) {
+		// body is shorter, than content-length
+		s->input = false;
+		finalizeStream(s, HTTP_BAD_REQUEST);
+	}
+	return true;
+}
+
+bool UnixHttp2Session::processHeaders() {
+	if (_frameStream == 0) {
+		return error(ErrorCode::ProtocolError);
+	}
+
+	size_t start = 0;
+	size_t end = _frameLength;
+	if ((_frameFlags & HTTP2_FLAG_PADDED) != 0) {
+		if (end == 0 || _payload[0] >= end) {
+			return error(ErrorCode::ProtocolError);
+		}
+		end -= _payload[0];
+		start = 1;
+	}
+	if ((_frameFlags & HTTP2_FLAG_PRIORITY) != 0) {
+		start += 5;
+	}
+	if (start > end) {
+		return error(ErrorCode::ProtocolError);
+	}
+
+	bool endStream = (_frameFlags & HTTP2_FLAG_END_STREAM) != 0;
+	BytesView block(_payload + start, end - start);
+
+	if ((_frameFlags & HTTP2_FLAG_END_HEADERS) != 0) {
+		return processHeaderBlock(_frameStream, endStream, block);
+	}
+
+	_headerBlock.assign(block.data(), block.data() + block.size());
+	_headerStream = _frameStream;
+	_headerEndStream = endStream;
+	return true;
+}
+
+bool UnixHttp2Session::processContinuation() {
+	if (_headerStream == 0 || _frameStream != _headerStream) {
+		return error(ErrorCode::ProtocolError);
+	}
+
+	if (_headerBlock.size() + _frameLength > config::UNIX_HTTP2_MAX_HEADER_BLOCK) {
+		return error(ErrorCode::EnhanceYourCalm);
+	}
+
+	_headerBlock.insert(_headerBlock.end(), _payload, _payload + _frameLength);
+
+	if ((_frameFlags & HTTP2_FLAG_END_HEADERS) == 0) {
+		return true;
+	}
+
+	_headerStream = 0;
+	auto ret = processHeaderBlock(_frameStream, _headerEndStream, BytesView(_headerBlock.data(), _headerBlock.size()));
+	_headerBlock.clear();
+	return ret;
+}
+
+bool UnixHttp2Session::processRstStream() {
+	if (_frameStream == 0) {
+		return error(ErrorCode::ProtocolError);
+	} else if (_frameLength != 4) {
+		return error(ErrorCode::FrameSizeError);
+	} else if (_frameStream > _lastStreamId) {
+		return error(ErrorCode::ProtocolError);
+	}
+
+	if (auto s = getStream(_frameStream)) {
+		s->remoteClosed = true;
+		discardStream(s);
+	}
+	return true;
+}
+
+bool UnixHttp2Session::processSettings() {
+	if (_frameStream != 0) {
+		return error(ErrorCode::ProtocolError);
+	}
+
+	if ((_frameFlags & HTTP2_FLAG_ACK) != 0) {
+		return (_frameLength == 0) ? true : error(ErrorCode::FrameSizeError);
+	}
+
+	if (_frameLength % 6 != 0) {
+		return error(ErrorCode::FrameSizeError);
+	}
+
+	if (!applySettings(BytesView(_payload, _frameLength))) {
+		return false;
+	}
+
+	_settingsReceived = true;
+	writeFrame(FrameType::Settings, HTTP2_FLAG_ACK, 0);
+	return true;
+}
+
+bool UnixHttp2Session::applySettings(BytesView data) {
+	for (size_t i = 0; i + 6 <= data.size(); i += 6) {
+		auto ptr = data.data() + i;
+		uint16_t id = (uint16_t(ptr[0]) << 8) | uint16_t(ptr[1]);
+		uint32_t value = s_readUint32(ptr + 2);
+
+		switch (id) {
+		case HTTP2_SETTINGS_ENABLE_PUSH:
+			if (value > 1) {
+				return error(ErrorCode::ProtocolError);
+			}
+			break;
+		case HTTP2_SETTINGS_INITIAL_WINDOW_SIZE:
+			if (value > HTTP2_MAX_WINDOW) {
+				return error(ErrorCode::FlowControlError);
+			}
+			// RFC 9113 6.9.2: difference is applied to all streams
+			for (auto s = _streams; s; s = s->next) {
+				s->sendWindow += int64_t(value) - _initialWindow;
+				if (s->sendWindow > HTTP2_MAX_WINDOW) {
+					return error(ErrorCode::FlowControlError);
+				}
+			}
+			_initialWindow = value;
+			break;
+		case HTTP2_SETTINGS_MAX_FRAME_SIZE:
+			if (value < 16_KiB || value > 16_MiB - 1) {
+				return error(ErrorCode::ProtocolError);
+			}
+			_maxFrameSize = value;
+			break;
+		default:
+			// encoder does not use dynamic table, server does not push, other settings are advisory
+			break;
+		}
+	}
+	return true;
+}
+
+bool UnixHttp2Session::processPing() {
+	if (_frameStream != 0) {
+		return error(ErrorCode::ProtocolError);
+	} else if (_frameLength != 8) {
+		return error(ErrorCode::FrameSizeError);
+	}
+
+	if ((_frameFlags & HTTP2_FLAG_ACK) == 0) {
+		writeFrame(FrameType::Ping, HTTP2_FLAG_ACK, 0, BytesView(_payload, 8));
+	}
+	return true;
+}
+
+bool UnixHttp2Session::processGoaway() {
+	if (_frameStream != 0) {
+		return error(ErrorCode::ProtocolError);
+	} else if (_frameLength < 8) {
+		return error(ErrorCode::FrameSizeError);
+	}
+
+	// client will not start new streams, connection is closed when active ones are completed
+	_goawayReceived = true;
+	return true;
+}
+
+bool UnixHttp2Session::processWindowUpdate() {
+	if (_frameLength != 4) {
+		return error(ErrorCode::FrameSizeError);
+	}
+
+	auto increment = s_readUint32(_payload) & 0x7fff'ffff;
+	if (_frameStream == 0) {
+		if (increment == 0) {
+			return error(ErrorCode::ProtocolError);
+		}
+		_sendWindow += increment;
+		if (_sendWindow > HTTP2_MAX_WINDOW) {
+			return error(ErrorCode::FlowControlError);
+		}
+		return true;
+	}
+
+	auto s = getStream(_frameStream);
+	if (!s) {
+		return (_frameStream > _lastStreamId) ? error(ErrorCode::ProtocolError) : true;
+	}
+
+	if (increment == 0) {
+		resetStream(s->id, ErrorCode::ProtocolError);
+		return true;
+	}
+
+	s->sendWindow += increment;
+	if (s->sendWindow > HTTP2_MAX_WINDOW) {
+		resetStream(s->id, ErrorCode::FlowControlError);
+	}
+	return true;
+}
+
+bool UnixHttp2Session::processHeaderBlock(uint32_t id, bool endStream, BytesView block) {
+	auto skipBlock = [&, this] {
+		// block is decoded anyway, dynamic table should stay in sync with the client
+		return _decoder.decode(block, [] (StringView, StringView) { });
+	};
+
+	if (auto s = getStream(id)) {
+		// trailers are not passed to the handler
+		if (!skipBlock()) {
+			return error(ErrorCode::CompressionError);
+		}
+
+		if (s->closed) {
+			return true;
+		} else if (s->remoteClosed) {
+			resetStream(id, ErrorCode::StreamClosed);
+		} else if (!endStream) {
+			resetStream(id, ErrorCode::ProtocolError);
+		} else {
+			s->remoteClosed = true;
+			if (s->input && s->request) {
+				// body is shorter, than content-length
+				s->input = false;
+				finalizeStream(s, HTTP_BAD_REQUEST);
+			}
+		}
+		return true;
+	}
+
+	if ((id % 2) == 0) {
+		return error(ErrorCode::ProtocolError);
+	}
+
+	if (id <= _lastStreamId || _goawaySent || _activeStreams >= config::UNIX_HTTP2_MAX_STREAMS) {
+		if (!skipBlock()) {
+			return error(ErrorCode::CompressionError);
+		}
+		if (id > _lastStreamId && !_goawaySent) {
+			_lastStreamId = id;
+			resetStream(id, ErrorCode::RefusedStream);
+		}
+		// stream was reset or started after GOAWAY
+		return true;
+	}
+
+	_lastStreamId = id;
+
+	auto s = createStream(id);
+	s->remoteClosed = endStream;
+
+	auto reqPool = pool::create(s->pool);
+
+	bool valid = true;
+	bool malformed = false;
+
+	perform([&, this] {
+		StringView method, scheme, path, authority;
+		Vector<Pair<StringView, StringView>> headers;
+		String cookies;
+		bool regular = false;
+
+		valid = _decoder.decode(block, [&] (StringView name, StringView value) {
+			if (malformed) {
+				return;
+			}
+
+			if (name.starts_with(":")) {
+				// pseudo-headers are allowed only once, before regular ones
+				StringView *target = nullptr;
+				if (name == ":method") {
+					target = &method;
+				} else if (name == ":scheme") {
+					target = &scheme;
+				} else if (name == ":path") {
+					target = &path;
+				} else if (name == ":authority") {
+					target = &authority;
+				}
+
+				if (regular || !target || !target->empty()) {
+					malformed = true;
+				} else {
+					*target = value.pdup(reqPool);
+				}
+				return;
+			}
+
+			regular = true;
+
+			// RFC 9113 8.2: names should be lowercase, connection-specific fields are not allowed
+			for (auto c : name) {
+				if (c >= 'A' && c <= 'Z') {
+					malformed = true;
+					return;
+				}
+			}
+
+			if (name.empty() || s_isConnectionHeader(name) || (name == "te" && value != "trailers")) {
+				malformed = true;
+			} else if (name == "cookie") {
+				// cookie can be split into multiple fields for better compression
+				if (!cookies.empty()) {
+					cookies.append("; ");
+				}
+				cookies.append(value.data(), value.size());
+			} else {
+				headers.emplace_back(name.pdup(reqPool), value.pdup(reqPool));
+			}
+		});
+
+		if (!valid || malformed || method.empty() || scheme.empty() || path.empty()) {
+			malformed = true;
+			return;
+		}
+
+		RequestInfo info;
+		auto line = toString(method, " ", path, " HTTP/2.0\r\n");
+		StringView str(line);
+		if (RequestFilter::readRequestLine(str, info) == 0) {
+			malformed = true;
+			return;
+		}
+
+		auto req = new (reqPool) UnixHttp2Request(reqPool, info.clone(reqPool), _client, this, s);
+		if (!authority.empty()) {
+			req->setRequestHeader("host", authority);
+		}
+		for (auto &it : headers) {
+			req->setRequestHeader(it.first, it.second);
+		}
+		if (!cookies.empty()) {
+			req->setRequestHeader("cookie", cookies);
+		}
+		s->request = req;
+	}, reqPool);
+
+	if (!valid) {
+		pool::destroy(reqPool);
+		return error(ErrorCode::CompressionError);
+	}
+
+	if (malformed || (endStream && s->request->getInfo().contentLength > 0)) {
+		if (auto req = s->request) {
+			s->request = nullptr;
+			req->finalize();
+		}
+		pool::destroy(reqPool);
+		resetStream(id, ErrorCode::ProtocolError);
+		return true;
+	}
+
+	if (!s->request->getRequestHeader("content-length").empty()) {
+		s->contentLength = s->request->getInfo().contentLength;
+	}
+
+	processStream(s);
+	return true;
+}
+
+void UnixHttp2Session::processStream(Stream *s) {
+	auto req = s->request;
+	auto &info = req->getInfo();
+
+	if (!s->remoteClosed && info.contentLength == 0 && req->getRequestHeader("content-length").empty()
+			&& (info.method == RequestMethod::Post || info.method == RequestMethod::Put || info.method == RequestMethod::Patch)) {
+		// input filter requires the length of the body
+		auto p = req->getPool();
+		s->request = nullptr;
+		req->finalize();
+		pool::destroy(p);
+		sendStatus(s, HTTP_LENGTH_REQUIRED);
+		return;
+	}
+
+	Status ret = OK;
+	performWithStream(s, [&, this] {
+		auto worker = _client->gen->worker;
+		ret = worker->admitRequest(req);
+		if (ret != OK) {
+			return;
+		}
+
+		ret = worker->processRequest(req);
+		if (ret == OK || ret == SUSPENDED) {
+			if (req->getInputFilter() && info.contentLength > 0) {
+				perform([&] {
+					ret = req->getInputFilter()->init();
+				}, req->getInputFilter()->getPool());
+				if (ret == OK) {
+					// request passed access checks and input limits, client can send the body now
+					req->sendContinue();
+					s->input = true;
+				}
+			} else {
+				// no input expected, response is ready
+				ret = DONE;
+			}
+		}
+	});
+
+	if (!s->input) {
+		finalizeStream(s, ret);
+	}
+}
+
+void UnixHttp2Session::finalizeStream(Stream *s, Status status) {
+	auto req = s->request;
+	auto reqPool = req->getPool();
+
+	performWithStream(s, [&] {
+		perform([&] {
+			req->submitResponse(status);
+		}, reqPool, config::TAG_REQUEST, req);
+	});
+
+	s->request = nullptr;
+
+	req->finalize();
+	pool::destroy(reqPool);
+}
+
+void UnixHttp2Session::sendStatus(Stream *s, Status status) {
+	mem_std::Bytes block;
+	UnixHpackEncoder::writeStatus(block, status);
+	UnixHpackEncoder::writeHeader(block, "content-length", "0");
+
+	writeHeaders(s, BytesView(block.data(), block.size()), nullptr, false);
+	writeEnd(s);
+}
+
+void UnixHttp2Session::flush() {
+	if (_state == State::Closed || _client->shutdownWriteSend) {
+		return;
+	}
+
+	// one frame from every stream on each pass, until socket can not accept more data;
+	// the rest is sent, when output was written
+	bool progress = true;
+	while (progress && !_client->output && !_client->shutdownWriteSend) {
+		progress = false;
+		for (auto s = _streams; s; s = s->next) {
+			if (s->closed) {
+				continue;
+			}
+
+			if (!s->headers.empty()) {
+				bool end = s->ended && s->data.size() == 0;
+				writeHeaderBlock(s, s->headers, end);
+				s->headers = BytesView();
+				if (end) {
+					completeStream(s);
+				}
+				progress = true;
+				continue;
+			}
+
+			auto size = s->data.size();
+			if (size == 0) {
+				if (s->ended) {
+					writeFrame(FrameType::Data, HTTP2_FLAG_END_STREAM, s->id);
+					completeStream(s);
+					progress = true;
+				}
+				continue;
+			}
+
+			auto window = std::min(_sendWindow, s->sendWindow);
+			if (window <= 0) {
+				continue;
+			}
+
+			auto frameSize = std::min(std::min(size, _maxFrameSize), size_t(window));
+			bool end = s->ended && frameSize == size;
+
+			uint8_t header[9];
+			s_writeFrameHeader(header, frameSize, FrameType::Data, end ? HTTP2_FLAG_END_STREAM : 0, s->id);
+
+			// memory buffers are moved into the frame, file is sent with sendfile by ranges
+			ConnectionWorker::BufferChain frame;
+			frame.write(s->pool, header, sizeof(header));
+			s->data.split(s->pool, frame, frameSize);
+			_client->write(_client->output, frame);
+			frame.clear(); // not empty only if write side was closed
+
+			_sendWindow -= frameSize;
+			s->sendWindow -= frameSize;
+
+			if (end) {
+				completeStream(s);
+			}
+			progress = true;
+		}
+	}
+}
+
+bool UnixHttp2Session::error(ErrorCode code) {
+	if (_state != State::Closed) {
+		writeGoaway(code);
+		_state = State::Closed;
+
+		// socket will be closed by worker when GOAWAY is sent
+		_client->write(_client->output, nullptr, 0, ConnectionWorker::Buffer::Eos);
+		_client->shutdownRead();
+	}
+	return false;
+}
+
+void UnixHttp2Session::writeFrame(FrameType type, uint8_t flags, uint32_t id, BytesView payload) {
+	uint8_t header[9];
+	s_writeFrameHeader(header, payload.size(), type, flags, id);
+
+	// header and payload are sent with a single write
+	ConnectionWorker::BufferChain frame;
+	frame.write(_client->pool, header, sizeof(header));
+	if (!payload.empty()) {
+		frame.write(_client->pool, payload.data(), payload.size());
+	}
+	_client->write(_client->output, frame);
+	frame.clear();
+}
+
+void UnixHttp2Session::writeHeaderBlock(Stream *s, BytesView block, bool endStream) {
+	// block is split into HEADERS and CONTINUATION frames, that should be sent without interleaving
+	ConnectionWorker::BufferChain frames;
+	auto type = FrameType::Headers;
+	uint8_t flags = endStream ? HTTP2_FLAG_END_STREAM : 0;
+	do {
+		auto size = std::min(block.size(), _maxFrameSize);
+		if (size == block.size()) {
+			flags |= HTTP2_FLAG_END_HEADERS;
+		}
+
+		uint8_t header[9];
+		s_writeFrameHeader(header, size, type, flags, s->id);
+		frames.write(s->pool, header, sizeof(header));
+		frames.write(s->pool, block.data(), size);
+
+		block = BytesView(block.data() + size, block.size() - size);
+		type = FrameType::Continuation;
+		flags = 0;
+	} while (!block.empty());
+
+	_client->write(_client->output, frames);
+	frames.clear();
+}
+
+void UnixHttp2Session::writeGoaway(ErrorCode code) {
+	uint8_t buf[8];
+	s_writeUint32(buf, _lastStreamId);
+	s_writeUint32(buf + 4, uint32_t(code));
+	writeFrame(FrameType::Goaway, 0, 0, BytesView(buf, sizeof(buf)));
+	_goawaySent = true;
+}
+
+void UnixHttp2Session::writeWindowUpdate(uint32_t id, uint32_t increment) {
+	uint8_t buf[4];
+	s_writeUint32(buf, increment & 0x7fff'ffff);
+	writeFrame(FrameType::WindowUpdate, 0, id, BytesView(buf, sizeof(buf)));
+}
+
+UnixHttp2Request::UnixHttp2Request(pool_t *pool, RequestInfo &&info, ConnectionWorker::Client *client,
+		UnixHttp2Session *session, UnixHttp2Session::Stream *stream)
+: UnixRequestController(pool, move(info), client), _session(session), _stream(stream) { }
+
+void UnixHttp2Request::sendContinue() {
+	if (_expectContinue && !_headersSent) {
+		mem_std::Bytes block;
+		UnixHpackEncoder::writeStatus(block, HTTP_CONTINUE);
+		_session->writeInterim(_stream, BytesView(block.data(), block.size()));
+		_expectContinue = false;
+	}
+}
+
+WebsocketConnection *UnixHttp2Request::convertToWebsocket(WebsocketHandler *, allocator_t *, pool_t *) {
+	return nullptr;
+}
+
+void UnixHttp2Request::writeResponseHeaders(size_t contentLength, bool hasContent, bool streaming, ConnectionWorker::BufferChain *body) {
+	mem_std::Bytes block;
+	UnixHpackEncoder::writeStatus(block, _info.status);
+
+	prepareResponseHeaders(contentLength, hasContent, streaming, [&] (StringView name, StringView value) {
+		UnixHpackEncoder::writeHeader(block, name, value);
+	});
+
+	_session->writeHeaders(_stream, BytesView(block.data(), block.size()), body, streaming);
+}
+
+void UnixHttp2Request::writeResponseData(ConnectionWorker::BufferChain &data) {
+	_session->writeData(_stream, data);
+}
+
+void UnixHttp2Request::writeResponseEnd() {
+	_session->writeEnd(_stream);
+}
+
+}
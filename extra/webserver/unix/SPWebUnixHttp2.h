@@ -0,0 +1,273 @@
+/**
+ Copyright (c) 2025 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#ifndef EXTRA_WEBSERVER_UNIX_SPWEBUNIXHTTP2_H_
+#define EXTRA_WEBSERVER_UNIX_SPWEBUNIXHTTP2_H_
+
+#include "SPWebUnixRequest.h"
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+class UnixHttp2Request;
+
+// HPACK (RFC 7541) decoder for the request headers, dynamic table is shared by all streams of the connection
+class SP_PUBLIC UnixHpackDecoder {
+public:
+	// table size, that we announce with SETTINGS_HEADER_TABLE_SIZE (protocol default)
+	static constexpr size_t TableSize = 4096;
+
+	// returns false on compression error, connection can not be used after it
+	bool decode(BytesView block, const Callback<void(StringView, StringView)> &);
+
+protected:
+	struct Entry {
+		mem_std::String name;
+		mem_std::String value;
+	};
+
+	bool getEntry(uint32_t index, StringView &name, StringView &value) const;
+	void insert(Entry &&);
+	void evict(size_t maxSize);
+
+	std::deque<Entry> _table; // most recent at front
+	size_t _tableSize = 0;
+	size_t _maxTableSize = TableSize;
+};
+
+// HPACK encoder for the response headers: literals, that are never added into client's dynamic table,
+// so encoder has no state, and blocks of the different streams can be sent in any order
+class SP_PUBLIC UnixHpackEncoder {
+public:
+	static void writeStatus(mem_std::Bytes &, int status);
+	static void writeHeader(mem_std::Bytes &, StringView name, StringView value);
+};
+
+// HTTP/2 (RFC 9113) on the client's socket, driven by the ConnectionWorker's event loop
+// Every stream is served with its own UnixHttp2Request, requests are processed on the worker;
+// response data waits in the stream until flow control window allows to send it
+class SP_PUBLIC UnixHttp2Session : public AllocBase {
+public:
+	static constexpr StringView Preface = StringView("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n");
+
+	enum class FrameType : uint8_t {
+		Data = 0x0,
+		Headers = 0x1,
+		Priority = 0x2,
+		RstStream = 0x3,
+		Settings = 0x4,
+		PushPromise = 0x5,
+		Ping = 0x6,
+		Goaway = 0x7,
+		WindowUpdate = 0x8,
+		Continuation = 0x9,
+	};
+
+	enum class ErrorCode : uint32_t {
+		NoError = 0x0,
+		ProtocolError = 0x1,
+		InternalError = 0x2,
+		FlowControlError = 0x3,
+		SettingsTimeout = 0x4,
+		StreamClosed = 0x5,
+		FrameSizeError = 0x6,
+		RefusedStream = 0x7,
+		Cancel = 0x8,
+		CompressionError = 0x9,
+		ConnectError = 0xa,
+		EnhanceYourCalm = 0xb,
+		InadequateSecurity = 0xc,
+		Http11Required = 0xd,
+	};
+
+	struct Stream : AllocBase {
+		Stream *next = nullptr;
+		pool_t *pool = nullptr; // response data and the stream itself, released when output was sent
+		uint32_t id = 0;
+
+		UnixHttp2Request *request = nullptr;
+
+		// encoded response headers and body, waiting for the output
+		BytesView headers;
+		ConnectionWorker::BufferChain data;
+
+		int64_t sendWindow = 0;
+		size_t recvConsumed = 0; // received DATA bytes, not yet returned with WINDOW_UPDATE
+		size_t recvLength = 0; // received DATA payload without padding
+		int64_t contentLength = -1; // declared with content-length, -1 if header was not sent
+
+		bool input = false; // request body is passed to the input filter
+		bool remoteClosed = false; // END_STREAM was received
+		bool ended = false; // response is complete, END_STREAM is sent with the last data
+		bool closed = false;
+	};
+
+	// DONE - input starts with the connection preface, SUSPENDED - more data required, DECLINED - HTTP/1.x
+	static Status checkPreface(const ConnectionWorker::BufferChain &);
+
+	// HTTP/1.1 request with Upgrade: h2c, that can be served as the first stream
+	static bool isUpgradeRequest(UnixRequestController *);
+
+	// session for the connection with the preface in input
+	static UnixHttp2Session *create(ConnectionWorker::Client *);
+
+	// send 101 response and serve request as stream 1; nullptr if HTTP2-Settings is malformed,
+	// request should be processed as HTTP/1.1 then
+	static UnixHttp2Session *upgrade(ConnectionWorker::Client *, UnixRequestController *);
+
+	~UnixHttp2Session();
+
+	// process frames from client's input, returns DECLINED when connection should be closed
+	Status processInput(ConnectionWorker::BufferChain &);
+
+	// send pending response data, release completed streams
+	void update();
+
+	// client's socket was closed, release streams and session
+	void end();
+
+	// GOAWAY without error, connection is closed when active streams are completed
+	void shutdown();
+
+	bool hasActiveStreams() const { return _activeStreams > 0; }
+
+	// stream waits for the request body
+	bool hasInputStreams() const;
+
+	// called by stream's request: headers and data wait in the stream until flow control allows to send them
+	void writeHeaders(Stream *, BytesView block, ConnectionWorker::BufferChain *body, bool streaming);
+	void writeInterim(Stream *, BytesView block); // 1xx response, sent immediately
+	void writeData(Stream *, ConnectionWorker::BufferChain &);
+	void writeEnd(Stream *);
+
+protected:
+	enum class State {
+		Preface,
+		FrameHeader,
+		FramePayload,
+		Closed,
+	};
+
+	UnixHttp2Session(ConnectionWorker::Client *, pool_t *);
+
+	void begin();
+
+	Stream *getStream(uint32_t) const;
+	Stream *createStream(uint32_t);
+	void closeStream(Stream *);
+	void completeStream(Stream *); // END_STREAM was sent
+	void resetStream(uint32_t id, ErrorCode);
+	void discardStream(Stream *); // stream was reset, response is dropped
+	void releaseStreams(bool all);
+
+	// perform with the stream's pool as client's buffers pool
+	void performWithStream(Stream *, const Callback<void()> &);
+
+	bool processFrame();
+	bool processData();
+	bool processHeaders();
+	bool processContinuation();
+	bool processRstStream();
+	bool processSettings();
+	bool applySettings(BytesView);
+	bool processPing();
+	bool processGoaway();
+	bool processWindowUpdate();
+
+	// decode complete header block and start the request
+	bool processHeaderBlock(uint32_t id, bool endStream, BytesView block);
+
+	void processStream(Stream *);
+	void finalizeStream(Stream *, Status);
+
+	// response without request processing, for the requests, that can not be started
+	void sendStatus(Stream *, Status);
+
+	void flush();
+
+	// connection error: GOAWAY is sent, then connection is closed
+	bool error(ErrorCode);
+
+	void writeFrame(FrameType, uint8_t flags, uint32_t id, BytesView payload = BytesView());
+	void writeHeaderBlock(Stream *, BytesView block, bool endStream);
+	void writeGoaway(ErrorCode);
+	void writeWindowUpdate(uint32_t id, uint32_t increment);
+
+	pool_t *_pool = nullptr;
+	ConnectionWorker::Client *_client = nullptr;
+
+	State _state = State::Preface;
+	size_t _prefaceRead = 0;
+
+	// current frame
+	uint8_t _frameHeader[9];
+	size_t _frameHeaderRead = 0;
+	uint32_t _frameLength = 0;
+	FrameType _frameType = FrameType::Data;
+	uint8_t _frameFlags = 0;
+	uint32_t _frameStream = 0;
+	uint8_t *_payload = nullptr;
+	size_t _payloadRead = 0;
+
+	// header block, that continues with CONTINUATION frames
+	mem_std::Bytes _headerBlock;
+	uint32_t _headerStream = 0;
+	bool _headerEndStream = false;
+
+	UnixHpackDecoder _decoder;
+
+	Stream *_streams = nullptr;
+	size_t _activeStreams = 0;
+	uint32_t _lastStreamId = 0;
+
+	// peer settings
+	int64_t _initialWindow = 65'535;
+	size_t _maxFrameSize = 16_KiB;
+	bool _settingsReceived = false;
+
+	int64_t _sendWindow = 65'535;
+	size_t _recvConsumed = 0;
+
+	bool _goawaySent = false;
+	bool _goawayReceived = false;
+};
+
+class SP_PUBLIC UnixHttp2Request : public UnixRequestController {
+public:
+	UnixHttp2Request(pool_t *, RequestInfo &&, ConnectionWorker::Client *, UnixHttp2Session *, UnixHttp2Session::Stream *);
+
+	virtual void sendContinue() override;
+
+	// websocket over HTTP/2 (RFC 8441) is not supported, client should use HTTP/1.1 connection
+	virtual WebsocketConnection *convertToWebsocket(WebsocketHandler *, allocator_t *, pool_t *) override;
+
+protected:
+	virtual void writeResponseHeaders(size_t contentLength, bool hasContent, bool streaming, ConnectionWorker::BufferChain *body = nullptr) override;
+	virtual void writeResponseData(ConnectionWorker::BufferChain &) override;
+	virtual void writeResponseEnd() override;
+
+	UnixHttp2Session *_session = nullptr;
+	UnixHttp2Session::Stream *_stream = nullptr;
+};
+
+}
+
+#endif /* EXTRA_WEBSERVER_UNIX_SPWEBUNIXHTTP2_H_ */
@@ -0,0 +1,125 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#include "SPWebUnixHttpParser.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+const uint8_t *UnixHttpParser::findLineEnd(const uint8_t *b, size_t s) {
+	auto end = b + s;
+
+#if defined(__AVX2__)
+	const __m256i lf32 = _mm256_set1_epi8('\n');
+	while (end - b >= 32) {
+		auto data = _mm256_loadu_si256((const __m256i *)b);
+		auto mask = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(data, lf32)));
+		if (mask) {
+			return b + __builtin_ctz(mask);
+		}
+		b += 32;
+	}
+#endif
+
+#if defined(__SSE2__)
+	const __m128i lf16 = _mm_set1_epi8('\n');
+	while (end - b >= 16) {
+		auto data = _mm_loadu_si128((const __m128i *)b);
+		auto mask = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(data, lf16)));
+		if (mask) {
+			return b + __builtin_ctz(mask);
+		}
+		b += 16;
+	}
+#endif
+
+	return findLineEndScalar(b, end - b);
+}
+
+const uint8_t *UnixHttpParser::findHeaderDelimiter(const uint8_t *b, size_t s) {
+	auto end = b + s;
+
+#if defined(__AVX2__)
+	const __m256i lf32 = _mm256_set1_epi8('\n');
+	const __m256i colon32 = _mm256_set1_epi8(':');
+	while (end - b >= 32) {
+		auto data = _mm256_loadu_si256((const __m256i *)b);
+		auto mask = uint32_t(_mm256_movemask_epi8(
+				_mm256_or_si256(_mm256_cmpeq_epi8(data, lf32), _mm256_cmpeq_epi8(data, colon32))));
+		if (mask) {
+			return b + __builtin_ctz(mask);
+		}
+		b += 32;
+	}
+#endif
+
+#if defined(__SSE2__)
+	const __m128i lf16 = _mm_set1_epi8('\n');
+	const __m128i colon16 = _mm_set1_epi8(':');
+	while (end - b >= 16) {
+		auto data = _mm_loadu_si128((const __m128i *)b);
+		auto mask = uint32_t(_mm_movemask_epi8(
+				_mm_or_si128(_mm_cmpeq_epi8(data, lf16), _mm_cmpeq_epi8(data, colon16))));
+		if (mask) {
+			return b + __builtin_ctz(mask);
+		}
+		b += 16;
+	}
+#endif
+
+	return findHeaderDelimiterScalar(b, end - b);
+}
+
+const uint8_t *UnixHttpParser::findLineEndScalar(const uint8_t *b, size_t s) {
+	return (const uint8_t *)::memchr(b, '\n', s);
+}
+
+const uint8_t *UnixHttpParser::findHeaderDelimiterScalar(const uint8_t *b, size_t s) {
+	auto end = b + s;
+	while (b < end) {
+		if (*b == '\n' || *b == ':') {
+			return b;
+		}
+		++ b;
+	}
+	return nullptr;
+}
+
+bool UnixHttpParser::splitHeaderLine(BytesView line, size_t colon, StringView &name, StringView &value) {
+	if (colon >= line.size() || line.data()[line.size() - 1] != '\n') {
+		return false;
+	}
+
+	name = StringView((const char *)line.data(), colon);
+	value = StringView((const char *)line.data() + colon + 1, line.size() - colon - 1);
+
+	name.trimChars<StringView::WhiteSpace>();
+	value.trimChars<StringView::WhiteSpace>();
+	return true;
+}
+
+}
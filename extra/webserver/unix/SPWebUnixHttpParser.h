@@ -0,0 +1,48 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#ifndef EXTRA_WEBSERVER_UNIX_SPWEBUNIXHTTPPARSER_H_
+#define EXTRA_WEBSERVER_UNIX_SPWEBUNIXHTTPPARSER_H_
+
+#include "SPWebUnixConfig.h"
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+// Delimiter search for HTTP/1.x request line and headers over raw buffer memory
+// Uses AVX2 or SSE2, when available at compile time, scalar versions are used for the tail of the block
+struct SP_PUBLIC UnixHttpParser {
+	// first '\n' in block, or nullptr
+	static const uint8_t *findLineEnd(const uint8_t *, size_t);
+
+	// first ':' or '\n' in block, or nullptr
+	static const uint8_t *findHeaderDelimiter(const uint8_t *, size_t);
+
+	static const uint8_t *findLineEndScalar(const uint8_t *, size_t);
+	static const uint8_t *findHeaderDelimiterScalar(const uint8_t *, size_t);
+
+	// split complete header line at known colon position, name and value are trimmed
+	static bool splitHeaderLine(BytesView line, size_t colon, StringView &name, StringView &value);
+};
+
+}
+
+#endif /* EXTRA_WEBSERVER_UNIX_SPWEBUNIXHTTPPARSER_H_ */
@@ -21,14 +21,144 @@
  **/
 
 #include "SPWebUnixRequest.h"
+#include "SPWebUnixWebsocket.h"
 #include "SPFilesystem.h"
 #include "SPWebInputFilter.h"
 #include "SPWebHostController.h"
+#include "SPWebUnixHost.h"
+#include "SPValid.h"
+
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace STAPPLER_VERSIONIZED stappler::web {
 
+static bool s_hasHeaderToken(StringView value, StringView token) {
+	bool found = false;
+	string::split(value, ",", [&] (StringView v) {
+		v.trimChars<StringView::WhiteSpace>();
+		auto tmp = v.str<memory::StandartInterface>();
+		string::apply_tolower_c(tmp);
+		if (StringView(tmp) == token) {
+			found = true;
+		}
+	});
+	return found;
+}
+
+static StringView s_writeChunkSize(char *buf, size_t bufSize, size_t size) {
+	static constexpr const char *digits = "0123456789abcdef";
+
+	auto ptr = buf + bufSize;
+	*(-- ptr) = '\n';
+	*(-- ptr) = '\r';
+	do {
+		*(-- ptr) = digits[size & 0xF];
+		size >>= 4;
+	} while (size > 0);
+
+	return StringView(ptr, buf + bufSize - ptr);
+}
+
+struct UnixByteRange {
+	size_t start;
+	size_t end;
+};
+
+// values beyond the 64-bit range are saturated
+static bool s_readRangeNumber(StringView &r, size_t &val) {
+	auto num = r.readChars<StringView::CharGroup<CharGroupId::Numbers>>();
+	if (num.empty()) {
+		return false;
+	}
+
+	if (num.size() > 18) {
+		val = maxOf<size_t>();
+	} else {
+		val = size_t(num.readInteger(10).get(0));
+	}
+	return true;
+}
+
+// RFC 9110 14.1.2: returns false, when Range should be ignored,
+// empty list of ranges means that none of them is satisfiable
+static bool s_parseByteRanges(StringView line, size_t size, Vector<UnixByteRange> &ranges) {
+	line.trimChars<StringView::WhiteSpace>();
+	if (!line.starts_with("bytes=")) {
+		return false;
+	}
+
+	line += "bytes="_len;
+
+	bool valid = true;
+	size_t count = 0;
+	string::split(line, ",", [&] (StringView r) {
+		r.trimChars<StringView::WhiteSpace>();
+		if (!valid || r.empty()) {
+			return;
+		}
+
+		if (++ count > config::UNIX_MAX_BYTE_RANGES) {
+			valid = false;
+			return;
+		}
+
+		size_t first = 0;
+		size_t last = maxOf<size_t>();
+		if (r.is('-')) {
+			// suffix range: last N bytes of the file
+			++ r;
+			if (!s_readRangeNumber(r, last) || !r.empty()) {
+				valid = false;
+			} else if (last > 0 && size > 0) {
+				ranges.emplace_back(UnixByteRange{size - std::min(last, size), size});
+			}
+			return;
+		}
+
+		if (!s_readRangeNumber(r, first) || !r.is('-')) {
+			valid = false;
+			return;
+		}
+
+		++ r;
+		if (!r.empty() && (!s_readRangeNumber(r, last) || !r.empty() || last < first)) {
+			valid = false;
+			return;
+		}
+
+		if (first < size) {
+			ranges.emplace_back(UnixByteRange{first, (last >= size) ? size : last + 1});
+		}
+	});
+
+	if (!valid || count == 0) {
+		ranges.clear();
+		return false;
+	}
+
+	if (ranges.size() > 1) {
+		// coalesce overlapping ranges, so the same bytes can not be requested many times
+		std::sort(ranges.begin(), ranges.end(), [] (const UnixByteRange &l, const UnixByteRange &r) {
+			return l.start < r.start;
+		});
+
+		auto target = ranges.begin();
+		for (auto it = ranges.begin() + 1; it != ranges.end(); ++ it) {
+			if (it->start <= target->end) {
+				target->end = std::max(target->end, it->end);
+			} else {
+				*(++ target) = *it;
+			}
+		}
+		ranges.erase(target + 1, ranges.end());
+	}
+
+	return true;
+}
+
 UnixRequestController::UnixRequestController(pool_t *pool, RequestInfo &&info, ConnectionWorker::Client *client)
-: RequestController(pool, move(info)) {
+: RequestController(pool, move(info)), _requestHeaders(pool), _responseHeaders(pool), _errorHeaders(pool) {
 	_client = client;
 
 	_info.useragentIp = client->addr;
@@ -36,7 +166,7 @@ UnixRequestController::UnixRequestController(pool_t *pool, RequestInfo &&info, C
 }
 
 UnixRequestController::UnixRequestController(pool_t *pool, RequestInfo &&info, UnixWebsocketSim *sock)
-: RequestController(pool, move(info)) {
+: RequestController(pool, move(info)), _requestHeaders(pool), _responseHeaders(pool), _errorHeaders(pool) {
 	_websocket = sock;
 	_info.useragentIp = StringView("127.0.0.1");
 	_info.useragentPort = 80;
@@ -52,18 +182,91 @@ size_t UnixRequestController::getBytesSent() const {
 
 void UnixRequestController::putc(int c) {
 	uint8_t ch = c;
-	_client->write(_client->response, &ch, 1);
+	write(&ch, 1);
 }
 
 size_t UnixRequestController::write(const uint8_t *buf, size_t size) {
 	_client->write(_client->response, buf, size);
+	_responseBuffered += size;
+
+	if (_headersSent) {
+		if (_responseBuffered >= config::UNIX_CLIENT_BUFFER_SIZE) {
+			writeResponseChunk(UnixCompressor::Process);
+		}
+	} else if (_responseBuffered >= config::UNIX_RESPONSE_STREAMING_THRESHOLD) {
+		if (startResponseStreaming()) {
+			writeResponseChunk(UnixCompressor::Process);
+		}
+	}
 	return size;
 }
 
-void UnixRequestController::flush() { }
+void UnixRequestController::flush() {
+	if (!_client) {
+		return;
+	}
+
+	if (!_headersSent && !startResponseStreaming()) {
+		return;
+	}
+
+	writeResponseChunk(UnixCompressor::Flush);
+}
+
+void UnixRequestController::setResponseBody(BytesView data, std::shared_ptr<void> &&owner) {
+	// body replaces file
+	_info.filename = StringView();
+
+	if (!_client) {
+		write(data.data(), data.size());
+		return;
+	}
+
+	auto b = new (_client->pool) ConnectionWorker::Buffer();
+	b->pool = _client->pool;
+	b->buf = const_cast<uint8_t *>(data.data());
+	b->capacity = b->size = data.size();
+	b->absolute = _client->response.absolute;
+	b->flags = ConnectionWorker::Buffer::Borrowed;
+
+	_client->response.clear();
+	_client->response.write(b);
+
+	// output can be pending after request is finalized, so bind owner to the buffers pool
+	auto ref = new std::shared_ptr<void>(move(owner));
+	pool::cleanup_register(_client->pool, [ref] {
+		delete ref;
+	});
+}
 
 bool UnixRequestController::isSecureConnection() const {
-	return false;
+	return _client && _client->secure;
+}
+
+void UnixRequestController::setAdmission(UnixHostController *host, RequestPriority priority) {
+	_admittedHost = host;
+	_priority = priority;
+	_admitted = true;
+}
+
+void UnixRequestController::finalize() {
+	if (isTraceEnabled() && _client && _client->gen) {
+		perform([&, this] {
+			_client->gen->worker->writeTrace(this);
+		}, _pool);
+	}
+
+	if (_admitted) {
+		_admitted = false;
+		if (_admittedHost) {
+			_admittedHost->releaseRequest();
+		}
+		if (_client && _client->gen) {
+			_client->gen->worker->releaseRequest();
+		}
+	}
+
+	RequestController::finalize();
 }
 
 void UnixRequestController::setDocumentRoot(StringView val) {
@@ -104,15 +307,25 @@ StringView UnixRequestController::getCookie(StringView name, bool removeFromHead
 }
 
 void UnixRequestController::setFilename(StringView val, bool updateStat, Time mtime) {
+	auto cache = _client ? _client->gen->worker->getFileCache() : nullptr;
+
+	filesystem::Stat stat;
+	auto lookup = [&](StringView path) {
+		if (cache) {
+			return cache->stat(path, stat);
+		}
+		return filesystem::exists(path) && (!updateStat || filesystem::stat(path, stat));
+	};
+
 	if (!val.starts_with(_info.documentRoot)) {
 		auto path = filepath::merge<Interface>(_info.documentRoot, val);
-		if (filesystem::exists(path)) {
+		if (lookup(path)) {
 			val = StringView(path).pdup(_pool);
 		} else {
 			return;
 		}
 	} else {
-		if (filesystem::exists(val)) {
+		if (lookup(val)) {
 			val = val.pdup(_pool);
 		} else {
 			return;
@@ -121,7 +334,7 @@ void UnixRequestController::setFilename(StringView val, bool updateStat, Time mt
 
 	_info.filename = val;
 	if (updateStat) {
-		filesystem::stat(_info.filename, _info.stat);
+		_info.stat = stat;
 		if (mtime != nullptr) {
 			_info.stat.mtime = mtime;
 		}
@@ -129,45 +342,40 @@ void UnixRequestController::setFilename(StringView val, bool updateStat, Time mt
 }
 
 StringView UnixRequestController::getRequestHeader(StringView key) const {
-	auto tmp = key.str<memory::StandartInterface>();
-	string::apply_tolower_c(tmp);
-
-	auto it = _requestHeaders.find(StringView(tmp));
-	if (it != _requestHeaders.end()) {
-		return it->second;
-	}
-	return StringView();
+	return _requestHeaders.get(key);
 }
 
 void UnixRequestController::foreachRequestHeaders(const Callback<void(StringView, StringView)> &cb) const {
-	for (auto &it : _requestHeaders) {
-		cb(it.first, it.second);
-	}
+	_requestHeaders.foreach(cb);
 }
 
 void UnixRequestController::setRequestHeader(StringView key, StringView val) {
-	auto tmp = key.str<memory::StandartInterface>();
-	string::apply_tolower_c(tmp);
-
-	auto it = _requestHeaders.find(StringView(tmp));
-	if (it != _requestHeaders.end()) {
-		it->second = val.pdup(_pool);
-	} else {
-		it = _requestHeaders.emplace(StringView(tmp).pdup(_pool), val.pdup(_pool)).first;
-	}
+	auto name = _requestHeaders.set(key, val);
+	auto value = _requestHeaders.get(name);
 
-	if (it->first == "host") {
-		StringView r(it->second);
+	if (name == "host") {
+		StringView r(value);
 		auto h = r.readUntil<StringView::Chars<':'>>();
 		_info.url.host = h;
 		if (r.is(':')) {
 			++ r;
 			_info.url.port = r;
 		}
-	} else if (it->first == "content-length") {
-		_info.contentLength = StringView(it->second).readInteger(10).get(0);
-	} else if (it->first == "cookie") {
-		auto d = data::readUrlencoded<Interface>(it->second, maxOf<size_t>());
+	} else if (name == "content-length") {
+		_info.contentLength = StringView(value).readInteger(10).get(0);
+	} else if (name == "range") {
+		_info.rangeLine = value;
+	} else if (name == "expect") {
+		// HTTP/1.0 clients do not wait for interim response, so expectation is ignored
+		if (_info.protocolVersion >= 1001) {
+			if (s_hasHeaderToken(value, "100-continue")) {
+				_expectContinue = true;
+			} else {
+				_expectUnsupported = true;
+			}
+		}
+	} else if (name == "cookie") {
+		auto d = data::readUrlencoded<Interface>(value, maxOf<size_t>());
 		for (auto &iit : d.asDict()) {
 			_inputCookies.emplace(StringView(iit.first).pdup(_pool), StringView(iit.second.asString()).pdup(_pool));
 		}
@@ -175,32 +383,15 @@ void UnixRequestController::setRequestHeader(StringView key, StringView val) {
 }
 
 StringView UnixRequestController::getResponseHeader(StringView key) const {
-	auto tmp = key.str<memory::StandartInterface>();
-	string::apply_tolower_c(tmp);
-
-	auto it = _responseHeaders.find(StringView(tmp));
-	if (it != _responseHeaders.end()) {
-		return it->second;
-	}
-	return StringView();
+	return _responseHeaders.get(key);
 }
 
 void UnixRequestController::foreachResponseHeaders(const Callback<void(StringView, StringView)> &cb) const {
-	for (auto &it : _responseHeaders) {
-		cb(it.first, it.second);
-	}
+	_responseHeaders.foreach(cb);
 }
 
 void UnixRequestController::setResponseHeader(StringView key, StringView val) {
-	auto tmp = key.str<memory::StandartInterface>();
-	string::apply_tolower_c(tmp);
-
-	auto it = _responseHeaders.find(StringView(tmp));
-	if (it != _responseHeaders.end()) {
-		it->second = val.pdup(_pool);
-	} else {
-		_responseHeaders.emplace(StringView(tmp).pdup(_pool), val.pdup(_pool));
-	}
+	_responseHeaders.set(key, val);
 }
 
 void UnixRequestController::clearResponseHeaders() {
@@ -208,32 +399,15 @@ void UnixRequestController::clearResponseHeaders() {
 }
 
 StringView UnixRequestController::getErrorHeader(StringView key) const {
-	auto tmp = key.str<memory::StandartInterface>();
-	string::apply_tolower_c(tmp);
-
-	auto it = _errorHeaders.find(StringView(tmp));
-	if (it != _errorHeaders.end()) {
-		return it->second;
-	}
-	return StringView();
+	return _errorHeaders.get(key);
 }
 
 void UnixRequestController::foreachErrorHeaders(const Callback<void(StringView, StringView)> &cb) const {
-	for (auto &it : _errorHeaders) {
-		cb(it.first, it.second);
-	}
+	_errorHeaders.foreach(cb);
 }
 
 void UnixRequestController::setErrorHeader(StringView key, StringView val) {
-	auto tmp = key.str<memory::StandartInterface>();
-	string::apply_tolower_c(tmp);
-
-	auto it = _errorHeaders.find(StringView(tmp));
-	if (it != _errorHeaders.end()) {
-		it->second = val.pdup(_pool);
-	} else {
-		_errorHeaders.emplace(StringView(tmp).pdup(_pool), val.pdup(_pool));
-	}
+	_errorHeaders.set(key, val);
 }
 
 void UnixRequestController::clearErrorHeaders() {
@@ -245,15 +419,39 @@ Status UnixRequestController::processInput(ConnectionWorker::BufferChain &chain)
 		return DECLINED;
 	}
 
+	if (_inputSpan == InvalidSpan) {
+		_inputSpan = beginSpan("input");
+	}
+
 	auto ret = chain.read([&, this] (const ConnectionWorker::Buffer *, const uint8_t *data, size_t len) {
+		if (_info.contentLength == 0) {
+			// rest of the data belongs to the next request
+			return int(DONE);
+		}
+
 		auto size = std::min(len, size_t(_info.contentLength));
 		BytesView r(data, size);
 
 		_info.contentLength -= size;
 
+		if (_spliceFd >= 0) {
+			// data, received with the headers, goes to the same file as spliced data
+			size_t offset = 0;
+			while (offset < size) {
+				auto written = ::pwrite(_spliceFd, data + offset, size - offset, _spliceOffset);
+				if (written < 0 && errno == EINTR) {
+					continue;
+				} else if (written <= 0) {
+					return int(DECLINED);
+				}
+				_spliceOffset += written;
+				offset += written;
+			}
+		}
+
 		bool success = true;
 		perform([&] {
-			if (!_filter->step(r)) {
+			if (!(_spliceFd >= 0 ? _filter->stepDirect(size) : _filter->step(r))) {
 				success = false;
 			}
 		}, _filter->getPool(), config::TAG_REQUEST, this);
@@ -262,25 +460,154 @@ Status UnixRequestController::processInput(ConnectionWorker::BufferChain &chain)
 			return int(DECLINED);
 		}
 
-		if (_info.contentLength > 0) {
-			return int(size);
-		}
-
-		perform([&] {
-			_filter->finalize();
-		}, _filter->getPool(), config::TAG_REQUEST, this);
-		return int(DONE);
+		return int(size);
 	}, true);
 
 	if (ret == DECLINED) {
+		closeInputSplice();
+		_filter = nullptr;
+		return DECLINED;
+	}
+
+	return finalizeInput();
+}
+
+bool UnixRequestController::initInputSplice() {
+	// kTLS socket can return control record in the middle of the body, it's read with the usual path
+	if (!_filter || !_client || _client->secure || _info.contentLength < config::UNIX_SPLICE_MIN_SIZE
+			|| !_client->gen->worker->canSplice()) {
+		return false;
+	}
+
+	auto file = _filter->getDirectTarget();
+	if (!file || file->path.empty()) {
+		return false;
+	}
+
+	_spliceFd = ::open(file->path.data(), O_WRONLY | O_CLOEXEC);
+	if (_spliceFd < 0) {
+		return false;
+	}
+
+	_spliceOffset = 0;
+	pool::cleanup_register(_pool, [this] {
+		closeInputSplice();
+	});
+	return true;
+}
+
+Status UnixRequestController::spliceInput() {
+	if (!_filter || _spliceFd < 0) {
+		return DECLINED;
+	}
+
+	if (_inputSpan == InvalidSpan) {
+		_inputSpan = beginSpan("input");
+	}
+
+	auto ret = _client->gen->worker->spliceToFile(_client->fd, _spliceFd, &_spliceOffset, _info.contentLength);
+	if (ret < 0) {
+		closeInputSplice();
 		_filter = nullptr;
 		return DECLINED;
 	}
 
-	return _info.contentLength > 0 ? SUSPENDED : ret;
+	if (ret > 0) {
+		_info.contentLength -= ret;
+
+		// body deadline is checked against received bytes, count spliced data as received
+		_client->input.absolute += ret;
+
+		bool success = true;
+		perform([&] {
+			success = _filter->stepDirect(ret);
+		}, _filter->getPool(), config::TAG_REQUEST, this);
+
+		if (!success) {
+			closeInputSplice();
+			_filter = nullptr;
+			return DECLINED;
+		}
+	}
+
+	return finalizeInput();
+}
+
+Status UnixRequestController::finalizeInput() {
+	if (_info.contentLength > 0) {
+		return SUSPENDED;
+	}
+
+	closeInputSplice();
+
+	perform([&] {
+		_filter->finalize();
+	}, _filter->getPool(), config::TAG_REQUEST, this);
+
+	endSpan(_inputSpan);
+	return DONE;
+}
+
+String UnixRequestController::makeServerTiming() const {
+	Vector<Pair<StringView, uint64_t>> metrics;
+	for (auto &it : _traceSpans) {
+		// span is still open, like the handler, that streams the response
+		if (!it.duration) {
+			continue;
+		}
+
+		bool found = false;
+		for (auto &m : metrics) {
+			if (m.first == it.name) {
+				m.second += it.duration;
+				found = true;
+				break;
+			}
+		}
+		if (!found) {
+			metrics.emplace_back(it.name, it.duration);
+		}
+	}
+
+	StringStream out;
+	for (auto &it : metrics) {
+		out << it.first << ";dur=" << double(it.second) / 1000.0 << ", ";
+	}
+	out << "total;dur=" << double(getTraceClock() - _traceStart) / 1000.0;
+	return out.str();
+}
+
+void UnixRequestController::closeInputSplice() {
+	if (_spliceFd >= 0) {
+		::close(_spliceFd);
+		_spliceFd = -1;
+	}
+}
+
+void UnixRequestController::sendContinue() {
+	if (_client && _expectContinue && !_headersSent) {
+		_client->write(_client->output, StringView("HTTP/1.1 100 Continue\r\n\r\n"));
+		_expectContinue = false;
+	}
 }
 
 void UnixRequestController::submitResponse(Status status) {
+	if (_upgrade) {
+		// 101 response was already sent, socket now belongs to websocket
+		return;
+	}
+
+	if (_headersSent) {
+		// response is streamed, headers was already sent, complete the body
+		if (!_info.filename.empty() && _info.stat.type == filesystem::FileType::File) {
+			_client->writeFile(_client->response, _info.filename, 0, _info.stat.size);
+		}
+
+		writeResponseChunk(UnixCompressor::Finish);
+		writeResponseEnd();
+		return;
+	}
+
 	if (status > OK) {
 		setStatus(status, StringView());
 	}
@@ -302,11 +629,19 @@ void UnixRequestController::submitResponse(Status status) {
 		}
 	}
 
-	if (!_info.filename.empty() && _info.stat.type == filesystem::FileType::File) {
-		_client->writeFile(_client->response, _info.filename, 0, _info.stat.size, ConnectionWorker::Buffer::Eos);
+	_keepAlive = isKeepAliveAllowed();
+
+	auto outputSpan = beginSpan("output");
+
+	bool hasContent = hasResponseContent();
+
+	if (hasContent && !_info.filename.empty() && _info.stat.type == filesystem::FileType::File) {
+		writeFileResponse();
 	}
 
-	if (_client->response.empty() && !_info.headerRequest) {
+	if (!hasContent) {
+		_client->response.clear();
+	} else if (_client->response.empty() && !_info.headerRequest) {
 		// create default response
 		auto result = getDefaultResult();
 		bool allowCbor = isAcceptable("application/cbor") > 0.0f;
@@ -315,34 +650,202 @@ void UnixRequestController::submitResponse(Status status) {
 
 		_info.contentType = (allowCbor ? StringView("application/cbor") : StringView("application/json; charset=utf-8"));
 
-		_client->response.write(_client->pool, data.data(), data.size(), ConnectionWorker::Buffer::Eos);
-	} else {
-		_client->response.write(_client->pool, nullptr, 0, ConnectionWorker::Buffer::Eos);
+		_client->response.write(_client->pool, data.data(), data.size());
+	}
+
+	if (hasContent && !_info.headerRequest && _client->response.size() >= config::UNIX_COMPRESSION_MIN_SIZE
+			&& startResponseCompression()) {
+		ConnectionWorker::BufferChain compressed;
+		if (!_compressor->compress(_client->pool, _client->response, compressed, UnixCompressor::Finish)) {
+			_keepAlive = false;
+		}
+		_client->response.write(compressed);
 	}
 
-	Time date = Time::now();
 	auto contentLength = _client->response.size();
 
-	StringView crlf("\r\n");
-	StringView statusLine = getStatusLine(status);
-	if (statusLine.empty()) {
-		statusLine = getStatusLine(HTTP_INTERNAL_SERVER_ERROR);
+	if (_info.headerRequest) {
+		// send headers for the content, but not the content itself
+		_client->response.clear();
+	}
+
+	endSpan(outputSpan);
+
+	_headersSent = true;
+	writeResponseHeaders(contentLength, hasContent, false, &_client->response);
+	writeResponseEnd();
+}
+
+bool UnixRequestController::hasResponseContent() const {
+	// RFC 9110: 204 and 304 responses can not contain content
+	return _info.status != HTTP_NO_CONTENT && _info.status != HTTP_NOT_MODIFIED;
+}
+
+bool UnixRequestController::startResponseStreaming() {
+	if (_headersSent || !_client) {
+		return _headersSent;
+	}
+
+	if (_info.status < HTTP_OK) {
+		setStatus(HTTP_OK, StringView());
+	}
+
+	if (!hasResponseContent()) {
+		return false;
+	}
+
+	_keepAlive = isKeepAliveAllowed();
+
+	// chunked encoding is HTTP/1.1 only, HTTP/1.0 client reads the body until connection is closed
+	_chunked = _info.protocolVersion >= 1001;
+	if (!_chunked) {
+		_keepAlive = false;
+	}
+
+	startResponseCompression();
+
+	_headersSent = true;
+	writeResponseHeaders(0, true, true);
+	return true;
+}
+
+bool UnixRequestController::startResponseCompression() {
+	if (_compressor || !_client || _info.headerRequest || _info.status >= HTTP_BAD_REQUEST || !hasResponseContent()) {
+		return false;
+	}
+
+	// files are sent as is
+	if (!_info.filename.empty()) {
+		return false;
+	}
+
+	auto conf = Host(_host).getCompressionConfig();
+	if (!conf || !conf->enabled) {
+		return false;
+	}
+
+	// already encoded or partial content
+	if (!_info.contentEncoding.empty() || !getResponseHeader("Content-Encoding").empty()
+			|| !getResponseHeader("Content-Range").empty()) {
+		return false;
+	}
+
+	// response depends on Accept-Encoding, even if it was not compressed
+	auto vary = getResponseHeader("Vary");
+	if (vary.empty()) {
+		setResponseHeader("Vary", "Accept-Encoding");
+	} else if (!s_hasHeaderToken(vary, "accept-encoding")) {
+		setResponseHeader("Vary", toString(vary, ", Accept-Encoding"));
+	}
+
+	auto encoding = UnixCompressor::select(getRequestHeader("Accept-Encoding"));
+	if (encoding.empty()) {
+		return false;
+	}
+
+	auto ct = _info.contentType;
+	if (ct.empty()) {
+		ct = getResponseHeader("Content-Type");
+	}
+
+	if (!UnixCompressor::isCompressible(ct)) {
+		return false;
+	}
+
+	setContentEncoding(encoding);
+	_responseHeaders.erase("content-md5");
+
+	switch (conf->etag_mode) {
+	case EtagMode::AddSuffix: {
+		StringView etag = getResponseHeader("ETag");
+		if (!etag.empty()) {
+			etag.trimChars<StringView::Chars<'"'>>();
+			setResponseHeader("ETag", toString('"', etag, "-", encoding, '"'));
+		}
+		break;
+	}
+	case EtagMode::Remove:
+		_responseHeaders.erase("etag");
+		break;
+	case EtagMode::NoChange:
+		break;
+	}
+
+	// worker's state pool can not be used from handler thread
+	auto worker = _client->gen->worker;
+	_compressor = new (_pool) UnixCompressor(_pool, worker->isWorkerThread() ? worker->getCompressionPool() : _pool,
+			encoding, *conf);
+
+	// return encoder's memory to the worker's pool with the request
+	pool::cleanup_register(_pool, [c = _compressor] {
+		c->~UnixCompressor();
+	});
+
+	return true;
+}
+
+void UnixRequestController::writeResponseChunk(UnixCompressor::Operation op) {
+	_responseBuffered = 0;
+
+	if (_info.headerRequest) {
+		_client->response.clear();
+		return;
+	}
+
+	if (_compressor) {
+		ConnectionWorker::BufferChain compressed;
+		if (!_compressor->compress(_client->pool, _client->response, compressed, op)) {
+			// stream is broken, client should not reuse connection
+			_keepAlive = false;
+		}
+		_client->response.write(compressed);
+	}
+
+	if (_client->response.size() == 0) {
+		return;
+	}
+
+	writeResponseData(_client->response);
+}
+
+void UnixRequestController::writeResponseData(ConnectionWorker::BufferChain &data) {
+	if (_chunked) {
+		// chunk framing and data are sent with a single write
+		char buf[24];
+		auto chunkSize = s_writeChunkSize(buf, sizeof(buf), data.size());
+
+		ConnectionWorker::BufferChain chunk;
+		chunk.write(_client->pool, (const uint8_t *)chunkSize.data(), chunkSize.size());
+		chunk.write(data);
+		chunk.write(_client->pool, (const uint8_t *)"\r\n", 2);
+		_client->write(_client->output, chunk);
+	} else {
+		_client->write(_client->output, data);
+	}
+}
+
+void UnixRequestController::writeResponseEnd() {
+	if (_chunked && !_info.headerRequest) {
+		_client->write(_client->output, StringView("0\r\n\r\n"));
+	}
+	if (!_keepAlive) {
+		_client->write(_client->output, nullptr, 0, ConnectionWorker::Buffer::Eos);
 	}
+}
+
+void UnixRequestController::prepareResponseHeaders(size_t contentLength, bool hasContent, bool streaming,
+		const Callback<void(StringView, StringView)> &cb) {
+	Time date = Time::now();
 
 	sp_time_exp_t xt(date);
 	char dateBuf[30] = { 0 };
 	xt.encodeRfc822(dateBuf);
 
-	auto outFn = [&, this] (StringView str) {
-		_client->write(_client->output, str);
-	};
-
-	auto out = Callback<void(StringView)>(outFn);
-
 	auto writeCookies = [&] (CookieFlags flags) {
 		for (auto &it : _cookies) {
 			if ((it.second.flags & flags) ==flags) {
-				out << "set-cookie: " << it.first << "=" << it.second.data;
+				StringStream out;
+				out << it.first << "=" << it.second.data;
 				if (it.second.maxAge) {
 					out << ";Max-Age=" << it.second.maxAge.toSeconds();
 				}
@@ -355,61 +858,181 @@ void UnixRequestController::submitResponse(Status status) {
 				case CookieFlags::SameSiteLux: out << ";SameSite=Lux"; break;
 				default: out << ";SameSite=None"; break;
 				}
-				out << ";Path=/;Version=1" << crlf;
+				out << ";Path=/;Version=1";
+				cb("set-cookie", out.weak());
 			}
 		}
 	};
 
-	out << StringView("HTTP/1.1 ") << statusLine << crlf;
+	StringView connection = _keepAlive ? StringView("keep-alive") : StringView("close");
+	if (_info.status == HTTP_SWITCHING_PROTOCOLS) {
+		// Connection: Upgrade was set by protocol handler
+		connection = getResponseHeader("Connection");
+	}
+
+	if (streaming ? !_info.contentType.empty() : contentLength > 0) {
+		setErrorHeader("Content-Type", _info.contentType);
+	}
+	if (_chunked) {
+		setErrorHeader("Transfer-Encoding", "chunked");
+	} else if (hasContent && !streaming) {
+		// persistent connection requires explicit length, even for empty content
+		setErrorHeader("Content-Length", toString(contentLength));
+	}
+	if (!_info.contentEncoding.empty()) {
+		setErrorHeader("Content-Encoding", _info.contentEncoding);
+	}
+	if (_serverTiming && isTraceEnabled()) {
+		setErrorHeader("Server-Timing", makeServerTiming());
+	}
+
 	if (_info.status >= HTTP_BAD_REQUEST) {
 		setErrorHeader("Date", dateBuf);
-		setErrorHeader("Connection", "close");
+		setErrorHeader("Connection", connection);
 		setErrorHeader("Server", _host->getRoot()->getServerNameLine());
-		if (contentLength) {
-			setErrorHeader("Content-Type", _info.contentType);
-			setErrorHeader("Content-Length", toString(contentLength));
-		}
-		if (!_info.contentEncoding.empty()) {
-			setErrorHeader("Content-Encoding", _info.contentEncoding);
-		}
 
-		for (auto &it : _errorHeaders) {
-			out << it.first << StringView(": ") << it.second << crlf;
-		}
+		_errorHeaders.foreach(cb);
 
 		writeCookies(CookieFlags::SetOnError);
 	} else {
 		setResponseHeader("Date", dateBuf);
-		setResponseHeader("Connection", "close");
+		setResponseHeader("Connection", connection);
 		setResponseHeader("Server", _host->getRoot()->getServerNameLine());
-		if (contentLength) {
-			setErrorHeader("Content-Type", _info.contentType);
-			setErrorHeader("Content-Length", toString(contentLength));
-		}
-		if (!_info.contentEncoding.empty()) {
-			setErrorHeader("Content-Encoding", _info.contentEncoding);
-		}
 
-		for (auto &it : _errorHeaders) {
-			auto iit = _responseHeaders.find(it.first);
-			if (iit == _responseHeaders.end()) {
-				_responseHeaders.emplace(it.first, it.second);
+		_errorHeaders.foreach([&, this] (StringView name, StringView value) {
+			if (!_responseHeaders.contains(name)) {
+				_responseHeaders.set(name, value);
 			}
-		}
+		});
 
-		for (auto &it : _responseHeaders) {
-			out << it.first << StringView(": ") << it.second << crlf;
-		}
+		_responseHeaders.foreach(cb);
 
 		writeCookies(CookieFlags::SetOnSuccess);
 	}
+}
 
-	if (!_client->response.empty()) {
-		out << crlf;
-		_client->write(_client->output, _client->response);
-	} else {
-		_client->write(_client->output, (const uint8_t *)crlf.data(), crlf.size(), ConnectionWorker::Buffer::Eos);
+void UnixRequestController::writeResponseHeaders(size_t contentLength, bool hasContent, bool streaming, ConnectionWorker::BufferChain *body) {
+	StringView crlf("\r\n");
+	StringView statusLine = getStatusLine(_info.status);
+	if (statusLine.empty()) {
+		statusLine = getStatusLine(HTTP_INTERNAL_SERVER_ERROR);
+	}
+
+	// headers are collected, then sent with the body as a single vectored write
+	ConnectionWorker::BufferChain headers;
+
+	auto outFn = [&, this] (StringView str) {
+		headers.write(_client->pool, (const uint8_t *)str.data(), str.size());
+	};
+
+	auto out = Callback<void(StringView)>(outFn);
+
+	out << StringView("HTTP/1.1 ") << statusLine << crlf;
+
+	prepareResponseHeaders(contentLength, hasContent, streaming, [&] (StringView name, StringView value) {
+		out << name << StringView(": ") << value << crlf;
+	});
+
+	out << crlf;
+
+	if (body) {
+		headers.write(*body);
 	}
+
+	_client->write(_client->output, headers);
+}
+
+void UnixRequestController::writeFileResponse() {
+	size_t size = _info.stat.size;
+
+	if (_info.status != HTTP_OK) {
+		_client->writeFile(_client->response, _info.filename, 0, size);
+		return;
+	}
+
+	setResponseHeader("Accept-Ranges", "bytes");
+
+	// RFC 9110 14.2: Range is defined only for GET
+	Vector<UnixByteRange> ranges;
+	if (_info.rangeLine.empty() || _info.headerRequest || _info.method != RequestMethod::Get
+			|| !isRangeAllowed() || !s_parseByteRanges(_info.rangeLine, size, ranges)) {
+		_client->writeFile(_client->response, _info.filename, 0, size);
+		return;
+	}
+
+	if (ranges.empty()) {
+		setStatus(HTTP_RANGE_NOT_SATISFIABLE, StringView());
+		setErrorHeader("Content-Range", toString("bytes */", size));
+		return;
+	}
+
+	setStatus(HTTP_PARTIAL_CONTENT, StringView());
+
+	if (ranges.size() == 1) {
+		auto &r = ranges.front();
+		setResponseHeader("Content-Range", toString("bytes ", r.start, "-", r.end - 1, "/", size));
+		_client->writeFile(_client->response, _info.filename, r.start, r.end - r.start);
+		return;
+	}
+
+	// every part is a separate file buffer over the same file, data is not copied
+	auto boundary = base16::encode<Interface>(valid::makeRandomBytes<Interface>(16));
+	auto contentType = _info.contentType;
+
+	for (auto &it : ranges) {
+		if (contentType.empty()) {
+			_client->write(_client->response, toString("\r\n--", boundary, "\r\n"
+					"Content-Range: bytes ", it.start, "-", it.end - 1, "/", size, "\r\n\r\n"));
+		} else {
+			_client->write(_client->response, toString("\r\n--", boundary, "\r\n"
+					"Content-Type: ", contentType, "\r\n"
+					"Content-Range: bytes ", it.start, "-", it.end - 1, "/", size, "\r\n\r\n"));
+		}
+		_client->writeFile(_client->response, _info.filename, it.start, it.end - it.start);
+	}
+	_client->write(_client->response, toString("\r\n--", boundary, "--\r\n"));
+
+	setContentType(toString("multipart/byteranges; boundary=", boundary));
+}
+
+bool UnixRequestController::isRangeAllowed() const {
+	auto ifRange = getRequestHeader("if-range");
+	ifRange.trimChars<StringView::WhiteSpace>();
+	if (ifRange.empty()) {
+		return true;
+	}
+
+	// entity tags use strong comparison, weak tags never match
+	if (ifRange.is('"')) {
+		auto etag = getResponseHeader("ETag");
+		return !etag.empty() && etag == ifRange;
+	} else if (ifRange.starts_with("W/")) {
+		return false;
+	}
+
+	// date should exactly match modification time of the file
+	auto lastModified = getResponseHeader("Last-Modified");
+	auto mtime = lastModified.empty() ? _info.stat.mtime : Time::fromHttp(lastModified);
+	return Time::fromHttp(ifRange).toSeconds() == mtime.toSeconds();
+}
+
+bool UnixRequestController::isKeepAliveAllowed() const {
+	if (!_client || !_client->canKeepAlive()) {
+		return false;
+	}
+
+	// request body was not read completely, we can not find start of the next request
+	if (_info.contentLength > 0 || !getRequestHeader("transfer-encoding").empty()) {
+		return false;
+	}
+
+	auto connection = getRequestHeader("connection");
+	if (_info.protocolVersion >= 1001) {
+		// HTTP/1.1 connections are persistent by default
+		return !s_hasHeaderToken(connection, "close");
+	}
+
+	return s_hasHeaderToken(connection, "keep-alive");
 }
 
 WebsocketConnection *UnixRequestController::convertToWebsocket(WebsocketHandler *handler, allocator_t *a, pool_t *p) {
@@ -420,6 +1043,17 @@ WebsocketConnection *UnixRequestController::convertToWebsocket(WebsocketHandler
 			_websocket->attachSocket(r);
 			ret = r;
 		}, p);
+	} else if (_client && !_headersSent) {
+		perform([&] {
+			_upgrade = new (p) UnixWebsocketConnection(a, p, _host, _client, handler);
+			ret = _upgrade;
+		}, p);
+
+		// send handshake response now, websocket is started when request is finalized
+		setStatus(Status(HTTP_SWITCHING_PROTOCOLS), StringView());
+		_keepAlive = false;
+		_headersSent = true;
+		writeResponseHeaders(0, false, false);
 	}
 	return ret;
 }
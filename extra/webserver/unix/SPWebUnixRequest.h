@@ -25,9 +25,13 @@
 
 #include "SPWebRequestController.h"
 #include "SPWebUnixConnectionWorker.h"
+#include "SPWebUnixCompress.h"
+#include "SPWebUnixHeaders.h"
 
 namespace STAPPLER_VERSIONIZED stappler::web {
 
+class UnixHostController;
+
 class SP_PUBLIC UnixRequestController : public RequestController {
 public:
 	virtual ~UnixRequestController() = default;
@@ -70,18 +74,116 @@ public:
 
 	virtual Status processInput(ConnectionWorker::BufferChain &);
 
+	// switch to splice for the request body, if it goes directly into the upload file
+	bool initInputSplice();
+	bool isInputSpliced() const { return _spliceFd >= 0; }
+
+	// read the request body from client's socket into the upload file
+	Status spliceInput();
+
+	// client waits for 100 Continue before sending the body (HTTP/1.1 only)
+	bool isContinueExpected() const { return _expectContinue; }
+
+	// Expect header with anything but 100-continue, should be answered with 417
+	bool hasUnsupportedExpectation() const { return _expectUnsupported; }
+
+	// send interim response, when request was accepted and the body is going to be read
+	virtual void sendContinue();
+
 	virtual void submitResponse(Status);
 
+	// valid after response was submitted
+	bool isKeepAlive() const { return _keepAlive; }
+
+	// send memory block as response body without copying, owner is released when block was sent
+	void setResponseBody(BytesView, std::shared_ptr<void> &&owner);
+
+	// nullptr for the simulated requests
+	ConnectionWorker::Client *getClient() const { return _client; }
+
+	// connection, that should take over the client's socket after the request
+	UnixWebsocketConnection *getWebsocket() const { return _upgrade; }
+
 	virtual WebsocketConnection *convertToWebsocket(WebsocketHandler *, allocator_t *, pool_t *) override;
 
+	// admission control: request is counted as in flight for the worker and the host until it's finalized
+	void setAdmission(UnixHostController *, RequestPriority);
+	bool isAdmitted() const { return _admitted; }
+	RequestPriority getPriority() const { return _priority; }
+
+	// send request's spans to the client with Server-Timing header (tracing should be started)
+	void setServerTiming(bool value) { _serverTiming = value; }
+
+	virtual void finalize() override;
+
 protected:
-	Map<StringView, StringView> _requestHeaders;
-	Map<StringView, StringView> _responseHeaders;
-	Map<StringView, StringView> _errorHeaders;
+	bool isKeepAliveAllowed() const;
+	bool hasResponseContent() const;
+
+	// send response headers and switch to chunked transfer encoding
+	bool startResponseStreaming();
+
+	// select encoding for the response body, should be called before headers are written
+	bool startResponseCompression();
+
+	// send buffered response data as a single chunk
+	void writeResponseChunk(UnixCompressor::Operation);
+
+	// final response headers with cookies, in the order they should be sent
+	void prepareResponseHeaders(size_t contentLength, bool hasContent, bool streaming, const Callback<void(StringView, StringView)> &);
+
+	// HTTP/1.1 framing of the response, HTTP/2 stream sends them as frames instead
+
+	// body, if any, is moved to the output after the headers
+	virtual void writeResponseHeaders(size_t contentLength, bool hasContent, bool streaming, ConnectionWorker::BufferChain *body = nullptr);
+
+	// part of the response body, after the headers
+	virtual void writeResponseData(ConnectionWorker::BufferChain &);
+
+	// response body is complete
+	virtual void writeResponseEnd();
+
+	// send file as response body, or its parts, requested with Range
+	void writeFileResponse();
+
+	// If-Range condition for the current file
+	bool isRangeAllowed() const;
+
+	// returns DONE and finalizes input filter when the whole body was received
+	Status finalizeInput();
+
+	// metrics for the completed spans, with the same names summed
+	String makeServerTiming() const;
+
+	void closeInputSplice();
+
+	UnixHeaders _requestHeaders;
+	UnixHeaders _responseHeaders;
+	UnixHeaders _errorHeaders;
 	Map<StringView, StringView> _inputCookies;
 
 	ConnectionWorker::Client *_client = nullptr;
 	UnixWebsocketSim *_websocket = nullptr;
+	UnixWebsocketConnection *_upgrade = nullptr;
+	UnixCompressor *_compressor = nullptr;
+	bool _keepAlive = false;
+	bool _headersSent = false;
+	bool _chunked = false;
+	bool _expectContinue = false;
+	bool _expectUnsupported = false;
+	size_t _responseBuffered = 0;
+
+	// upload file for the spliced request body
+	int _spliceFd = -1;
+	off_t _spliceOffset = 0;
+
+	// span from the first part of the request body to the input filter completion
+	size_t _inputSpan = InvalidSpan;
+	bool _serverTiming = false;
+
+	UnixHostController *_admittedHost = nullptr;
+	RequestPriority _priority = RequestPriority::Normal;
+	bool _admitted = false;
 };
 
 }
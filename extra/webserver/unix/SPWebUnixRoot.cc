@@ -28,13 +28,30 @@
 #include "SPWebRequest.h"
 #include "SPThread.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
 namespace STAPPLER_VERSIONIZED stappler::web {
 
+// hosts of the new configuration are visible only for the thread, that initializes them
+static thread_local UnixRoot::HostSet *tl_configuringHosts = nullptr;
+
+UnixHostController *UnixRoot::HostSet::get(StringView name) const {
+	auto it = hosts.find(name);
+	if (it != hosts.end()) {
+		return it->second;
+	}
+	return nullptr;
+}
+
 SharedRc<UnixRoot> UnixRoot::create(Config &&cfg) {
 	return SharedRc<UnixRoot>::create(SharedRefMode::Allocator, move(cfg));
 }
 
-UnixRoot::~UnixRoot() { }
+UnixRoot::~UnixRoot() {
+	closeTraceLog();
+}
 
 UnixRoot::UnixRoot(Ref *ref, pool_t *p) : Root(ref, p) { }
 
@@ -45,43 +62,71 @@ bool UnixRoot::init(Config &&config) {
 			workers = size_t(config.nworkers);
 		}
 
-		for (auto &it : config.hosts) {
-			auto p = pool::create(_rootPool);
-			pool::push(p);
+		_hosts.store(makeHosts(config.hosts));
 
-			auto host = new (p) UnixHostController(this, p, it);
+		initDatabases();
 
-			_hosts.emplace(host->getHostInfo().hostname, host);
+		_staticEncoding = config.staticEncoding;
+		_staticCache.setLimit(config.staticEncoding ? config.staticCacheSize : 0);
+		_fileCache.init(config.fileCacheSize);
 
-			pool::pop();
+		_serverTiming = config.serverTiming;
+		if (!config.traceLog.empty()) {
+			openTraceLog(config.traceLog);
 		}
 
-		initDatabases();
-
 		_queue = new (_rootPool) ConnectionQueue(this, _rootPool, workers, move(config));
 
 		std::unique_lock<std::mutex> lock(_mutex);
 		if (_queue->run()) {
 			_running = true;
-
-			for (auto &it : _hosts) {
-				perform([&] {
-					it.second->init(Host(it.second));
-				}, _rootPool, config::TAG_HOST, it.second);
-			}
-
-			for (auto &it : _hosts) {
-				perform([&] {
-					Host(it.second).handleChildInit(_rootPool);
-				}, _rootPool, config::TAG_HOST, it.second);
-			}
-
+			initHosts(_hosts.load());
+			_queue->completeHandover();
 			return true;
 		}
 		return false;
 	}, _rootPool);
 }
 
+bool UnixRoot::reload(Vector<UnixHostConfig> &&hosts) {
+	std::unique_lock<std::mutex> lock(_mutex);
+	if (!_running || !_queue) {
+		return false;
+	}
+
+	return perform([&, this] {
+		auto set = makeHosts(hosts);
+
+		tl_configuringHosts = set;
+		initDatabases();
+		tl_configuringHosts = nullptr;
+
+		initHosts(set);
+
+		// workers start new generation with the new hosts, when they see the new set
+		_hosts.store(set);
+		_queue->reload();
+		return true;
+	}, _rootPool);
+}
+
+bool UnixRoot::upgrade(SpanView<StringView> args) {
+	std::unique_lock<std::mutex> lock(_mutex);
+	if (!_running || !_queue || args.empty()) {
+		return false;
+	}
+
+	return _queue->handover(args);
+}
+
+size_t UnixRoot::getConnectionsCount() const {
+	return _queue ? _queue->getConnectionsCount() : 0;
+}
+
+UnixEngine UnixRoot::getEngine() const {
+	return _queue ? _queue->getEngine() : UnixEngine::Epoll;
+}
+
 void UnixRoot::cancel() {
 	if (!_running || !_queue) {
 		return;
@@ -91,6 +136,8 @@ void UnixRoot::cancel() {
 	_queue->cancel();
 	_queue->release();
 	_queue = nullptr;
+
+	closeTraceLog();
 }
 
 bool UnixRoot::performTask(const Host &host, AsyncTask *task, bool performFirst) {
@@ -105,14 +152,19 @@ bool UnixRoot::performTask(const Host &host, AsyncTask *task, bool performFirst)
 bool UnixRoot::scheduleTask(const Host &host, AsyncTask *task, TimeInterval ival) {
 	if (_queue) {
 		task->setHost(host);
-		_queue->pushTask(task);
+		_queue->scheduleTask(task, ival);
 		return true;
 	}
 	return false;
 }
 
 void UnixRoot::foreachHost(const Callback<void(Host &)> &cb) {
-	for (auto &it : _hosts) {
+	auto set = tl_configuringHosts ? tl_configuringHosts : _hosts.load();
+	if (!set) {
+		return;
+	}
+
+	for (auto &it : set->hosts) {
 		Host serv(it.second);
 		cb(serv);
 	}
@@ -120,11 +172,9 @@ void UnixRoot::foreachHost(const Callback<void(Host &)> &cb) {
 
 Status UnixRoot::processRequest(RequestController *req) {
 	Status ret = DECLINED;
-	auto host = req->getInfo().url.host;
 
-	auto it = _hosts.find(host);
-	if (it != _hosts.end()) {
-		req->bind(it->second);
+	if (auto host = getHosts(req)->get(req->getInfo().url.host)) {
+		req->bind(host);
 	}
 
 	if (!req->init()) {
@@ -218,16 +268,192 @@ Status UnixRoot::processRequest(RequestController *req) {
 	return ret;
 }
 
+void UnixRoot::writeTrace(RequestController *req, uint32_t tid) {
+	if (_traceLog < 0 || !req->isTraceEnabled()) {
+		return;
+	}
+
+	auto pid = int64_t(::getpid());
+	auto &info = req->getInfo();
+
+	StringStream out;
+
+	auto writeEvent = [&] (StringView name, uint64_t start, uint64_t duration, Value &&args) {
+		Value event {
+			pair("name", Value(name)),
+			pair("cat", Value("request")),
+			pair("ph", Value("X")),
+			pair("ts", Value(int64_t(start))),
+			pair("dur", Value(int64_t(duration))),
+			pair("pid", Value(pid)),
+			pair("tid", Value(int64_t(tid)))
+		};
+		if (args.isDictionary()) {
+			event.setValue(sp::move(args), "args");
+		}
+		out << data::toString(event, false) << ",\n";
+	};
+
+	// whole request first, so viewer can nest the spans within it
+	auto start = req->getTraceStart();
+	writeEvent("request", start, RequestController::getTraceClock() - start, Value {
+		pair("request", Value(info.requestLine)),
+		pair("host", Value(info.url.host)),
+		pair("status", Value(int64_t(toInt(info.status))))
+	});
+
+	for (auto &it : req->getTraceSpans()) {
+		writeEvent(it.name, it.start, it.duration, Value());
+	}
+
+	// single write for the request, so events from the different workers are not mixed in O_APPEND file
+	auto data = out.weak();
+	size_t offset = 0;
+	while (offset < data.size()) {
+		auto ret = ::write(_traceLog, data.data() + offset, data.size() - offset);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		} else if (ret <= 0) {
+			break;
+		}
+		offset += ret;
+	}
+}
+
+bool UnixRoot::isInlineRequest(RequestController *req) const {
+	auto host = getHosts(req)->get(req->getInfo().url.host);
+	if (!host) {
+		// request will be declined without processing
+		return true;
+	}
+
+	return Host(host).isInlineHandler(req->getInfo().url.path);
+}
+
+static uint32_t s_getAdmissionLimit(uint32_t limit, RequestPriority priority) {
+	switch (priority) {
+	case RequestPriority::Low:
+		// rest of the capacity is left for the normal requests
+		return (limit > 1) ? limit / 2 : limit;
+		break;
+	case RequestPriority::Normal:
+		return limit;
+		break;
+	case RequestPriority::High:
+		break;
+	}
+	return 0;
+}
+
+Status UnixRoot::admitRequest(UnixRequestController *req, uint32_t workerRequests) {
+	auto host = getHosts(req)->get(req->getInfo().url.host);
+	if (!host || !_queue) {
+		// request will be declined without processing
+		req->setAdmission(nullptr, RequestPriority::Normal);
+		return OK;
+	}
+
+	// rejected request is answered with host's headers
+	req->bind(host);
+
+	auto &cfg = _queue->getConfig();
+	auto priority = Host(host).getHandlerPriority(req->getInfo().url.path);
+
+	auto workerLimit = s_getAdmissionLimit(cfg.maxWorkerRequests, priority);
+	if (workerLimit && workerRequests >= workerLimit) {
+		return HTTP_SERVICE_UNAVAILABLE;
+	}
+
+	if (!host->acquireRequest(s_getAdmissionLimit(cfg.maxHostRequests, priority))) {
+		return HTTP_SERVICE_UNAVAILABLE;
+	}
+
+	req->setAdmission(host, priority);
+	return OK;
+}
+
 bool UnixRoot::simulateWebsocket(UnixWebsocketSim *sim, StringView hostname, StringView url) {
-	auto it = _hosts.find(hostname);
-	if (it == _hosts.end()) {
+	auto host = _hosts.load()->get(hostname);
+	if (!host) {
 		return false;
 	}
 
-	return it->second->simulateWebsocket(sim, url);
+	return host->simulateWebsocket(sim, url);
+}
+
+UnixRoot::HostSet *UnixRoot::makeHosts(Vector<UnixHostConfig> &hosts) {
+	auto setPool = pool::create(_rootPool);
+	pool::context ctx(setPool);
+
+	auto set = new (setPool) HostSet;
+	set->pool = setPool;
+
+	for (auto &it : hosts) {
+		auto p = pool::create(setPool);
+		pool::push(p);
+
+		auto host = new (p) UnixHostController(this, p, it);
+
+		set->hosts.emplace(host->getHostInfo().hostname, host);
+
+		pool::pop();
+	}
+
+	return set;
+}
+
+void UnixRoot::initHosts(HostSet *set) {
+	for (auto &it : set->hosts) {
+		perform([&] {
+			it.second->init(Host(it.second));
+		}, _rootPool, config::TAG_HOST, it.second);
+	}
+
+	for (auto &it : set->hosts) {
+		perform([&] {
+			Host(it.second).handleChildInit(_rootPool);
+		}, _rootPool, config::TAG_HOST, it.second);
+	}
+}
+
+const UnixRoot::HostSet *UnixRoot::getHosts(RequestController *req) const {
+	// connection is served with the configuration, that was current, when it was accepted
+	auto client = static_cast<UnixRequestController *>(req)->getClient();
+	if (client && client->gen && client->gen->hosts) {
+		return client->gen->hosts;
+	}
+	return _hosts.load();
+}
+
+bool UnixRoot::openTraceLog(StringView path) {
+	auto filename = path.str<Interface>();
+	_traceLog = ::open(filename.data(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (_traceLog < 0) {
+		log::error("UnixRoot", "Fail to open trace log: ", path);
+		return false;
+	}
+
+	// trace-event format allows array without the closing bracket, so events are only appended;
+	// log can be continued by the next server process
+	struct stat st;
+	if (::fstat(_traceLog, &st) == 0 && st.st_size == 0) {
+		if (::write(_traceLog, "[\n", 2) != 2) {
+			log::error("UnixRoot", "Fail to write trace log: ", path);
+		}
+	}
+	return true;
+}
+
+void UnixRoot::closeTraceLog() {
+	if (_traceLog >= 0) {
+		::close(_traceLog);
+		_traceLog = -1;
+	}
 }
 
 Status UnixRoot::runDefaultProcessing(Request &rctx) {
+	RequestTraceScope span(rctx.config(), "default");
+
 	auto &info = rctx.getInfo();
 	auto filename = info.filename;
 	if (filename.empty()) {
@@ -246,8 +472,100 @@ Status UnixRoot::runDefaultProcessing(Request &rctx) {
 		if (runCheckAccess(rctx) != OK) {
 			return HTTP_FORBIDDEN;
 		}
+
+		if (_staticEncoding) {
+			return runStaticEncoding(rctx);
+		}
 		return DONE;
 	}
 }
 
+Status UnixRoot::runStaticEncoding(Request &rctx) {
+	struct Sidecar {
+		const char *encoding;
+		const char *ext;
+	};
+
+	// in order of preference
+	static const Sidecar sidecars[] = {
+		{ "br", ".br" },
+		{ "zstd", ".zst" },
+		{ "gzip", ".gz" },
+	};
+
+	auto &info = rctx.getInfo();
+	auto stat = info.stat;
+	auto filename = info.filename.str<Interface>();
+
+	if (stat.size < config::UNIX_COMPRESSION_MIN_SIZE || !UnixCompressor::isCompressible(info.contentType)) {
+		return DONE;
+	}
+
+	// response depends on Accept-Encoding, even if it was not encoded
+	rctx.setResponseHeader("Vary", "Accept-Encoding");
+
+	auto accept = rctx.getRequestHeader("Accept-Encoding");
+
+	// every encoding is a different representation, so it needs its own ETag
+	auto isNotModified = [&] (StringView encoding) {
+		if (encoding.empty()) {
+			return rctx.checkCacheHeaders(stat.mtime, toString('"', stat.mtime.toMicros(), "-", stat.size, '"'));
+		}
+		return rctx.checkCacheHeaders(stat.mtime, toString('"', stat.mtime.toMicros(), "-", stat.size, "-", encoding, '"'));
+	};
+
+	for (auto &it : sidecars) {
+		if (!UnixCompressor::isAcceptable(accept, it.encoding)) {
+			continue;
+		}
+
+		auto path = toString(filename, it.ext);
+
+		filesystem::Stat sidecarStat;
+		if (!_fileCache.stat(path, sidecarStat)) {
+			continue;
+		}
+
+		// sidecar, that is older than the file, is stale
+		if (sidecarStat.type == filesystem::FileType::File && sidecarStat.mtime >= stat.mtime) {
+			rctx.setContentEncoding(it.encoding);
+			if (isNotModified(it.encoding)) {
+				return HTTP_NOT_MODIFIED;
+			}
+			rctx.setFilename(path, true);
+			return DONE;
+		}
+	}
+
+	// partial content is served from the file itself, memory cache holds only complete representations
+	if (_staticCache.getLimit() > 0 && info.rangeLine.empty() && UnixCompressor::isAcceptable(accept)) {
+		if (auto entry = _staticCache.get(filename, stat)) {
+			rctx.setContentEncoding(UnixCompressor::BlockEncoding);
+			if (isNotModified(UnixCompressor::BlockEncoding)) {
+				return HTTP_NOT_MODIFIED;
+			}
+
+			BytesView data(entry->data);
+			static_cast<UnixRequestController *>(rctx.config())->setResponseBody(data, move(entry));
+			return DONE;
+		}
+
+		if (_staticCache.hit(filename, stat)) {
+			// file is hot, compress it without blocking current request
+			AsyncTask::perform(rctx.host(), [&, this] (AsyncTask &task) {
+				task.setPriority(AsyncTask::PriorityLow);
+				task.addExecuteFn([cache = &_staticCache, path = filename, stat] (const AsyncTask &) -> bool {
+					cache->compress(path, stat);
+					return true;
+				});
+			});
+		}
+	}
+
+	if (isNotModified(StringView())) {
+		return HTTP_NOT_MODIFIED;
+	}
+	return DONE;
+}
+
 }
@@ -26,12 +26,46 @@
 #include "SPWebRoot.h"
 #include "SPWebAsyncTask.h"
 #include "SPWebWebsocket.h"
+#include "SPWebUnixConfig.h"
+#include "SPWebUnixStaticCache.h"
+#include "SPWebUnixFileCache.h"
 
 namespace STAPPLER_VERSIONIZED stappler::web {
 
 class ConnectionQueue;
 class UnixHostController;
 class UnixWebsocketSim;
+class UnixRequestController;
+
+enum class UnixEngine {
+	Epoll,
+	// io_uring with multishot accept/recv and provided buffers, fallback to epoll if not supported;
+	// responses are still written with writev/sendfile, ring only waits for POLLOUT, when socket is full
+	Uring,
+};
+
+struct SP_PUBLIC UnixListenerConfig {
+	// "ipv4:port", "[ipv6]:port", ":port" (loopback), "/path/to/socket" or "unix:/path/to/socket"
+	StringView address;
+
+	// zero means SOMAXCONN
+	int backlog = 0;
+
+	// TCP_DEFERACCEPT: connection is accepted only when the first data has arrived, zero disables
+	TimeInterval deferAccept;
+
+	// TCP_FASTOPEN queue length, zero disables
+	uint32_t fastOpen = 0;
+
+	// IPv6 socket also accepts IPv4 connections (dual-stack), unless ipv6Only is set
+	bool ipv6Only = false;
+
+	// PEM files, listener accepts TLS connections, when both are set;
+	// records are encrypted by the kernel (kTLS), so 'tls' module should be available, epoll engine is used;
+	// without kTLS support in the OpenSSL build listener is disabled with an error in the log
+	StringView certificate;
+	StringView privateKey;
+};
 
 struct SP_PUBLIC UnixHostConfig {
 	StringView hastname;
@@ -45,10 +79,92 @@ struct SP_PUBLIC UnixHostConfig {
 class SP_PUBLIC UnixRoot : public Root {
 public:
 	struct Config {
+		// single listener with default options, used when listeners are not defined
 		StringView listen;
+
+		// every listener is served by all workers
+		Vector<UnixListenerConfig> listeners;
+
 		Vector<UnixHostConfig> hosts;
 		Value db;
 		uint16_t nworkers = std::max(uint16_t(2), uint16_t(std::thread::hardware_concurrency() / 2));
+
+		UnixEngine engine = UnixEngine::Epoll;
+
+		// open listening socket for every worker with SO_REUSEPORT instead of single shared socket
+		// (for every network listener, unix socket is always shared)
+		bool reusePort = false;
+		// pin worker N to the CPU (N % ncpu) from the process affinity mask
+		bool pinWorkers = false;
+		// with reusePort and pinWorkers, attach CBPF program, that steers connection
+		// to the worker, pinned to the CPU, that received it; requires nworkers equal
+		// to the number of CPUs in affinity mask, otherwise steering is disabled
+		bool cpuSteering = false;
+
+		// zero timeout disables persistent connections
+		TimeInterval keepAliveTimeout = config::UNIX_KEEPALIVE_TIMEOUT;
+		// zero means no limit
+		uint32_t keepAliveMaxRequests = config::UNIX_KEEPALIVE_MAX_REQUESTS;
+
+		// deadlines for the slow clients, zero timeout disables deadline
+		TimeInterval requestHeaderTimeout = config::UNIX_REQUEST_HEADER_TIMEOUT;
+		TimeInterval requestBodyTimeout = config::UNIX_REQUEST_BODY_TIMEOUT;
+		size_t requestBodyMinRate = config::UNIX_REQUEST_BODY_MIN_RATE;
+		TimeInterval writeTimeout = config::UNIX_WRITE_TIMEOUT;
+
+		// serve static files with precompressed .br/.zst/.gz sidecars, when available,
+		// hot files without sidecars are compressed into memory cache of staticCacheSize bytes
+		bool staticEncoding = false;
+		size_t staticCacheSize = config::UNIX_STATIC_CACHE_SIZE;
+
+		// max number of cached open files for static responses, zero disables cache
+		size_t fileCacheSize = config::UNIX_FILE_CACHE_SIZE;
+
+		// interval for Root::handleHeartbeat, zero disables heartbeat
+		TimeInterval heartbeatInterval = config::HEARTBEAT_TIME;
+
+		// process requests on separate threads, while I/O workers continue with other connections,
+		// zero processes requests on I/O workers (epoll engine only, io_uring always processes inline)
+		uint16_t handlerThreads = 0;
+
+		// admission control: max number of requests in flight (from the end of headers to the submitted response)
+		// for the worker and for the host across all workers, zero means no limit;
+		// request over the limit is answered with 503 and Retry-After without processing
+		uint32_t maxWorkerRequests = 0;
+		uint32_t maxHostRequests = 0;
+
+		// CoDel-style budget for the time request waits in the handler threads queue, zero disables:
+		// request, that waited longer than interval, is rejected; when queue was not empty for the whole interval,
+		// requests are rejected after the target delay (and low priority ones - always after the target delay)
+		TimeInterval queueDelayTarget;
+		TimeInterval queueDelayInterval = config::UNIX_QUEUE_DELAY_INTERVAL;
+
+		TimeInterval retryAfter = config::UNIX_RETRY_AFTER;
+
+		// accept cleartext HTTP/2 (h2c): with connection preface (prior knowledge) or with Upgrade: h2c,
+		// TLS listeners always use HTTP/1.1
+		bool http2 = false;
+
+		// on reload or upgrade, connections of the previous configuration can finish their requests within this time
+		TimeInterval drainTimeout = config::UNIX_DRAIN_TIMEOUT;
+
+		// request tracing: spans of the processing phases, request body input, database transactions,
+		// templates and output serialization are sent to the client with Server-Timing header
+		bool serverTiming = false;
+
+		// file, where spans of every request are appended in Chrome trace-event format
+		// (JSON array, that can be opened with about:tracing or Perfetto), empty disables log;
+		// spans are written, when request is finalized, after the response was sent
+		StringView traceLog;
+	};
+
+	// hosts, created from the same configuration; connection is served by the set,
+	// that was current, when it was accepted
+	struct HostSet : AllocBase {
+		pool_t *pool = nullptr;
+		Map<StringView, UnixHostController *> hosts;
+
+		UnixHostController *get(StringView) const;
 	};
 
 	static SharedRc<UnixRoot> create(Config &&);
@@ -62,6 +178,24 @@ public:
 
 	void cancel();
 
+	// replace hosts without restart: new connections are served with the new hosts,
+	// connections of the previous configuration are closed after the current request or drain timeout
+	bool reload(Vector<UnixHostConfig> &&);
+
+	// start new server process with the same listening sockets (passed with SCM_RIGHTS),
+	// when it's ready, stop accepting connections and drain existing ones;
+	// process can be stopped with cancel() when getConnectionsCount() is zero or drain timeout is passed
+	bool upgrade(SpanView<StringView> args);
+
+	size_t getConnectionsCount() const;
+
+	// engine, that is actually used by the workers: Uring is reported only when
+	// it was requested and every worker was able to initialize it
+	UnixEngine getEngine() const;
+
+	// hosts for the new connections
+	const HostSet *getHosts() const { return _hosts.load(); }
+
 	virtual bool performTask(const Host &, AsyncTask *task, bool performFirst) override;
 	virtual bool scheduleTask(const Host &, AsyncTask *task, TimeInterval) override;
 
@@ -69,14 +203,52 @@ public:
 
 	Status processRequest(RequestController *);
 
+	// request can be processed on I/O worker without handler thread (static files and inline handlers)
+	bool isInlineRequest(RequestController *) const;
+
+	// check host's in-flight limit for the handler's priority class, workerRequests - in flight on the request's worker;
+	// returns OK, when request was admitted, or HTTP_SERVICE_UNAVAILABLE
+	Status admitRequest(UnixRequestController *, uint32_t workerRequests);
+
 	bool simulateWebsocket(UnixWebsocketSim *sim, StringView hostname, StringView url);
 
+	UnixFileCache *getFileCache() { return _fileCache.isEnabled() ? &_fileCache : nullptr; }
+
+	// requests should be traced, when Server-Timing or trace log is enabled
+	bool isTraceEnabled() const { return _serverTiming || _traceLog >= 0; }
+	bool isServerTimingEnabled() const { return _serverTiming; }
+
+	// append request's spans to the trace log, tid - index of the request's worker
+	void writeTrace(RequestController *, uint32_t tid);
+
 protected:
+	HostSet *makeHosts(Vector<UnixHostConfig> &);
+
+	// init hosts, that are not yet visible for workers
+	void initHosts(HostSet *);
+
+	// hosts for the request's connection
+	const HostSet *getHosts(RequestController *) const;
+
 	Status runDefaultProcessing(Request &);
 
-	Map<StringView, UnixHostController *> _hosts;
+	// select precompressed or cached variant of the static file
+	Status runStaticEncoding(Request &);
+
+	bool openTraceLog(StringView);
+	void closeTraceLog();
+
+	// previous sets are never released before the root, hosts can still be referenced by tasks
+	std::atomic<HostSet *> _hosts = nullptr;
 	ConnectionQueue *_queue = nullptr;
 
+	bool _staticEncoding = false;
+	UnixStaticCache _staticCache;
+	UnixFileCache _fileCache;
+
+	bool _serverTiming = false;
+	int _traceLog = -1;
+
 	bool _running = false;
 	std::mutex _mutex;
 	std::condition_variable _cond;
@@ -0,0 +1,122 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#include "SPWebUnixStaticCache.h"
+#include "SPWebUnixCompress.h"
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+std::shared_ptr<UnixStaticCache::Entry> UnixStaticCache::get(StringView path, const filesystem::Stat &stat) {
+	std::unique_lock lock(_mutex);
+
+	auto it = _entries.find(path);
+	if (it == _entries.end()) {
+		return nullptr;
+	}
+
+	if (it->second.entry->mtime != stat.mtime || it->second.entry->size != stat.size) {
+		// file was modified, it will be compressed again when it becomes hot
+		_size -= it->second.entry->data.size();
+		_lru.erase(it->second.lru);
+		_entries.erase(it);
+		return nullptr;
+	}
+
+	_lru.splice(_lru.begin(), _lru, it->second.lru);
+	return it->second.entry;
+}
+
+bool UnixStaticCache::hit(StringView path, const filesystem::Stat &stat) {
+	if (stat.size > std::min(_limit / 4, config::UNIX_STATIC_CACHE_MAX_FILE)) {
+		return false;
+	}
+
+	std::unique_lock lock(_mutex);
+
+	if (_hits.size() >= config::UNIX_STATIC_CACHE_MAX_TRACKED) {
+		// too many distinct files, start counting from scratch
+		_hits.clear();
+	}
+
+	auto it = _hits.find(path);
+	if (it == _hits.end()) {
+		it = _hits.emplace(path.str<memory::StandartInterface>(), 0).first;
+	}
+
+	// task is scheduled once, when counter reaches the threshold
+	return ++ it->second == config::UNIX_STATIC_CACHE_HOT_HITS;
+}
+
+void UnixStaticCache::compress(StringView path, const filesystem::Stat &stat) {
+	auto data = filesystem::readIntoMemory<memory::StandartInterface>(path);
+	if (data.size() != stat.size) {
+		// file was modified while we read it
+		std::unique_lock lock(_mutex);
+		auto it = _hits.find(path);
+		if (it != _hits.end()) {
+			_hits.erase(it);
+		}
+		return;
+	}
+
+	auto entry = std::make_shared<Entry>();
+	entry->path = path.str<memory::StandartInterface>();
+	entry->mtime = stat.mtime;
+	entry->size = stat.size;
+
+	if (!UnixCompressor::compress(data, config::UNIX_STATIC_COMPRESSION_QUALITY,
+			config::UNIX_STATIC_COMPRESSION_LGWIN, entry->data) || entry->data.size() >= data.size()) {
+		// not compressible, keep it in hits table, so we will not try again
+		return;
+	}
+
+	std::unique_lock lock(_mutex);
+
+	auto hit = _hits.find(path);
+	if (hit != _hits.end()) {
+		_hits.erase(hit);
+	}
+
+	auto it = _entries.find(path);
+	if (it != _entries.end()) {
+		_size -= it->second.entry->data.size();
+		_lru.erase(it->second.lru);
+		_entries.erase(it);
+	}
+
+	evict(entry->data.size());
+
+	_lru.emplace_front(entry->path);
+	_entries.emplace(entry->path, Slot{entry, _lru.begin()});
+	_size += entry->data.size();
+}
+
+void UnixStaticCache::evict(size_t required) {
+	while (!_lru.empty() && _size + required > _limit) {
+		auto it = _entries.find(_lru.back());
+		_size -= it->second.entry->data.size();
+		_entries.erase(it);
+		_lru.pop_back();
+	}
+}
+
+}
@@ -0,0 +1,75 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#ifndef EXTRA_WEBSERVER_UNIX_SPWEBUNIXSTATICCACHE_H_
+#define EXTRA_WEBSERVER_UNIX_SPWEBUNIXSTATICCACHE_H_
+
+#include "SPWebUnixConfig.h"
+#include "SPFilesystem.h"
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+// Size-bounded LRU cache of compressed static files, shared between workers
+// Files are compressed once they become hot, entry is valid while file's mtime and size are the same
+class SP_PUBLIC UnixStaticCache {
+public:
+	struct Entry {
+		mem_std::String path;
+		Time mtime;
+		size_t size = 0; // size of the original file
+		mem_std::Bytes data; // compressed content
+	};
+
+	void setLimit(size_t limit) { _limit = limit; }
+	size_t getLimit() const { return _limit; }
+
+	// compressed content for the file, or nullptr, if it was not cached
+	std::shared_ptr<Entry> get(StringView path, const filesystem::Stat &);
+
+	// count request for the file, returns true when file should be compressed in background
+	bool hit(StringView path, const filesystem::Stat &);
+
+	// compress file and add it into cache, called from background task
+	void compress(StringView path, const filesystem::Stat &);
+
+protected:
+	struct Slot {
+		std::shared_ptr<Entry> entry;
+		std::list<mem_std::String>::iterator lru;
+	};
+
+	void evict(size_t required);
+
+	std::mutex _mutex;
+	size_t _limit = 0;
+	size_t _size = 0;
+
+	std::map<mem_std::String, Slot, std::less<>> _entries;
+	std::list<mem_std::String> _lru; // most recent at front
+
+	// hits for files, that are not cached yet
+	std::map<mem_std::String, uint32_t, std::less<>> _hits;
+};
+
+}
+
+#endif /* EXTRA_WEBSERVER_UNIX_SPWEBUNIXSTATICCACHE_H_ */
@@ -0,0 +1,78 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#include "SPWebUnixTaskQueue.h"
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+void TaskDeque::push(AsyncTask *task) {
+	std::unique_lock lock(_mutex);
+	_bands[getBand(task->getPriority())].emplace_back(task);
+	++ _size;
+}
+
+AsyncTask *TaskDeque::pop() {
+	if (empty()) {
+		return nullptr;
+	}
+
+	std::unique_lock lock(_mutex);
+	return take();
+}
+
+AsyncTask *TaskDeque::steal() {
+	if (empty()) {
+		return nullptr;
+	}
+
+	std::unique_lock lock(_mutex, std::try_to_lock);
+	if (!lock.owns_lock()) {
+		return nullptr;
+	}
+	return take();
+}
+
+void TaskDeque::clear(const Callback<void(AsyncTask *)> &cb) {
+	std::unique_lock lock(_mutex);
+	for (auto &band : _bands) {
+		for (auto &it : band) {
+			cb(it);
+		}
+		band.clear();
+	}
+	_size = 0;
+}
+
+AsyncTask *TaskDeque::take() {
+	for (uint32_t i = Bands; i > 0; -- i) {
+		auto &band = _bands[i - 1];
+		if (!band.empty()) {
+			auto task = band.front();
+			band.pop_front();
+			-- _size;
+			return task;
+		}
+	}
+	return nullptr;
+}
+
+}
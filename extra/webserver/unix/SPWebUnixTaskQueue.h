@@ -0,0 +1,66 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#ifndef EXTRA_WEBSERVER_UNIX_SPWEBUNIXTASKQUEUE_H_
+#define EXTRA_WEBSERVER_UNIX_SPWEBUNIXTASKQUEUE_H_
+
+#include "SPWebUnixConfig.h"
+#include "SPWebAsyncTask.h"
+
+#include <deque>
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+// Per-worker queue of async tasks, owner pops tasks, other workers steal them when idle
+// Tasks are split into priority bands, higher band is always taken first, FIFO within the band
+class SP_PUBLIC TaskDeque {
+public:
+	static constexpr uint32_t BandBits = 2;
+	static constexpr uint32_t Bands = 1 << BandBits;
+
+	static uint32_t getBand(uint8_t priority) { return priority >> (8 - BandBits); }
+
+	void push(AsyncTask *);
+
+	AsyncTask *pop();
+
+	// does not wait for the deque lock, other thief or owner is already working with it
+	AsyncTask *steal();
+
+	// lock-free hint, can be outdated when read from another thread
+	bool empty() const { return _size.load() == 0; }
+	size_t size() const { return _size.load(); }
+
+	// remove all tasks without performing
+	void clear(const Callback<void(AsyncTask *)> &);
+
+protected:
+	AsyncTask *take();
+
+	std::mutex _mutex;
+	std::deque<AsyncTask *> _bands[Bands];
+	std::atomic<size_t> _size = 0;
+};
+
+}
+
+#endif /* EXTRA_WEBSERVER_UNIX_SPWEBUNIXTASKQUEUE_H_ */
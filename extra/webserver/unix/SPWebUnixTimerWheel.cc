@@ -0,0 +1,159 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#include "SPWebUnixTimerWheel.h"
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+TimerWheel::TimerWheel(Time start, TimeInterval tick) : _start(start), _tick(tick) {
+	memset(_slots, 0, sizeof(_slots));
+}
+
+void TimerWheel::schedule(Node *node, Time t) {
+	if (node->isScheduled()) {
+		cancel(node);
+	}
+
+	node->tick = std::max(getTick(t), _current + 1);
+	insert(node);
+	++ _count;
+}
+
+void TimerWheel::cancel(Node *node) {
+	if (!node->isScheduled()) {
+		return;
+	}
+
+	if (node->prev) { node->prev->next = node->next; } else { *node->head = node->next; }
+	if (node->next) { node->next->prev = node->prev; }
+
+	node->next = node->prev = nullptr;
+	node->head = nullptr;
+	-- _count;
+}
+
+void TimerWheel::advance(Time now, const Callback<void(Node *)> &cb) {
+	auto target = getTick(now);
+	if (_count == 0) {
+		_current = std::max(_current, target);
+		return;
+	}
+
+	while (_current < target) {
+		++ _current;
+
+		// lower level wraps, move timers from the next slot of upper level
+		for (uint32_t level = 1; level < Levels; ++ level) {
+			if ((_current & ((uint64_t(1) << (level * SlotBits)) - 1)) != 0) {
+				break;
+			}
+			cascade(level, (_current >> (level * SlotBits)) & SlotMask);
+		}
+
+		auto &slot = _slots[0][_current & SlotMask];
+		while (slot) {
+			auto node = slot;
+			cancel(node);
+			cb(node);
+		}
+
+		if (_count == 0) {
+			_current = target;
+			break;
+		}
+	}
+}
+
+void TimerWheel::clear(const Callback<void(Node *)> &cb) {
+	for (uint32_t level = 0; level < Levels; ++ level) {
+		for (uint32_t i = 0; i < Slots; ++ i) {
+			while (auto node = _slots[level][i]) {
+				cancel(node);
+				cb(node);
+			}
+		}
+	}
+}
+
+Time TimerWheel::getNextTime() const {
+	if (_count == 0) {
+		return Time();
+	}
+
+	uint64_t next = maxOf<uint64_t>();
+	for (uint32_t level = 0; level < Levels; ++ level) {
+		auto shift = level * SlotBits;
+		auto base = _current >> shift;
+		for (uint64_t i = 1; i <= Slots; ++ i) {
+			if (_slots[level][(base + i) & SlotMask]) {
+				// for upper levels, this is the time when slot will be cascaded
+				next = std::min(next, (base + i) << shift);
+				break;
+			}
+		}
+	}
+
+	return _start + TimeInterval::microseconds(_tick.toMicros() * next);
+}
+
+uint64_t TimerWheel::getTick(Time t) const {
+	if (t <= _start) {
+		return 0;
+	}
+	return uint64_t((t - _start).toMicros() / _tick.toMicros());
+}
+
+void TimerWheel::insert(Node *node) {
+	auto delta = node->tick - _current;
+
+	uint32_t level = 0;
+	while (level < Levels - 1 && delta >= (uint64_t(1) << ((level + 1) * SlotBits))) {
+		++ level;
+	}
+
+	// timers beyond the wheel range are placed at the last slot, and rescheduled on cascade
+	auto tick = std::min(node->tick, _current + (uint64_t(1) << (Levels * SlotBits)) - 1);
+
+	auto &head = _slots[level][(tick >> (level * SlotBits)) & SlotMask];
+	node->prev = nullptr;
+	node->next = head;
+	if (head) {
+		head->prev = node;
+	}
+	head = node;
+	node->head = &head;
+}
+
+void TimerWheel::cascade(uint32_t level, uint64_t slot) {
+	auto node = _slots[level][slot];
+	_slots[level][slot] = nullptr;
+
+	while (node) {
+		auto next = node->next;
+		// due timers are placed into the current slot and expired with it
+		node->tick = std::max(node->tick, _current);
+		insert(node);
+		node = next;
+	}
+}
+
+}
@@ -0,0 +1,81 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#ifndef EXTRA_WEBSERVER_UNIX_SPWEBUNIXTIMERWHEEL_H_
+#define EXTRA_WEBSERVER_UNIX_SPWEBUNIXTIMERWHEEL_H_
+
+#include "SPWebUnixConfig.h"
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+// Hierarchical timer wheel with intrusive nodes, not thread-safe
+// Schedule, cancel and expiration are O(1), timers on upper levels are moved down when lower level wraps
+class SP_PUBLIC TimerWheel {
+public:
+	static constexpr uint32_t SlotBits = 6;
+	static constexpr uint32_t Slots = 1 << SlotBits;
+	static constexpr uint64_t SlotMask = Slots - 1;
+	static constexpr uint32_t Levels = 4;
+
+	struct Node {
+		Node *next = nullptr;
+		Node *prev = nullptr;
+		Node **head = nullptr; // slot, that contains node, nullptr if node is not scheduled
+		uint64_t tick = 0;
+
+		bool isScheduled() const { return head != nullptr; }
+	};
+
+	TimerWheel(Time start, TimeInterval tick);
+
+	// timer in the past will be expired on the next advance
+	void schedule(Node *, Time);
+	void cancel(Node *);
+
+	// expire all timers up to now, callback receives unlinked node and can schedule it again
+	void advance(Time now, const Callback<void(Node *)> &);
+
+	// unlink all nodes without expiration
+	void clear(const Callback<void(Node *)> &);
+
+	// time, when wheel should be advanced next, or empty Time when there are no timers
+	Time getNextTime() const;
+
+	size_t size() const { return _count; }
+	bool empty() const { return _count == 0; }
+
+protected:
+	uint64_t getTick(Time) const;
+	void insert(Node *);
+	void cascade(uint32_t level, uint64_t slot);
+
+	Time _start;
+	TimeInterval _tick;
+	uint64_t _current = 0;
+	size_t _count = 0;
+
+	Node *_slots[Levels][Slots];
+};
+
+}
+
+#endif /* EXTRA_WEBSERVER_UNIX_SPWEBUNIXTIMERWHEEL_H_ */
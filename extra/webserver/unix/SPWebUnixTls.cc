@@ -0,0 +1,147 @@
+/**
+ Copyright (c) 2025 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#include "SPWebUnixTls.h"
+
+#include <openssl/opensslv.h>
+#if (OPENSSL_VERSION_NUMBER >= 0x10001000)
+/* must be defined before including ssl.h */
+#define OPENSSL_NO_SSL_INTERN
+#endif
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+// only AEAD ciphers, that can be offloaded into the kernel
+static constexpr auto TLS_CIPHER_LIST = "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"
+		"ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384";
+static constexpr auto TLS_CIPHER_SUITES = "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384";
+
+static void s_logTlsError(StringView text, StringView arg) {
+	char buf[256] = { 0 };
+	auto err = ERR_get_error();
+	if (err) {
+		ERR_error_string_n(err, buf, sizeof(buf) - 1);
+	}
+	log::error("UnixTlsContext", text, " ", arg, ": ", buf);
+	ERR_clear_error();
+}
+
+UnixTlsContext *UnixTlsContext::create(pool_t *pool, StringView certificate, StringView privateKey) {
+#if OPENSSL_VERSION_NUMBER < 0x30000000L || defined(OPENSSL_NO_KTLS)
+	log::error("UnixTlsContext", "OpenSSL is built without kTLS support, TLS listener is not available");
+	return nullptr;
+#else
+	auto ctx = SSL_CTX_new(TLS_server_method());
+	if (!ctx) {
+		s_logTlsError("Fail to create SSL context for", certificate);
+		return nullptr;
+	}
+
+	// kernel can not handle renegotiation and post-handshake messages,
+	// so TLS 1.3 session tickets, that are sent after the handshake, are disabled
+	SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+	SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS | SSL_OP_NO_RENEGOTIATION | SSL_OP_NO_COMPRESSION
+			| SSL_OP_CIPHER_SERVER_PREFERENCE);
+	SSL_CTX_set_num_tickets(ctx, 0);
+
+	auto cert = certificate.str<Interface>();
+	auto key = privateKey.str<Interface>();
+
+	if (!SSL_CTX_set_cipher_list(ctx, TLS_CIPHER_LIST) || !SSL_CTX_set_ciphersuites(ctx, TLS_CIPHER_SUITES)) {
+		s_logTlsError("Fail to set ciphers for", certificate);
+	} else if (SSL_CTX_use_certificate_chain_file(ctx, cert.data()) != 1) {
+		s_logTlsError("Fail to load certificate", certificate);
+	} else if (SSL_CTX_use_PrivateKey_file(ctx, key.data(), SSL_FILETYPE_PEM) != 1) {
+		s_logTlsError("Fail to load private key", privateKey);
+	} else if (SSL_CTX_check_private_key(ctx) != 1) {
+		s_logTlsError("Private key does not match certificate", certificate);
+	} else {
+		return new (pool) UnixTlsContext(ctx);
+	}
+
+	SSL_CTX_free(ctx);
+	return nullptr;
+#endif
+}
+
+void UnixTlsContext::release(ssl_st *ssl) {
+	// socket BIO is created with BIO_NOCLOSE, descriptor is owned by the client
+	SSL_free(ssl);
+}
+
+Status UnixTlsContext::handshake(ssl_st *ssl) {
+	ERR_clear_error();
+
+	auto ret = SSL_do_handshake(ssl);
+	if (ret == 1) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(OPENSSL_NO_KTLS)
+		if (BIO_get_ktls_send(SSL_get_wbio(ssl)) && BIO_get_ktls_recv(SSL_get_rbio(ssl))) {
+			return DONE;
+		}
+#endif
+		log::error("UnixTlsContext", "kTLS is not enabled for ", SSL_get_version(ssl), " ", SSL_get_cipher_name(ssl),
+				", check, that 'tls' kernel module is loaded");
+		return DECLINED;
+	}
+
+	switch (SSL_get_error(ssl, ret)) {
+	case SSL_ERROR_WANT_READ:
+	case SSL_ERROR_WANT_WRITE:
+		return SUSPENDED;
+		break;
+	default:
+		// failed handshakes are usual for the public listener, so they are not logged
+		ERR_clear_error();
+		break;
+	}
+	return DECLINED;
+}
+
+UnixTlsContext::~UnixTlsContext() {
+	if (_ctx) {
+		SSL_CTX_free(_ctx);
+		_ctx = nullptr;
+	}
+}
+
+ssl_st *UnixTlsContext::accept(int fd) const {
+	auto ssl = SSL_new(_ctx);
+	if (!ssl) {
+		s_logTlsError("Fail to create SSL for connection", StringView());
+		return nullptr;
+	}
+
+	if (SSL_set_fd(ssl, fd) != 1) {
+		s_logTlsError("Fail to attach SSL to connection", StringView());
+		SSL_free(ssl);
+		return nullptr;
+	}
+
+	SSL_set_accept_state(ssl);
+	return ssl;
+}
+
+UnixTlsContext::UnixTlsContext(ssl_ctx_st *ctx) : _ctx(ctx) { }
+
+}
@@ -0,0 +1,60 @@
+/**
+ Copyright (c) 2025 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#ifndef EXTRA_WEBSERVER_UNIX_SPWEBUNIXTLS_H_
+#define EXTRA_WEBSERVER_UNIX_SPWEBUNIXTLS_H_
+
+#include "SPWebInfo.h"
+
+struct ssl_st;
+struct ssl_ctx_st;
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+// TLS server context for the listener
+// OpenSSL performs only the handshake, then record layer is moved into the kernel (kTLS) for both directions,
+// so connection is served as plain socket, with sendfile and writev for the output
+class SP_PUBLIC UnixTlsContext : public AllocBase {
+public:
+	// PEM files; nullptr if context can not be created, or OpenSSL is built without kTLS
+	static UnixTlsContext *create(pool_t *, StringView certificate, StringView privateKey);
+
+	// free handshake state, socket is not closed
+	static void release(ssl_st *);
+
+	// SUSPENDED - waiting for the socket, DONE - kTLS is enabled, DECLINED - connection should be closed
+	static Status handshake(ssl_st *);
+
+	~UnixTlsContext();
+
+	// server-side handshake state for the accepted socket
+	ssl_st *accept(int fd) const;
+
+protected:
+	UnixTlsContext(ssl_ctx_st *);
+
+	ssl_ctx_st *_ctx = nullptr;
+};
+
+}
+
+#endif /* EXTRA_WEBSERVER_UNIX_SPWEBUNIXTLS_H_ */
@@ -0,0 +1,510 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#include "SPWebUnixUring.h"
+#include "SPWebUnixConnectionWorker.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <linux/time_types.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+UringQueue::~UringQueue() {
+	if (_fd >= 0) {
+		::close(_fd);
+		_fd = -1;
+	}
+	if (_bufRing) {
+		::munmap(_bufRing, _bufferCount * sizeof(struct io_uring_buf));
+		_bufRing = nullptr;
+	}
+	if (_buffers) {
+		::munmap(_buffers, size_t(_bufferCount) * _bufferSize);
+		_buffers = nullptr;
+	}
+	if (_sqes) {
+		::munmap(_sqes, _sqEntries * sizeof(struct io_uring_sqe));
+		_sqes = nullptr;
+	}
+	if (_cqRing && _cqRing != _sqRing) {
+		::munmap(_cqRing, _cqRingSize);
+	}
+	_cqRing = nullptr;
+	if (_sqRing) {
+		::munmap(_sqRing, _sqRingSize);
+		_sqRing = nullptr;
+	}
+}
+
+bool UringQueue::init(uint32_t entries, uint32_t bufferCount, uint32_t bufferSize) {
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+
+	_fd = int(::syscall(__NR_io_uring_setup, entries, &params));
+	if (_fd < 0) {
+		return false;
+	}
+
+	// we need timeout in io_uring_enter and no dropped completions
+	if ((params.features & IORING_FEAT_EXT_ARG) == 0 || (params.features & IORING_FEAT_NODROP) == 0) {
+		return false;
+	}
+
+	_sqEntries = params.sq_entries;
+	_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+	bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (singleMmap) {
+		_sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+	}
+
+	_sqRing = ::mmap(nullptr, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+	if (_sqRing == MAP_FAILED) {
+		_sqRing = nullptr;
+		return false;
+	}
+
+	if (singleMmap) {
+		_cqRing = _sqRing;
+	} else {
+		_cqRing = ::mmap(nullptr, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+		if (_cqRing == MAP_FAILED) {
+			_cqRing = nullptr;
+			return false;
+		}
+	}
+
+	auto sqes = ::mmap(nullptr, _sqEntries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED) {
+		return false;
+	}
+	_sqes = (struct io_uring_sqe *)sqes;
+
+	auto sq = (uint8_t *)_sqRing;
+	_sqHead = (uint32_t *)(sq + params.sq_off.head);
+	_sqTail = (uint32_t *)(sq + params.sq_off.tail);
+	_sqMask = *(uint32_t *)(sq + params.sq_off.ring_mask);
+	_sqLocalTail = *_sqTail;
+
+	// sqes are used in ring order, so index array is constant
+	auto sqArray = (uint32_t *)(sq + params.sq_off.array);
+	for (uint32_t i = 0; i < _sqEntries; ++ i) {
+		sqArray[i] = i;
+	}
+
+	auto cq = (uint8_t *)_cqRing;
+	_cqHead = (uint32_t *)(cq + params.cq_off.head);
+	_cqTail = (uint32_t *)(cq + params.cq_off.tail);
+	_cqMask = *(uint32_t *)(cq + params.cq_off.ring_mask);
+	_cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+	// provided buffers for multishot recv
+	_bufferCount = bufferCount;
+	_bufferSize = bufferSize;
+
+	auto ring = ::mmap(nullptr, _bufferCount * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ring == MAP_FAILED) {
+		return false;
+	}
+	_bufRing = (struct io_uring_buf_ring *)ring;
+
+	auto buffers = ::mmap(nullptr, size_t(_bufferCount) * _bufferSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffers == MAP_FAILED) {
+		return false;
+	}
+	_buffers = (uint8_t *)buffers;
+
+	struct io_uring_buf_reg reg;
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = uint64_t(uintptr_t(_bufRing));
+	reg.ring_entries = _bufferCount;
+	reg.bgid = _bufferGroup;
+
+	if (::syscall(__NR_io_uring_register, _fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < _bufferCount; ++ i) {
+		returnBuffer(uint16_t(i));
+	}
+
+	return true;
+}
+
+struct io_uring_sqe *UringQueue::getSqe() {
+	auto head = __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+	if (_sqLocalTail - head >= _sqEntries) {
+		// queue is full, submit without waiting
+		__atomic_store_n(_sqTail, _sqLocalTail, __ATOMIC_RELEASE);
+		enter(_sqLocalTail - head, 0, 0, nullptr, 0);
+
+		head = __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+		if (_sqLocalTail - head >= _sqEntries) {
+			return nullptr;
+		}
+	}
+
+	auto sqe = &_sqes[_sqLocalTail & _sqMask];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	++ _sqLocalTail;
+	return sqe;
+}
+
+int UringQueue::submitAndWait(int timeout) {
+	__atomic_store_n(_sqTail, _sqLocalTail, __ATOMIC_RELEASE);
+
+	auto submit = _sqLocalTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+
+	// do not wait, if there are unprocessed completions
+	uint32_t wait = (__atomic_load_n(_cqTail, __ATOMIC_ACQUIRE) == *_cqHead) ? 1 : 0;
+	if (!wait && !submit) {
+		return 0;
+	}
+
+	struct __kernel_timespec ts;
+	struct io_uring_getevents_arg arg;
+	memset(&arg, 0, sizeof(arg));
+
+	if (timeout >= 0) {
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1'000'000;
+		arg.ts = uint64_t(uintptr_t(&ts));
+	}
+
+	return enter(submit, wait, (wait ? IORING_ENTER_GETEVENTS : 0) | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+uint32_t UringQueue::foreachCompletion(const Callback<void(uint64_t, int32_t, uint32_t)> &cb) {
+	uint32_t count = 0;
+	auto head = *_cqHead;
+	auto tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+
+	while (head != tail) {
+		auto cqe = &_cqes[head & _cqMask];
+		auto data = cqe->user_data;
+		auto res = cqe->res;
+		auto flags = cqe->flags;
+
+		// release slot before processing, so callback can submit new entries
+		++ head;
+		__atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+
+		cb(data, res, flags);
+		++ count;
+	}
+
+	return count;
+}
+
+uint8_t *UringQueue::getBuffer(uint16_t bid) const {
+	return _buffers + size_t(bid) * _bufferSize;
+}
+
+void UringQueue::returnBuffer(uint16_t bid) {
+	auto buf = &_bufRing->bufs[_bufferTail & (_bufferCount - 1)];
+	buf->addr = uint64_t(uintptr_t(getBuffer(bid)));
+	buf->len = _bufferSize;
+	buf->bid = bid;
+
+	++ _bufferTail;
+	__atomic_store_n(&_bufRing->tail, _bufferTail, __ATOMIC_RELEASE);
+}
+
+int UringQueue::enter(uint32_t submit, uint32_t wait, uint32_t flags, void *arg, size_t argSize) {
+	auto ret = int(::syscall(__NR_io_uring_enter, _fd, submit, wait, flags, arg, argSize));
+	if (ret < 0) {
+		return -errno;
+	}
+	return ret;
+}
+
+// operation type is stored in lower bits of the client pointer in user_data
+enum UringOp : uint64_t {
+	UringOpNone = 0, // results for cancel requests
+	UringOpAccept = 1,
+	UringOpPoll = 2,
+	UringOpRecv = 3,
+	UringOpPollOut = 4,
+};
+
+static constexpr uint64_t UringOpMask = 0x7;
+
+static uint64_t s_getUringData(ConnectionWorker::Client *client, UringOp op) {
+	return uint64_t(uintptr_t(client)) | op;
+}
+
+bool ConnectionWorker::pollUring() {
+	while (!_shouldClose) {
+		auto ret = _uring->submitAndWait(performTasks());
+		_idle = false;
+
+		if (ret == -EINTR) {
+			return true;
+		} else if (ret < 0 && ret != -ETIME && ret != -EBUSY && ret != -EAGAIN) {
+			char buf[256] = { 0 };
+			log::error("ConnectionWorker", "io_uring_enter() failed with errno ", -ret, " (", strerror_r(-ret, buf, 255), ")");
+			return false;
+		}
+
+		_uring->foreachCompletion([&, this] (uint64_t data, int32_t res, uint32_t flags) {
+			processUringCompletion(data, res, flags);
+		});
+
+		if (!_deadlines.empty()) {
+			releaseExpired(Time::now());
+		}
+
+		if (_draining) {
+			releaseDrained(Time::now());
+		}
+	}
+
+	if (_shouldClose) {
+		releaseGenerations();
+	}
+
+	return !_shouldClose;
+}
+
+void ConnectionWorker::cancelUringAccept() {
+	for (auto &it : _inputClients) {
+		if (!it.uringOps) {
+			continue;
+		}
+
+		if (auto sqe = _uring->getSqe()) {
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->fd = -1;
+			sqe->addr = s_getUringData(&it, UringOpAccept);
+			sqe->user_data = UringOpNone;
+		}
+	}
+}
+
+bool ConnectionWorker::addUringClient(Client &client) {
+	if (!client.system) {
+		return recvUring(client);
+	}
+
+	auto sqe = _uring->getSqe();
+	if (!sqe) {
+		log::error("ConnectionWorker", "io_uring submission queue is full");
+		return false;
+	}
+
+	sqe->fd = client.fd;
+	if (client.listener) {
+		sqe->opcode = IORING_OP_ACCEPT;
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+		sqe->user_data = s_getUringData(&client, UringOpAccept);
+	} else {
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->poll32_events = POLLIN;
+		sqe->len = IORING_POLL_ADD_MULTI;
+		sqe->user_data = s_getUringData(&client, UringOpPoll);
+	}
+
+	++ client.uringOps;
+	return true;
+}
+
+void ConnectionWorker::removeUringClient(Client &client) {
+	if (client.uringClosing) {
+		return;
+	}
+
+	clearDeadline(client);
+
+	-- _fdCount;
+
+	client.uringClosing = true;
+	client.shutdownAll();
+
+	if (client.uringOps == 0) {
+		client.release();
+		return;
+	}
+
+	// client will be released with the last completion
+	auto cancel = [&, this] (UringOp op) {
+		if (auto sqe = _uring->getSqe()) {
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->fd = -1;
+			sqe->addr = s_getUringData(&client, op);
+			sqe->user_data = UringOpNone;
+		}
+	};
+
+	if (client.uringRecv) {
+		cancel(UringOpRecv);
+	}
+	if (client.uringPollOut) {
+		cancel(UringOpPollOut);
+	}
+}
+
+void ConnectionWorker::pollUringOutput(Client &client) {
+	if (client.uringPollOut || client.uringClosing) {
+		return;
+	}
+
+	auto sqe = _uring->getSqe();
+	if (!sqe) {
+		log::error("ConnectionWorker", "io_uring submission queue is full");
+		return;
+	}
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = client.fd;
+	sqe->poll32_events = POLLOUT;
+	sqe->user_data = s_getUringData(&client, UringOpPollOut);
+
+	client.uringPollOut = true;
+	++ client.uringOps;
+}
+
+bool ConnectionWorker::recvUring(Client &client) {
+	if (client.uringRecv || client.uringClosing) {
+		return true;
+	}
+
+	auto sqe = _uring->getSqe();
+	if (!sqe) {
+		log::error("ConnectionWorker", "io_uring submission queue is full");
+		return false;
+	}
+
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = client.fd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = _uring->getBufferGroup();
+	sqe->user_data = s_getUringData(&client, UringOpRecv);
+
+	client.uringRecv = true;
+	++ client.uringOps;
+	return true;
+}
+
+void ConnectionWorker::processUringCompletion(uint64_t data, int32_t res, uint32_t flags) {
+	auto op = UringOp(data & UringOpMask);
+	auto client = (Client *)uintptr_t(data & ~UringOpMask);
+	if (op == UringOpNone || !client) {
+		return;
+	}
+
+	if ((flags & IORING_CQE_F_MORE) == 0) {
+		// multishot operation was terminated, or single-shot one was completed
+		-- client->uringOps;
+		switch (op) {
+		case UringOpRecv: client->uringRecv = false; break;
+		case UringOpPollOut: client->uringPollOut = false; break;
+		default: break;
+		}
+	}
+
+	if (op == UringOpRecv && (flags & IORING_CQE_F_BUFFER)) {
+		auto bid = uint16_t(flags >> IORING_CQE_BUFFER_SHIFT);
+		if (res > 0 && !client->uringClosing) {
+			client->performRead(BytesView(_uring->getBuffer(bid), size_t(res)));
+		}
+		_uring->returnBuffer(bid);
+	}
+
+	if (client->uringClosing) {
+		if (client->uringOps == 0) {
+			client->release();
+		}
+		return;
+	}
+
+	switch (op) {
+	case UringOpAccept:
+		if (res >= 0) {
+			char str[INET6_ADDRSTRLEN + 1] = { 0 };
+
+			// multishot accept can not return address for every connection
+			struct sockaddr_storage addr;
+			socklen_t addrLen = sizeof(addr);
+			memset(&addr, 0, sizeof(addr));
+			::getpeername(res, (struct sockaddr *)&addr, &addrLen);
+
+			uint16_t port = 0;
+			auto peer = getPeerAddress(addr, str, sizeof(str), port);
+
+			pushFd(_epollFd, res, peer, port);
+		} else if (res != -ECANCELED) {
+			log::error("ConnectionWorker", "accept() failed with errno ", -res);
+		}
+		if (!client->uringOps && !_shouldClose && !_acceptStopped) {
+			addUringClient(*client);
+		}
+		break;
+	case UringOpPoll:
+		if (client == &_cancelClient) {
+			_shouldClose = true;
+		} else if (client == &_wakeupClient) {
+			processWakeup();
+		} else if (client == &_timerClient) {
+			_queue->processTimers();
+		} else if (client == &_notifyClient) {
+			_root->getFileCache()->update();
+		}
+		if (!client->uringOps && !_shouldClose) {
+			addUringClient(*client);
+		}
+		break;
+	case UringOpRecv:
+		if (res == 0 || (res < 0 && res != -ENOBUFS)) {
+			// connection was closed by peer or failed, same as EPOLLRDHUP/EPOLLERR for epoll
+			removeClient(*client);
+			return;
+		}
+
+		// ENOBUFS: all provided buffers are in use, they are returned after processing, so just rearm
+		if (!client->uringRecv && !client->shutdownReadSend) {
+			recvUring(*client);
+		}
+		updateClient(*client);
+		break;
+	case UringOpPollOut:
+		if (res < 0 || (res & (POLLERR | POLLHUP))) {
+			removeClient(*client);
+			return;
+		}
+		client->performWrite();
+		updateClient(*client);
+		break;
+	default:
+		break;
+	}
+}
+
+}
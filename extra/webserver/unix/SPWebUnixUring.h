@@ -0,0 +1,87 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+#ifndef EXTRA_WEBSERVER_UNIX_SPWEBUNIXURING_H_
+#define EXTRA_WEBSERVER_UNIX_SPWEBUNIXURING_H_
+
+#include "SPWebUnixConfig.h"
+
+#include <linux/io_uring.h>
+
+namespace STAPPLER_VERSIONIZED stappler::web {
+
+// Minimal io_uring queue on top of raw syscalls, liburing is not required
+// Requires kernel 5.19+ (provided buffer rings, multishot accept)
+class SP_PUBLIC UringQueue : public AllocBase {
+public:
+	~UringQueue();
+
+	// bufferCount should be a power of two
+	bool init(uint32_t entries, uint32_t bufferCount, uint32_t bufferSize);
+
+	// returns nullptr when submission queue is full and can not be flushed
+	struct io_uring_sqe *getSqe();
+
+	// submit pending entries and wait for at least one completion, timeout in milliseconds, -1 for infinite
+	int submitAndWait(int timeout);
+
+	uint32_t foreachCompletion(const Callback<void(uint64_t, int32_t, uint32_t)> &);
+
+	uint16_t getBufferGroup() const { return _bufferGroup; }
+	uint8_t *getBuffer(uint16_t) const;
+	uint32_t getBufferSize() const { return _bufferSize; }
+	void returnBuffer(uint16_t);
+
+protected:
+	int enter(uint32_t submit, uint32_t wait, uint32_t flags, void *arg, size_t argSize);
+
+	int _fd = -1;
+
+	void *_sqRing = nullptr;
+	void *_cqRing = nullptr;
+	size_t _sqRingSize = 0;
+	size_t _cqRingSize = 0;
+
+	uint32_t *_sqHead = nullptr;
+	uint32_t *_sqTail = nullptr;
+	uint32_t _sqMask = 0;
+	uint32_t _sqEntries = 0;
+	uint32_t _sqLocalTail = 0;
+	uint32_t _sqPending = 0;
+	struct io_uring_sqe *_sqes = nullptr;
+
+	uint32_t *_cqHead = nullptr;
+	uint32_t *_cqTail = nullptr;
+	uint32_t _cqMask = 0;
+	struct io_uring_cqe *_cqes = nullptr;
+
+	struct io_uring_buf_ring *_bufRing = nullptr;
+	uint8_t *_buffers = nullptr;
+	uint32_t _bufferCount = 0;
+	uint32_t _bufferSize = 0;
+	uint16_t _bufferGroup = 0;
+	uint16_t _bufferTail = 0;
+};
+
+}
+
+#endif /* EXTRA_WEBSERVER_UNIX_SPWEBUNIXURING_H_ */
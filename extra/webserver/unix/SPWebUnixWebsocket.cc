@@ -21,6 +21,7 @@
  **/
 
 #include "SPWebUnixWebsocket.h"
+#include "SPWebUnixConnectionWorker.h"
 
 namespace STAPPLER_VERSIONIZED stappler::web {
 
@@ -183,4 +184,248 @@ bool UnixWebsocketConnectionSim::processFrame(BytesView frame) {
 	return true;
 }
 
+UnixWebsocketConnection::UnixWebsocketConnection(allocator_t *a, pool_t *p, HostController *c,
+		ConnectionWorker::Client *client, WebsocketHandler *h)
+: WebsocketConnection(a, p, c), _worker(client->gen->worker), _client(client), _handler(h)
+, _reader(c->getRoot(), p), _writer(p) {
+	_commonReader = &_reader;
+	_commonWriter = &_writer;
+}
+
+bool UnixWebsocketConnection::write(WebsocketFrameType t, const uint8_t *bytes, size_t count) {
+	if (!_enabled) {
+		return false;
+	}
+
+	if (_worker->isWorkerThread()) {
+		_mutex.lock();
+		flushFrames();
+		writeFrame(t, bytes, count);
+		_mutex.unlock();
+		return true;
+	}
+
+	// socket is owned by worker, store frame until worker wakes up
+	StackBuffer<32> buf;
+	WebsocketFrameWriter::makeHeader(buf, count, t);
+
+	_mutex.lock();
+	auto slot = _writer.nextEmplaceSlot(buf.size() + count);
+	slot->emplace(buf.data(), buf.size());
+	if (count > 0) {
+		slot->emplace(bytes, count);
+	}
+	_mutex.unlock();
+
+	wakeup();
+	return true;
+}
+
+bool UnixWebsocketConnection::run(WebsocketHandler *, const Callback<void()> &beginCb, const Callback<void()> &endCb) {
+	return false;
+}
+
+void UnixWebsocketConnection::wakeup() {
+	_worker->scheduleWakeup(this);
+}
+
+TimeInterval UnixWebsocketConnection::getTtl() const {
+	return _handler ? _handler->getTtl() : TimeInterval();
+}
+
+void UnixWebsocketConnection::begin() {
+	// override default with user-defined max
+	_reader.max = _handler->getMaxInputFrameSize();
+
+	_enabled = true;
+	_shouldTerminate.test_and_set();
+
+	perform([&, this] {
+		_handler->handleBegin();
+	}, _reader.pool, config::TAG_WEBSOCKET, this);
+	_reader.clear();
+
+	attachHandler(_handler);
+}
+
+Status UnixWebsocketConnection::processInput(ConnectionWorker::BufferChain &chain) {
+	if (_closing) {
+		chain.clear();
+		return DECLINED;
+	}
+
+	auto ret = chain.read([&, this] (const ConnectionWorker::Buffer *, const uint8_t *data, size_t len) {
+		size_t offset = 0;
+		while (offset < len) {
+			size_t required = std::min(_reader.getRequiredBytes(), len - offset);
+			if (required == 0) {
+				// reader can not accept more data for the current frame
+				_serverCloseCode = WebsocketStatusCode::ProtocolError;
+				return int(DECLINED);
+			}
+
+			uint8_t *buf = _reader.prepare(required);
+			memcpy(buf, data + offset, required);
+			offset += required;
+
+			if (!_reader.save(buf, required) || !processFrame()) {
+				return int(DECLINED);
+			}
+		}
+		return int(len);
+	}, true);
+
+	if (ret == DECLINED) {
+		chain.clear();
+		close();
+		return DECLINED;
+	}
+
+	if (!_shouldTerminate.test_and_set()) {
+		close();
+		return DECLINED;
+	}
+
+	return OK;
+}
+
+void UnixWebsocketConnection::handleWakeup() {
+	_group.update();
+
+	if (!_client) {
+		// socket was closed, wait for async tasks before release
+		auto counters = _group.getCounters();
+		if (counters.first == counters.second) {
+			finalize();
+		}
+		return;
+	}
+
+	if (_closing) {
+		return;
+	}
+
+	if (!_handler->processBroadcasts()) {
+		_shouldTerminate.clear();
+	}
+
+	_mutex.lock();
+	flushFrames();
+	_mutex.unlock();
+
+	if (!_shouldTerminate.test_and_set()) {
+		close();
+	}
+}
+
+void UnixWebsocketConnection::end() {
+	if (_enabled || _closing) {
+		detachHandler(_handler);
+	}
+
+	_enabled = false;
+	_client = nullptr;
+
+	_group.update();
+
+	auto counters = _group.getCounters();
+	if (counters.first == counters.second) {
+		finalize();
+	}
+	// otherwise, connection will be finalized on wakeup from the last completed task
+}
+
+void UnixWebsocketConnection::expire() {
+	_serverCloseCode = WebsocketStatusCode::Away;
+	close();
+}
+
+bool UnixWebsocketConnection::processFrame() {
+	if (_reader.isControlReady()) {
+		if (_reader.type == WebsocketFrameType::Close) {
+			if (_reader.buffer.size() >= 2) {
+				_clientCloseCode = WebsocketStatusCode(_reader.buffer.get<BytesViewNetwork>().readUnsigned16());
+			} else {
+				_clientCloseCode = WebsocketStatusCode::Ok;
+			}
+			_reader.popFrame();
+			return false;
+		} else if (_reader.type == WebsocketFrameType::Ping) {
+			// RFC 6455: Pong frame must contain the application data from Ping
+			writeFrame(WebsocketFrameType::Pong, _reader.buffer.data(), _reader.buffer.size());
+		}
+		_reader.popFrame();
+	} else if (_reader.isFrameReady()) {
+		auto ret = perform([&, this] {
+			_handler->sendPendingNotifications(_reader.pool);
+			return _handler->handleFrame(_reader.type, _reader.frame.buffer);
+		}, _reader.pool, config::TAG_WEBSOCKET, this);
+		_reader.popFrame();
+		return ret;
+	}
+	return true;
+}
+
+void UnixWebsocketConnection::writeFrame(WebsocketFrameType t, const uint8_t *bytes, size_t count) {
+	StackBuffer<32> buf;
+	WebsocketFrameWriter::makeHeader(buf, count, t);
+
+	_client->write(_client->output, buf.data(), buf.size());
+	if (count > 0) {
+		_client->write(_client->output, bytes, count);
+	}
+}
+
+void UnixWebsocketConnection::flushFrames() {
+	while (!_writer.empty()) {
+		auto slot = _writer.nextReadSlot();
+		while (!slot->empty()) {
+			auto len = slot->getNextLength();
+			_client->write(_client->output, slot->getNextBytes(), len);
+			slot->pop(len);
+		}
+		_writer.popReadSlot();
+	}
+}
+
+void UnixWebsocketConnection::close() {
+	if (_closing || !_client) {
+		return;
+	}
+
+	_mutex.lock();
+	flushFrames();
+
+	auto status = byteorder::HostToNetwork(uint16_t((_clientCloseCode == WebsocketStatusCode::None)
+			? resolveStatus(_serverCloseCode) : _clientCloseCode));
+	size_t reasonSize = std::min(size_t(123), _serverReason.size());
+
+	uint8_t payload[125];
+	memcpy(payload, &status, sizeof(uint16_t));
+	if (reasonSize > 0) {
+		memcpy(payload + 2, _serverReason.data(), reasonSize);
+	}
+
+	writeFrame(WebsocketFrameType::Close, payload, reasonSize + 2);
+	_mutex.unlock();
+
+	_enabled = false;
+	_closing = true;
+
+	// socket will be closed by worker when Close frame is sent
+	_client->write(_client->output, nullptr, 0, ConnectionWorker::Buffer::Eos);
+	_client->shutdownRead();
+}
+
+void UnixWebsocketConnection::finalize() {
+	perform([&, this] {
+		_handler->handleEnd();
+	}, _reader.pool, config::TAG_WEBSOCKET, this);
+	memory::pool::clear(_reader.pool);
+
+	_worker->cancelWakeup(this);
+
+	WebsocketConnection::destroy(this);
+}
+
 }
@@ -25,6 +25,7 @@
 
 #include "SPWebWebsocket.h"
 #include "SPWebWebsocketConnection.h"
+#include "SPWebUnixConnectionWorker.h"
 
 namespace STAPPLER_VERSIONIZED stappler::web {
 
@@ -80,6 +81,61 @@ protected:
 	std::vector<mem_std::Value> _inputValues;
 };
 
+// Websocket on the client's socket, driven by the ConnectionWorker's event loop
+class SP_PUBLIC UnixWebsocketConnection : public WebsocketConnection {
+public:
+	UnixWebsocketConnection(allocator_t *, pool_t *, HostController *c, ConnectionWorker::Client *, WebsocketHandler *);
+
+	// thread-safe, frames from other threads are queued and sent by worker
+	virtual bool write(WebsocketFrameType t, const uint8_t *bytes = nullptr, size_t count = 0) override;
+
+	// not used, connection has no dedicated thread
+	virtual bool run(WebsocketHandler *, const Callback<void()> &beginCb, const Callback<void()> &endCb) override;
+
+	virtual void wakeup() override;
+
+	virtual bool isEventDriven() const override { return true; }
+
+	ConnectionWorker::Client *getClient() const { return _client; }
+
+	TimeInterval getTtl() const;
+
+	bool isClosing() const { return _closing; }
+
+	// called by worker when handshake response was submitted
+	void begin();
+
+	// process frames from client's input, returns DECLINED when connection should be closed
+	Status processInput(ConnectionWorker::BufferChain &);
+
+	// process broadcasts, async tasks and queued frames on worker thread
+	void handleWakeup();
+
+	// client's socket was closed, connection is destroyed when all async tasks are completed
+	void end();
+
+	// no input within TTL, send Close frame with Away status
+	void expire();
+
+protected:
+	friend class ConnectionWorker;
+
+	bool processFrame();
+	void writeFrame(WebsocketFrameType t, const uint8_t *bytes, size_t count);
+	void flushFrames();
+	void close();
+	void finalize();
+
+	ConnectionWorker *_worker = nullptr;
+	ConnectionWorker::Client *_client = nullptr;
+	WebsocketHandler *_handler = nullptr;
+	WebsocketFrameReader _reader;
+	WebsocketFrameWriter _writer;
+
+	bool _closing = false;
+	bool _wakeupScheduled = false; // protected by worker's wakeup mutex
+};
+
 }
 
 #endif /* EXTRA_WEBSERVER_UNIX_SPWEBUNIXWEBSOCKET_H_ */
@@ -26,6 +26,9 @@ MODULE_STAPPLER_WEBSERVER_UNIX_INCLUDES_DIRS := $(WEBSERVER_MODULE_DIR)/unix
 MODULE_STAPPLER_WEBSERVER_UNIX_INCLUDES_OBJS :=
 MODULE_STAPPLER_WEBSERVER_UNIX_DEPENDS_ON := stappler_webserver_webserver
 
+# TLS listeners (handshake only, records are processed with kTLS)
+MODULE_STAPPLER_WEBSERVER_UNIX_GENERAL_LDLIBS := -lssl
+
 #spec
 
 MODULE_STAPPLER_WEBSERVER_UNIX_SHARED_SPEC_SUMMARY := libstappler webserver implementation on unix sockets
@@ -176,6 +176,13 @@ enum class HostComponentType {
 	Wasm
 };
 
+// admission class of the handler: under overload requests are rejected starting from the lowest class
+enum class RequestPriority {
+	Low, // gets only half of the limits (background jobs, prefetch, bulk exports)
+	Normal,
+	High, // never rejected by admission control (health checks, control endpoints)
+};
+
 // brotli compression configuration
 // based on mod_brotli defaults
 struct SP_PUBLIC CompressionInfo {
@@ -222,6 +229,11 @@ struct SP_PUBLIC RequestSchemeInfo {
 	Value data;
 	const db::Scheme *scheme = nullptr;
 	const RequestHandlerMap *map = nullptr;
+
+	// handler is fast enough to be processed on I/O thread, when server uses separate handler threads
+	bool isInline = false;
+
+	RequestPriority priority = RequestPriority::Normal;
 };
 
 struct SP_PUBLIC HostInfo {
@@ -58,8 +58,30 @@ public:
 	}
 	virtual void finalize() override { }
 
+	virtual db::InputFile *getDirectTarget() override {
+		// data, written with the file object, can still be buffered in it
+		if (file && !skip && (direct || file->writeSize == 0)) {
+			return file;
+		}
+		return nullptr;
+	}
+
+	virtual bool runDirect(size_t size) override {
+		if (file && !skip) {
+			direct = true;
+			file->writeSize += size;
+			if (file->writeSize >= getConfig().maxFileSize) {
+				file->close();
+				skip = true;
+				return false;
+			}
+		}
+		return true;
+	}
+
 protected:
 	bool skip = false;
+	bool direct = false;
 	db::InputFile *file = nullptr;
 };
 
@@ -183,6 +205,11 @@ static InputFilter::Accept getAcceptedData(const Request &req, InputFilter::Exce
 					}
 				}
 			}
+			if (ret == InputFilter::Accept::Files && cl >= cfg.maxFileSize
+					&& (cfg.required & db::InputConfig::Require::Body) == db::InputConfig::Require::None) {
+				// raw file can not be stored, reject it before the body was sent
+				return reportError(InputFilter::Exception::TooLarge, StringView());
+			}
 		} else {
 			e = InputFilter::Exception::Unrecognized;
 		}
@@ -285,23 +312,7 @@ bool InputFilter::step(BytesView data) {
 		return false;
 	}
 
-	if (_read + data.size() > _contentLength) {
-		_unupdated += _contentLength - _read;
-		_read = _contentLength;
-	} else {
-		_read += data.size();
-		_unupdated += data.size();
-	}
-
-	auto t = Time::now();
-	_timer = t - _time;
-	_time = t;
-
-	if (_timer > getConfig().updateTime || _unupdated > (_contentLength * getConfig().updateFrequency)) {
-		_request.config()->getHost()->getRoot()->handleFilterUpdate(this);
-		_timer = TimeInterval();
-		_unupdated = 0;
-	}
+	updateProgress(data.size());
 
 	if (isBodySavingAllowed()) {
 		_body.write((const char *)data.data(), data.size());
@@ -319,6 +330,23 @@ bool InputFilter::step(BytesView data) {
 	return true;
 }
 
+db::InputFile *InputFilter::getDirectTarget() const {
+	if (!_parser || _accept != Accept::Files || !isFileUploadAllowed() || isBodySavingAllowed()) {
+		return nullptr;
+	}
+	return _parser->getDirectTarget();
+}
+
+bool InputFilter::stepDirect(size_t size) {
+	if (getConfig().required == db::InputConfig::Require::None || _accept != Accept::Files) {
+		return false;
+	}
+
+	updateProgress(size);
+
+	return _parser && _parser->runDirect(size);
+}
+
 void InputFilter::finalize() {
 	if (_parser && (
 			(_accept == Accept::Urlencoded && isDataParsingAllowed()) ||
@@ -403,4 +431,24 @@ memory::pool_t *InputFilter::getPool() const {
 	return _request.pool();
 }
 
+void InputFilter::updateProgress(size_t size) {
+	if (_read + size > _contentLength) {
+		_unupdated += _contentLength - _read;
+		_read = _contentLength;
+	} else {
+		_read += size;
+		_unupdated += size;
+	}
+
+	auto t = Time::now();
+	_timer = t - _time;
+	_time = t;
+
+	if (_timer > getConfig().updateTime || _unupdated > (_contentLength * getConfig().updateFrequency)) {
+		_request.config()->getHost()->getRoot()->handleFilterUpdate(this);
+		_timer = TimeInterval();
+		_unupdated = 0;
+	}
+}
+
 }
@@ -41,6 +41,12 @@ public:
 	virtual void finalize() = 0;
 	virtual void cleanup();
 
+	// file, that can receive input directly, without run(), nullptr if parser should see the data
+	virtual db::InputFile *getDirectTarget() { return nullptr; }
+
+	// account data, written into direct target
+	virtual bool runDirect(size_t) { return false; }
+
 	virtual Value &getData() {
 		return root;
 	}
@@ -87,6 +93,13 @@ public:
 	bool step(BytesView);
 	void finalize();
 
+	// upload file, that can be written with the request body directly (e.g. with splice),
+	// only for raw file uploads, when body is not saved and not parsed
+	db::InputFile *getDirectTarget() const;
+
+	// same as step, but data was already written into direct target by caller
+	bool stepDirect(size_t);
+
 	StringView getContentType() const;
 
 	size_t getContentLength() const;
@@ -134,6 +147,9 @@ protected:
 	Request _request;
 
 	bool _eos = false, _isCompleted = false, _isStarted = false;
+
+private:
+	void updateProgress(size_t);
 };
 
 }
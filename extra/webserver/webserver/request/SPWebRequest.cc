@@ -297,6 +297,8 @@ void Request::storeObject(void *ptr, const StringView &key, Function<void()> &&c
 
 bool Request::performWithStorage(const Callback<bool(const db::Transaction &)> &cb) const {
 	auto ad = _config->acquireDatabase();
+
+	RequestTraceScope span(_config, "db");
 	return ad.performWithTransaction([&, this] (const db::Transaction &t) {
 		t.setRole(_config->_accessRole);
 		return cb(t);
@@ -449,6 +451,8 @@ bool Request::checkCacheHeaders(Time t, uint32_t idHash) {
 
 Status Request::runPug(const StringView & path, const Function<bool(pug::Context &, const pug::Template &)> &cb) {
 	auto cache = host().getPugCache();
+
+	RequestTraceScope span(_config, "pug");
 	if (cache->runTemplate(path, [&, this] (pug::Context &ctx, const pug::Template &tpl) -> bool {
 		initScriptContext(ctx);
 
@@ -29,6 +29,11 @@
 
 namespace STAPPLER_VERSIONIZED stappler::web {
 
+uint64_t RequestController::getTraceClock() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 RequestController::~RequestController() { }
 
 RequestController::RequestController(pool_t *pool, RequestInfo &&info)
@@ -102,6 +107,7 @@ bool RequestController::isSecureAuthAllowed() const {
 
 db::Adapter RequestController::acquireDatabase() {
 	if (!_database) {
+		RequestTraceScope span(this, "db-connect");
 		_database = Host(_host).acquireDbForRequest(this);
 	}
 	return db::Adapter(_database, _host->getRoot());
@@ -144,4 +150,38 @@ void RequestController::pushDebugMessage(Value &&val) {
 	_debug.emplace_back(sp::move(val));
 }
 
+void RequestController::startTrace() {
+	if (!_traceStart) {
+		_traceStart = getTraceClock();
+	}
+}
+
+size_t RequestController::beginSpan(StringView name) {
+	if (!_traceStart) {
+		return InvalidSpan;
+	}
+
+	_traceSpans.emplace_back(TraceSpan{name, getTraceClock()});
+	return _traceSpans.size() - 1;
+}
+
+void RequestController::endSpan(size_t idx) {
+	if (idx < _traceSpans.size()) {
+		auto &span = _traceSpans[idx];
+		span.duration = getTraceClock() - span.start;
+	}
+}
+
+RequestTraceScope::RequestTraceScope(RequestController *c, StringView name) : _controller(c) {
+	if (_controller) {
+		_span = _controller->beginSpan(name);
+	}
+}
+
+RequestTraceScope::~RequestTraceScope() {
+	if (_controller) {
+		_controller->endSpan(_span);
+	}
+}
+
 }
@@ -37,6 +37,18 @@ class WebsocketConnection;
 
 class SP_PUBLIC RequestController : public AllocBase {
 public:
+	// span of the request processing, times are in microseconds on the monotonic clock
+	struct TraceSpan {
+		StringView name; // should be static, like the string literal
+		uint64_t start = 0;
+		uint64_t duration = 0;
+	};
+
+	static constexpr size_t InvalidSpan = maxOf<size_t>();
+
+	// monotonic clock for the spans
+	static uint64_t getTraceClock();
+
 	virtual ~RequestController();
 
 	RequestController(pool_t *, RequestInfo &&);
@@ -100,6 +112,16 @@ public:
 	virtual void pushErrorMessage(Value &&);
 	virtual void pushDebugMessage(Value &&);
 
+	// request tracing is opt-in, spans are recorded only after the trace was started
+	void startTrace();
+	bool isTraceEnabled() const { return _traceStart != 0; }
+	uint64_t getTraceStart() const { return _traceStart; }
+	const Vector<TraceSpan> &getTraceSpans() const { return _traceSpans; }
+
+	// returns InvalidSpan, when tracing is disabled
+	size_t beginSpan(StringView name);
+	void endSpan(size_t);
+
 protected:
 	friend class Request;
 
@@ -121,6 +143,23 @@ protected:
 	Map<StringView, CookieStorageInfo> _cookies;
 	db::AccessRoleId _accessRole = db::AccessRoleId::Nobody;
 	Vector<Pair<StringView, float>> _acceptList;
+
+	uint64_t _traceStart = 0;
+	Vector<TraceSpan> _traceSpans;
+};
+
+// records the scope as the span of the request, does nothing when request is not traced
+class SP_PUBLIC RequestTraceScope {
+public:
+	RequestTraceScope(RequestController *, StringView name);
+	~RequestTraceScope();
+
+	RequestTraceScope(const RequestTraceScope &) = delete;
+	RequestTraceScope &operator=(const RequestTraceScope &) = delete;
+
+protected:
+	RequestController *_controller = nullptr;
+	size_t _span = RequestController::InvalidSpan;
 };
 
 }
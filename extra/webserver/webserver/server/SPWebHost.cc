@@ -982,6 +982,36 @@ void Host::addHandler(std::initializer_list<StringView> paths, const RequestHand
 	}
 }
 
+void Host::setInlineHandler(StringView path, bool value) const {
+	auto it = _config->_requests.find(path);
+	if (it != _config->_requests.end()) {
+		it->second.isInline = value;
+	}
+}
+
+bool Host::isInlineHandler(StringView path) const {
+	auto it = Host_resolvePath(_config->_requests, path);
+	if (it == _config->_requests.end() || (!it->second.callback && !it->second.map)) {
+		return true;
+	}
+	return it->second.isInline;
+}
+
+void Host::setHandlerPriority(StringView path, RequestPriority priority) const {
+	auto it = _config->_requests.find(path);
+	if (it != _config->_requests.end()) {
+		it->second.priority = priority;
+	}
+}
+
+RequestPriority Host::getHandlerPriority(StringView path) const {
+	auto it = Host_resolvePath(_config->_requests, path);
+	if (it == _config->_requests.end() || (!it->second.callback && !it->second.map)) {
+		return RequestPriority::Normal;
+	}
+	return it->second.priority;
+}
+
 void Host::addWebsocket(StringView str, WebsocketManager *m) const {
 	_config->_websockets.emplace(str.pdup(_config->_rootPool), m);
 }
@@ -95,6 +95,18 @@ public:
 	void addHandler(StringView, const RequestHandlerMap *) const;
 	void addHandler(std::initializer_list<StringView>, const RequestHandlerMap *) const;
 
+	// mark handler, that was added for the path, as fast one, that does not need separate handler thread
+	void setInlineHandler(StringView, bool value = true) const;
+
+	// requests without handler are always inline
+	bool isInlineHandler(StringView path) const;
+
+	// admission class for the handler, that was added for the path
+	void setHandlerPriority(StringView, RequestPriority) const;
+
+	// requests without handler (static files) have normal priority
+	RequestPriority getHandlerPriority(StringView path) const;
+
 	void addResourceHandler(StringView, const db::Scheme &) const;
 	void addResourceHandler(StringView, const db::Scheme &, const Value &val) const;
 	void addMultiResourceHandler(StringView, std::initializer_list<Pair<const StringView, const db::Scheme *>> &&) const;
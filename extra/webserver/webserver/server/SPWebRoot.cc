@@ -211,6 +211,7 @@ db::sql::Driver::Handle Root::dbdAcquire(const Request &req) {
 }
 
 Status Root::runPostReadRequest(Request &r) {
+	RequestTraceScope span(r.config(), "post-read");
 	return perform([&, this] {
 		_requestsReceived += 1;
 		//OutputFilter::insert(r);
@@ -233,6 +234,7 @@ Status Root::runPostReadRequest(Request &r) {
 }
 
 Status Root::runTranslateName(Request &r) {
+	RequestTraceScope span(r.config(), "translate");
 	return perform([&] () {
 		Request request(r);
 
@@ -263,6 +265,7 @@ Status Root::runTranslateName(Request &r) {
 }
 
 Status Root::runCheckAccess(Request &r) {
+	RequestTraceScope span(r.config(), "access");
 	return perform([&] {
 		Request request(r);
 		RequestHandler *rhdl = request.getRequestHandler();
@@ -279,6 +282,7 @@ Status Root::runCheckAccess(Request &r) {
 }
 
 Status Root::runQuickHandler(Request &r, int v) {
+	RequestTraceScope span(r.config(), "quick-handler");
 	return perform([&] () -> Status {
 		Request request(r);
 		RequestHandler *rhdl = request.getRequestHandler();
@@ -290,6 +294,7 @@ Status Root::runQuickHandler(Request &r, int v) {
 }
 
 void Root::runInsertFilter(Request &r) {
+	RequestTraceScope span(r.config(), "insert-filter");
 	perform([&] {
 		Request request(r);
 
@@ -301,6 +306,7 @@ void Root::runInsertFilter(Request &r) {
 }
 
 Status Root::runHandler(Request &r) {
+	RequestTraceScope span(r.config(), "handler");
 	return perform([&] () -> Status {
 		Request request(r);
 
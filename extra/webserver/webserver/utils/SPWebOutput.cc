@@ -316,6 +316,8 @@ void writeData(Request &rctx, const Value &data, bool allowJsonP) {
 void writeData(Request &rctx, const Callback<void(StringView)> &stream, const Callback<void(StringView)> &ct,
 		const Value &data, bool allowJsonP) {
 
+	RequestTraceScope span(rctx.getController(), "serialize");
+
 	auto &info = rctx.getInfo();
 	bool allowCbor = rctx.getController()->isAcceptable("application/cbor") > 0.0f;
 	auto pretty = info.queryData.getValue("pretty");
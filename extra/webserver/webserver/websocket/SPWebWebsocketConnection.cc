@@ -21,6 +21,7 @@
  **/
 
 #include "SPWebWebsocketConnection.h"
+#include "SPWebWebsocketManager.h"
 
 namespace STAPPLER_VERSIONIZED stappler::web {
 
@@ -83,6 +84,14 @@ WebsocketStatusCode WebsocketConnection::resolveStatus(WebsocketStatusCode code)
 	return code;
 }
 
+void WebsocketConnection::attachHandler(WebsocketHandler *h) {
+	h->manager()->addHandler(h);
+}
+
+void WebsocketConnection::detachHandler(WebsocketHandler *h) {
+	h->manager()->removeHandler(h);
+}
+
 WebsocketConnection::WebsocketConnection(allocator_t *a, pool_t *p, HostController *c)
 : _allocator(a), _pool(p), _group(Host(c), [this] {
 	wakeup();
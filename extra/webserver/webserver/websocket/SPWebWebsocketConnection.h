@@ -45,6 +45,9 @@ public:
 
 	virtual void wakeup() = 0;
 
+	// connection is driven by the server's event loop and does not require a dedicated thread
+	virtual bool isEventDriven() const { return false; }
+
 	virtual void terminate();
 
 	db::AccessRoleId getAccessRole() const { return _accessRole; }
@@ -66,6 +69,10 @@ protected:
 
 	WebsocketConnection(allocator_t *, pool_t *, HostController *);
 
+	// register handler within manager, when connection does not use WebsocketManager::run
+	void attachHandler(WebsocketHandler *);
+	void detachHandler(WebsocketHandler *);
+
 	allocator_t *_allocator = nullptr;
 	pool_t *_pool = nullptr;
 	Mutex _mutex;
@@ -117,8 +117,10 @@ Status WebsocketManager::accept(Request &req) {
 			conn->setAccessRole(accessRole);
 
 			handler->setConnection(conn);
-			std::thread thread(WebsocketManager_thread, handler);
-			thread.detach();
+			if (!conn->isEventDriven()) {
+				std::thread thread(WebsocketManager_thread, handler);
+				thread.detach();
+			}
 			return HTTP_OK;
 		}
 	}
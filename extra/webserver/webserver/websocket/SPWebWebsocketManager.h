@@ -49,6 +49,8 @@ public:
 	const Host &host() const { return _host; }
 
 protected:
+	friend class WebsocketConnection;
+
 	void addHandler(WebsocketHandler *);
 	void removeHandler(WebsocketHandler *);
 
@@ -0,0 +1,189 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+
+#include "SPCommon.h"
+#include "Test.h"
+
+#if MODULE_STAPPLER_WEBSERVER_UNIX
+
+#include "SPWebUnixConnectionWorker.h"
+
+#include <sys/socket.h>
+#include <fcntl.h>
+
+namespace STAPPLER_VERSIONIZED stappler::app::test {
+
+struct UnixBufferChainTest : Test {
+	using Buffer = web::ConnectionWorker::Buffer;
+	using BufferChain = web::ConnectionWorker::BufferChain;
+
+	UnixBufferChainTest() : Test("UnixBufferChainTest") { }
+
+	// every block in its own buffer, so the chain is written with one iovec per block
+	static void fill(memory::pool_t *pool, BufferChain &chain, size_t nblocks, size_t blockSize, String &expected) {
+		for (size_t i = 0; i < nblocks; ++ i) {
+			auto block = toString("block-", i, ";");
+			while (block.size() < blockSize) {
+				block.append("-");
+			}
+
+			auto b = Buffer::create(pool, expected.size());
+			b->write((const uint8_t *)block.data(), block.size());
+			chain.write(b);
+			expected.append(block);
+		}
+	}
+
+	static void readAvailable(int fd, String &out) {
+		char buf[4_KiB];
+		auto n = ::recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+		while (n > 0) {
+			out.append(buf, n);
+			n = ::recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+		}
+	}
+
+	virtual bool run() override {
+		StringStream stream;
+		size_t count = 0;
+		size_t passed = 0;
+		stream << "\n";
+
+		auto pool = memory::pool::create(memory::pool::acquire());
+
+		// more buffers, than one writev call can take, should be sent with several calls in order
+		runTest(stream, "GatherOverIovMax", count, passed, [&] {
+			int sv[2];
+			if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+				return false;
+			}
+
+			BufferChain chain;
+			String expected;
+			fill(pool, chain, web::config::UNIX_WRITE_IOV_MAX * 2 + 7, 16, expected);
+			chain.back->flags = Buffer::Eos;
+
+			size_t written = 0;
+			auto status = chain.writeToFd(sv[0], written);
+
+			String out;
+			readAvailable(sv[1], out);
+
+			chain.clear();
+			::close(sv[0]);
+			::close(sv[1]);
+
+			return status == web::DONE && written == expected.size() && out == expected;
+		});
+
+		// headers are sent with MSG_MORE, then the file with sendfile
+		runTest(stream, "HeadersWithFile", count, passed, [&] {
+			auto path = filesystem::currentDir<Interface>("web/buffer_chain.txt");
+			filesystem::mkdir(filesystem::currentDir<Interface>("web"));
+
+			String fileData;
+			for (size_t i = 0; fileData.size() < 16_KiB; ++ i) {
+				fileData.append(toString("file content ", i, "\n"));
+			}
+			filesystem::write(path, fileData);
+
+			int sv[2];
+			if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+				return false;
+			}
+
+			BufferChain chain;
+			String expected;
+			fill(pool, chain, 3, 32, expected);
+
+			auto file = Buffer::create(pool, nullptr, path, 0, maxOf<size_t>(), expected.size());
+			if (!file) {
+				chain.clear();
+				::close(sv[0]);
+				::close(sv[1]);
+				return false;
+			}
+
+			file->flags |= Buffer::Eos;
+			chain.write(file);
+			expected.append(fileData);
+
+			size_t written = 0;
+			auto status = chain.writeToFd(sv[0], written);
+
+			String out;
+			readAvailable(sv[1], out);
+
+			chain.clear();
+			::close(sv[0]);
+			::close(sv[1]);
+			filesystem::remove(path);
+
+			return status == web::DONE && written == expected.size() && out == expected;
+		});
+
+		// partial writes can stop in the middle of any buffer, chain should continue from the same byte
+		runTest(stream, "PartialWrite", count, passed, [&] {
+			int sv[2];
+			if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+				return false;
+			}
+
+			int sndbuf = 4_KiB;
+			::setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+			::fcntl(sv[0], F_SETFL, ::fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+
+			BufferChain chain;
+			String expected;
+			fill(pool, chain, 300, 1000, expected);
+			chain.back->flags = Buffer::Eos;
+
+			String out;
+			size_t written = 0;
+			size_t suspended = 0;
+			auto status = chain.writeToFd(sv[0], written);
+			while (status == web::SUSPENDED && out.size() < expected.size()) {
+				++ suspended;
+				readAvailable(sv[1], out);
+				status = chain.writeToFd(sv[0], written);
+			}
+			readAvailable(sv[1], out);
+
+			chain.clear();
+			::close(sv[0]);
+			::close(sv[1]);
+
+			return status == web::DONE && suspended > 0 && written == expected.size() && out == expected;
+		});
+
+		memory::pool::destroy(pool);
+
+		_desc = stream.str();
+
+		return count == passed;
+	}
+} _UnixBufferChainTest;
+
+}
+
+#endif
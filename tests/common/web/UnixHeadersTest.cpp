@@ -0,0 +1,154 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+
+#include "SPCommon.h"
+#include "Test.h"
+
+#if MODULE_STAPPLER_WEBSERVER_UNIX
+
+#include "SPWebUnixHeaders.h"
+
+namespace STAPPLER_VERSIONIZED stappler::app::test {
+
+struct UnixHeadersTest : Test {
+	UnixHeadersTest() : Test("UnixHeadersTest") { }
+
+	static String toUpper(StringView str) {
+		String ret(str.data(), str.size());
+		for (auto &c : ret) {
+			c = char(::toupper(c));
+		}
+		return ret;
+	}
+
+	virtual bool run() override {
+		StringStream stream;
+		size_t count = 0;
+		size_t passed = 0;
+		stream << "\n";
+
+		auto pool = memory::pool::create(memory::pool::acquire());
+		memory::pool::push(pool);
+
+		// every known name is found in its own slot regardless of case
+		runTest(stream, "KnownLookup", count, passed, [&] {
+			for (size_t i = 0; i < web::UnixHeaders::KnownCount; ++ i) {
+				auto name = web::UnixHeaders::getKnownName(i);
+				if (name.empty() || web::UnixHeaders::getKnownIndex(name) != int(i)
+						|| web::UnixHeaders::getKnownIndex(toUpper(name)) != int(i)) {
+					return false;
+				}
+			}
+
+			// names, that share a slot or a prefix with known ones, should not match them
+			for (auto &it : { "", "hos", "hosts", "x-custom", "content-typ", "accept-encodings" }) {
+				if (web::UnixHeaders::getKnownIndex(StringView(it)) != -1) {
+					return false;
+				}
+			}
+			return web::UnixHeaders::getKnownName(web::UnixHeaders::KnownCount).empty();
+		});
+
+		runTest(stream, "KnownValues", count, passed, [&] {
+			web::UnixHeaders headers(pool);
+			if (!headers.empty() || headers.set("Content-Type", "text/html") != "content-type") {
+				return false;
+			}
+
+			if (headers.get("CONTENT-TYPE") != "text/html" || !headers.contains("content-type") || headers.contains("Host")) {
+				return false;
+			}
+
+			// value is replaced, not duplicated
+			headers.set("content-type", "application/json");
+			size_t n = 0;
+			headers.foreach([&] (StringView, StringView) { ++ n; });
+
+			return n == 1 && headers.get("Content-Type") == "application/json"
+					&& headers.erase("Content-TYPE") && !headers.erase("content-type") && headers.empty();
+		});
+
+		// unknown names are stored lowercased in the sorted overflow vector
+		runTest(stream, "OverflowNames", count, passed, [&] {
+			web::UnixHeaders headers(pool);
+			if (headers.set("X-Custom-B", "2") != "x-custom-b" || headers.set("x-custom-a", "1") != "x-custom-a") {
+				return false;
+			}
+
+			if (headers.get("X-CUSTOM-A") != "1" || headers.get("x-custom-b") != "2" || headers.contains("x-custom-c")) {
+				return false;
+			}
+
+			if (headers.set("X-CUSTOM-B", "3") != "x-custom-b" || headers.get("x-custom-b") != "3") {
+				return false;
+			}
+
+			if (!headers.erase("X-Custom-B") || headers.erase("x-custom-b") || headers.get("X-Custom-B") != StringView()) {
+				return false;
+			}
+
+			headers.clear();
+			return headers.empty() && !headers.contains("x-custom-a");
+		});
+
+		// known and overflow names are merged in name order, as they were in Map<StringView, StringView>
+		runTest(stream, "IterationOrder", count, passed, [&] {
+			web::UnixHeaders headers(pool);
+			headers.set("Zeta-Header", "z");
+			headers.set("Host", "localhost");
+			headers.set("X-Custom", "x");
+			headers.set("Accept", "*/*");
+			headers.set("B-Other", "b");
+			headers.set("Content-Length", "10");
+			headers.set("x-request-id", "id");
+
+			Vector<std::pair<String, String>> result;
+			headers.foreach([&] (StringView name, StringView value) {
+				result.emplace_back(name.str<Interface>(), value.str<Interface>());
+			});
+
+			Vector<std::pair<String, String>> expected{
+				pair("accept", "*/*"),
+				pair("b-other", "b"),
+				pair("content-length", "10"),
+				pair("host", "localhost"),
+				pair("x-custom", "x"),
+				pair("x-request-id", "id"),
+				pair("zeta-header", "z"),
+			};
+
+			return result == expected;
+		});
+
+		memory::pool::pop();
+		memory::pool::destroy(pool);
+
+		_desc = stream.str();
+
+		return count == passed;
+	}
+} _UnixHeadersTest;
+
+}
+
+#endif
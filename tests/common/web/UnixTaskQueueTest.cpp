@@ -0,0 +1,196 @@
+/**
+ Copyright (c) 2024 Stappler LLC <admin@stappler.dev>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ **/
+
+
+#include "SPCommon.h"
+#include "Test.h"
+
+#if MODULE_STAPPLER_WEBSERVER_UNIX
+
+#include "SPWebUnixTaskQueue.h"
+
+#include <thread>
+#include <condition_variable>
+#include <set>
+
+namespace STAPPLER_VERSIONIZED stappler::app::test {
+
+struct UnixTaskQueueTest : Test {
+	// lock can be held by the test to simulate a busy owner
+	struct TestDeque : web::TaskDeque {
+		std::mutex &getMutex() { return _mutex; }
+	};
+
+	UnixTaskQueueTest() : Test("UnixTaskQueueTest") { }
+
+	virtual bool run() override {
+		StringStream stream;
+		size_t count = 0;
+		size_t passed = 0;
+		stream << "\n";
+
+		auto pool = memory::pool::create();
+
+		Vector<web::AsyncTask *> tasks;
+		auto makeTask = [&] (uint8_t priority) {
+			auto task = web::AsyncTask::prepare(pool, [&] (web::AsyncTask &task) {
+				task.setPriority(priority);
+			});
+			tasks.emplace_back(task);
+			return task;
+		};
+
+		// one priority per band, from the lowest
+		uint8_t priorities[] = { 0, 1 << 6, 2 << 6, 3 << 6 };
+
+		// higher band is taken first, tasks within the band are in FIFO order
+		runTest(stream, "BandOrder", count, passed, [&] {
+			TestDeque deque;
+			auto low = makeTask(priorities[0]);
+			auto normal1 = makeTask(priorities[2]);
+			auto highest = makeTask(priorities[3]);
+			auto normal2 = makeTask(priorities[2] + 1);
+			auto high = makeTask(priorities[1]);
+
+			for (auto &it : { low, normal1, highest, normal2, high }) {
+				deque.push(it);
+			}
+
+			if (deque.size() != 5) {
+				return false;
+			}
+
+			web::AsyncTask *expected[] = { highest, normal1, normal2, high, low };
+			for (auto &it : expected) {
+				if (deque.pop() != it) {
+					return false;
+				}
+			}
+			return deque.empty() && deque.pop() == nullptr && deque.steal() == nullptr;
+		});
+
+		// thief does not wait for the busy deque, and takes the same task as the owner would
+		runTest(stream, "StealSkipsBusyDeque", count, passed, [&] {
+			TestDeque deque;
+			auto first = makeTask(priorities[2]);
+			auto second = makeTask(priorities[2]);
+			deque.push(first);
+			deque.push(second);
+
+			std::mutex sync;
+			std::condition_variable cond;
+			bool locked = false;
+			bool release = false;
+
+			std::thread owner([&] {
+				std::unique_lock lock(deque.getMutex());
+				{
+					std::unique_lock l(sync);
+					locked = true;
+					cond.notify_all();
+					cond.wait(l, [&] { return release; });
+				}
+			});
+
+			web::AsyncTask *stolenBusy = nullptr;
+			{
+				std::unique_lock l(sync);
+				cond.wait(l, [&] { return locked; });
+				stolenBusy = deque.steal();
+				release = true;
+				cond.notify_all();
+			}
+			owner.join();
+
+			auto stolen = deque.steal();
+			return stolenBusy == nullptr && stolen == first && deque.pop() == second && deque.empty();
+		});
+
+		// owner and thieves together take every task exactly once
+		runTest(stream, "ConcurrentSteal", count, passed, [&] {
+			static constexpr size_t TasksCount = 4096;
+			static constexpr size_t Thieves = 3;
+
+			TestDeque deque;
+			for (size_t i = 0; i < TasksCount; ++ i) {
+				deque.push(makeTask(priorities[i % 4]));
+			}
+
+			std::atomic<size_t> taken = 0;
+			std::vector<std::vector<web::AsyncTask *>> results(Thieves + 1);
+
+			auto worker = [&] (size_t idx) {
+				while (taken.load() < TasksCount) {
+					auto task = (idx == 0) ? deque.pop() : deque.steal();
+					if (task) {
+						results[idx].emplace_back(task);
+						++ taken;
+					} else {
+						std::this_thread::yield();
+					}
+				}
+			};
+
+			std::vector<std::thread> threads;
+			for (size_t i = 1; i <= Thieves; ++ i) {
+				threads.emplace_back(worker, i);
+			}
+			worker(0);
+			for (auto &it : threads) {
+				it.join();
+			}
+
+			std::set<web::AsyncTask *> unique;
+			for (auto &it : results) {
+				unique.insert(it.begin(), it.end());
+			}
+			return taken.load() == TasksCount && unique.size() == TasksCount && deque.empty();
+		});
+
+		runTest(stream, "Clear", count, passed, [&] {
+			TestDeque deque;
+			for (size_t i = 0; i < 8; ++ i) {
+				deque.push(makeTask(priorities[i % 4]));
+			}
+
+			size_t cleared = 0;
+			deque.clear([&] (web::AsyncTask *) { ++ cleared; });
+			return cleared == 8 && deque.empty() && deque.pop() == nullptr;
+		});
+
+		for (auto &it : tasks) {
+			if (it) {
+				web::AsyncTask::destroy(it);
+			}
+		}
+
+		memory::pool::destroy(pool);
+
+		_desc = stream.str();
+
+		return count == passed;
+	}
+} _UnixTaskQueueTest;
+
+}
+
+#endif
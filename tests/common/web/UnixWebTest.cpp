@@ -28,11 +28,32 @@
 
 #include "SPWebUnixRoot.h"
 #include "SPWebUnixWebsocket.h"
+#include "SPWebAsyncTask.h"
 
 #include "UnixWebTestWebsocket.cc"
 #include "UnixWebTestComponent.cc"
 
 #include <unistd.h>
+#include <sched.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <brotli/decode.h>
+
+#include <openssl/ssl.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+// server can terminate TLS only when OpenSSL is built with kTLS
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(OPENSSL_NO_KTLS)
+#define UNIX_WEB_TEST_TLS 1
+#else
+#define UNIX_WEB_TEST_TLS 0
+#endif
 
 namespace STAPPLER_VERSIONIZED stappler::app::test {
 
@@ -131,182 +152,1405 @@ static Bytes makeFileMultipartRequest(StringView boundary) {
 	auto cborFile = filesystem::currentDir<Interface>("data/app.cbor");
 	auto jsonFile = filesystem::currentDir<Interface>("data/app.json");
 
-	stream << "--" << boundary << "\r\n";
-	stream << "Content-Disposition: form-data; name=text\r\n\r\n";
-	stream << valid::generatePassword<Interface>(16) << "\r\n";
+	stream << "--" << boundary << "\r\n";
+	stream << "Content-Disposition: form-data; name=text\r\n\r\n";
+	stream << valid::generatePassword<Interface>(16) << "\r\n";
+
+	stream << "--" << boundary << "\r\n" << "Content-Disposition: form-data; name=arr[0]; dummy=\"dummy\"; val=\"test\r\n\r\nvalue1\r\n";
+	stream << "--" << boundary << "\r\n" << "Content-Disposition: form-data; name=arr[1][]\r\n\r\nvalue2\r\n";
+	stream << "--" << boundary << "\r\n" << "Content-Disposition: form-data; name=arr[1][]\r\n\r\nvalue3\r\n";
+	stream << "--" << boundary << "\r\n" << "Content-Disposition: form-data; name=dict[key]\r\n\r\nvalue4\r\n";
+	stream << "--" << boundary << "\r\n" << "Content-Disposition: form-data; name=dict[key]\r\n\r\nvalue5\r\n";
+
+	auto cborData = filesystem::readIntoMemory<Interface>(cborFile);
+	auto jsonData = filesystem::readIntoMemory<Interface>(jsonFile);
+
+	stream << "--" << boundary << "\r\n";
+	stream << "Content-Disposition: form-data; name=\"data\"; filename=\"" << filepath::lastComponent(cborFile) << "\"; "
+			"size=" << cborData.size() << "\r\n";
+	stream << "Content-Type: application/cbor\r\n";
+	stream << "Content-Transfer-Encoding: binary\r\n\r\n";
+	data.insert(data.end(), cborData.begin(), cborData.end());
+	stream << "\r\n";
+
+	stream << "--" << boundary << "\r\n";
+	stream << "Content-Disposition: form-data; name=\"file\"; filename=\"" << filepath::lastComponent(jsonFile) << "\"; "
+			"size=" << jsonData.size() << "\r\n";
+	stream << "Content-Type: application/json\r\n";
+	stream << "Content-Transfer-Encoding: binary\r\n\r\n";
+	data.insert(data.end(), jsonData.begin(), jsonData.end());
+	stream << "\r\n";
+
+	stream << "--" << boundary << "--\r\n";
+
+	return data;
+}
+static Bytes makeFileMultipartRequest2(StringView boundary) {
+	Bytes data;
+
+	auto writer = [&] (StringView str) {
+		data.insert(data.end(), (const uint8_t *)str.data(), (const uint8_t *)str.data() + str.size());
+	};
+
+	Callback<void(StringView)> stream(writer);
+
+	auto cborFile = filesystem::currentDir<Interface>("data/app.cbor");
+	auto jsonFile = filesystem::currentDir<Interface>("data/app.json");
+	auto cborData = filesystem::readIntoMemory<Interface>(cborFile);
+	auto jsonData = filesystem::readIntoMemory<Interface>(jsonFile);
+
+	stream << "--" << boundary << "\r\n";
+	stream << "Content-Disposition: form-data; name=\"binaryFile\"; filename=\"" << filepath::lastComponent(cborFile) << "\"; "
+			"size=" << cborData.size() << "\r\n";
+	stream << "Content-Type: application/cbor\r\n";
+	stream << "Content-Transfer-Encoding: binary\r\n\r\n";
+	data.insert(data.end(), cborData.begin(), cborData.end());
+	stream << "\r\n";
+
+	stream << "--" << boundary << "\r\n";
+	stream << "Content-Disposition: form-data; name=\"textFile\"; filename=\"" << filepath::lastComponent(jsonFile) << "\"; "
+			"size=" << jsonData.size() << "\r\n";
+	stream << "Content-Type: application/json\r\n";
+	stream << "Content-Transfer-Encoding: binary\r\n\r\n";
+	data.insert(data.end(), jsonData.begin(), jsonData.end());
+	stream << "\r\n";
+
+	stream << "--" << boundary << "--\r\n";
+
+	return data;
+}
+
+static Bytes performFileQuery(bool auth, NetworkHandle::Method m, StringView url, BytesView data = BytesView(), StringView contentType = StringView()) {
+	Bytes out;
+
+	NetworkHandle h;
+	h.init(m, url);
+	if (!data.empty()) {
+		h.setSendData(data, contentType);
+	}
+
+	h.setReceiveCallback([&] (char *data, size_t size) {
+		auto sourceSize = out.size();
+		out.resize(sourceSize + size);
+		memcpy(out.data() + sourceSize, data, size);
+		return size;
+	});
+
+	auto cookieFile = filesystem::currentDir<Interface>("web/root/cookie.cookie");
+	h.setCookieFile(cookieFile);
+
+	if (auth && !s_AuthName.empty()) {
+		h.setAuthority(s_AuthName, s_AuthPassword);
+	}
+	h.perform();
+
+	return out;
+}
+
+static Bytes performFileQuery(NetworkHandle::Method m, StringView url, const Value & data) {
+	Bytes out;
+
+	NetworkHandle h;
+	h.init(m, url);
+	if (!data.empty()) {
+		h.setSendData(data);
+	}
+
+	h.setCookieFile(filesystem::currentDir<Interface>("web/root/cookie.cookie"));
+
+	h.setReceiveCallback([&] (char *data, size_t size) {
+		auto sourceSize = out.size();
+		out.resize(sourceSize + size);
+		memcpy(out.data() + sourceSize, data, size);
+		return size;
+	});
+	h.perform();
+
+	return out;
+}
+
+static Value performQuery(NetworkHandle::Method m, StringView url, BytesView data = BytesView(), StringView contentType = StringView()) {
+	StringStream out;
+
+	NetworkHandle h;
+	h.init(m, url);
+	if (!data.empty()) {
+		h.setSendData(data, contentType);
+	}
+
+	h.setReceiveCallback([&] (char *data, size_t size) {
+		out << StringView(data, size);
+		return size;
+	});
+	h.perform();
+
+	return data::read<Interface>(out.str());
+}
+
+static Value performQuery(NetworkHandle::Method m, StringView url, const Value &data) {
+	StringStream out;
+
+	NetworkHandle h;
+	h.init(m, url);
+	if (!data.empty()) {
+		h.setSendData(data);
+	}
+
+	h.setReceiveCallback([&] (char *data, size_t size) {
+		out << StringView(data, size);
+		return size;
+	});
+	h.perform();
+
+	return data::read<Interface>(out.str());
+}
+
+struct UnixWebTest : Test {
+	UnixWebTest() : Test("UnixWebTest") { }
+
+	bool perfromIndexTest(StringView rootPath) {
+		auto d = base16::encode<Interface>(valid::makeRandomBytes<Interface>(8));
+
+		StringStream out;
+
+		NetworkHandle h;
+		h.init(NetworkHandle::Method::Get, toString("http://localhost:23001/index.html?data=", d));
+		h.setReceiveCallback([&] (char *data, size_t size) {
+			out << StringView(data, size);
+			return size;
+		});
+		h.perform();
+
+		auto fileData = filesystem::readIntoMemory<Interface>(filepath::merge<Interface>(rootPath, "index.html"));
+
+		if (BytesView(fileData) == BytesView(out.str())) {
+			return true;
+		}
+
+		return false;
+	}
+
+	static size_t countOccurrences(StringView str, StringView sub) {
+		size_t ret = 0;
+		while (!str.empty()) {
+			str.skipUntilString(sub);
+			if (str.starts_with(sub)) {
+				++ ret;
+				str += sub.size();
+			}
+		}
+		return ret;
+	}
+
+	static int connectLocal(uint16_t port = 23001) {
+		int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0) {
+			return -1;
+		}
+
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(port);
+		addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+		if (::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+			::close(fd);
+			return -1;
+		}
+		return fd;
+	}
+
+	static String readAll(int fd) {
+		StringStream out;
+		char buf[1_KiB];
+		auto n = ::recv(fd, buf, sizeof(buf), 0);
+		while (n > 0) {
+			out << StringView(buf, n);
+			n = ::recv(fd, buf, sizeof(buf), 0);
+		}
+		::close(fd);
+		return out.str();
+	}
+
+	// send raw request over the new connection and read until the server closes it,
+	// empty result means, that request was not sent
+	static String performRawRequest(StringView request, uint16_t port = 23001) {
+		auto fd = connectLocal(port);
+		if (fd < 0) {
+			return String();
+		}
+
+		if (::send(fd, request.data(), request.size(), 0) != ssize_t(request.size())) {
+			::close(fd);
+			return String();
+		}
+
+		return readAll(fd);
+	}
+
+	// separate server for the options, that should not affect the other tests,
+	// host serves static files from rootPath without database
+	static SharedRc<web::UnixRoot> makeServer(web::UnixRoot::Config &&cfg, StringView rootPath, bool withSlowHandler = false) {
+		web::Vector<web::HostComponentInfo> components;
+		if (withSlowHandler) {
+			// GET /slow/<ms> blocks handler for the given time
+			components.emplace_back(web::HostComponentInfo{
+				.name = "TestComonent",
+				.version = "0.1",
+				.file = StringView(),
+				.symbol = "CreateTestSlowComponent",
+			});
+		}
+
+		cfg.hosts.emplace_back(web::UnixHostConfig{
+			.hastname = "localhost",
+			.admin = "admin@stappler.org",
+			.root = rootPath,
+			.components = move(components),
+		});
+
+		auto root = web::UnixRoot::create(move(cfg));
+
+		::sleep(1);
+
+		return root;
+	}
+
+	static void stopServer(SharedRc<web::UnixRoot> &root) {
+		if (root) {
+			root->cancel();
+			root = nullptr;
+		}
+	}
+
+	// decode response body with chunked transfer coding, returns false if framing is malformed
+	static bool decodeChunked(StringView body, String &out) {
+		while (!body.empty()) {
+			auto sizeLine = body.readUntilString("\r\n");
+			if (!body.starts_with("\r\n")) {
+				return false;
+			}
+			body += 2;
+
+			// chunk extensions are stopped by strtoull
+			auto size = size_t(::strtoull(sizeLine.str<Interface>().data(), nullptr, 16));
+			if (size == 0) {
+				return true;
+			}
+
+			if (body.size() < size + 2) {
+				return false;
+			}
+
+			out.append(body.data(), size);
+			body += size;
+			if (!body.starts_with("\r\n")) {
+				return false;
+			}
+			body += 2;
+		}
+		return false;
+	}
+
+	bool performPipeliningTest(StringView rootPath, uint16_t port = 23001) {
+		auto fileData = filesystem::readIntoMemory<Interface>(filepath::merge<Interface>(rootPath, "index.html"));
+
+		// both requests in one packet, server should answer them in order over the same connection
+		auto result = performRawRequest("GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n"
+				"GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n", port);
+		return countOccurrences(result, "HTTP/1.1 200 OK\r\n") == 2
+				&& countOccurrences(result, BytesView(fileData).toStringView()) == 2
+				&& countOccurrences(result, "connection: keep-alive\r\n") == 1;
+	}
+
+	bool performChunkedTest() {
+		// echoed body makes the response larger than the streaming threshold, so it's sent with chunked coding
+		String data;
+		for (size_t i = 0; data.size() < 100_KiB; ++ i) {
+			data.append(toString("chunk", i, " "));
+		}
+
+		auto result = performRawRequest(toString("POST /map/files HTTP/1.1\r\nHost: localhost\r\nContent-Type: text/plain\r\n"
+				"Content-Length: ", data.size(), "\r\nConnection: close\r\n\r\n", data));
+
+		StringView r(result);
+		auto headers = r.readUntilString("\r\n\r\n");
+		r += 4;
+
+		String body;
+		if (!headers.starts_with("HTTP/1.1 200 OK\r\n") || countOccurrences(headers, "transfer-encoding: chunked") != 1
+				|| countOccurrences(headers, "content-length:") != 0 || !decodeChunked(r, body)) {
+			return false;
+		}
+
+		return data::read<Interface>(body).getString("body") == data;
+	}
+
+	// number of the process threads, that are bound to the single CPU
+	static size_t countPinnedThreads() {
+		size_t ret = 0;
+		auto dir = ::opendir("/proc/self/task");
+		if (!dir) {
+			return ret;
+		}
+
+		while (auto entry = ::readdir(dir)) {
+			auto tid = ::atoi(entry->d_name);
+			if (tid <= 0) {
+				continue;
+			}
+
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			if (::sched_getaffinity(tid, sizeof(set), &set) == 0 && CPU_COUNT(&set) == 1) {
+				++ ret;
+			}
+		}
+		::closedir(dir);
+		return ret;
+	}
+
+	bool performCompressionTest() {
+		String data;
+		for (size_t i = 0; data.size() < 4_KiB; ++ i) {
+			data.append(toString("compressible", i, " "));
+		}
+
+		auto makeRequest = [&] (StringView acceptEncoding) {
+			return toString("POST /map/files HTTP/1.1\r\nHost: localhost\r\nContent-Type: text/plain\r\n", acceptEncoding,
+					"Content-Length: ", data.size(), "\r\nConnection: close\r\n\r\n", data);
+		};
+
+		// brotli is selected with Accept-Encoding, the body should be decoded into the echoed data
+		auto result = performRawRequest(makeRequest("Accept-Encoding: gzip;q=0.5, br\r\n"));
+
+		StringView r(result);
+		auto headers = r.readUntilString("\r\n\r\n");
+		r += 4;
+
+		if (!headers.starts_with("HTTP/1.1 200 OK\r\n") || countOccurrences(headers, "content-encoding: br") != 1
+				|| countOccurrences(headers, "vary: Accept-Encoding") != 1) {
+			return false;
+		}
+
+		Bytes decoded(256_KiB);
+		size_t decodedSize = decoded.size();
+		if (BrotliDecoderDecompress(r.size(), (const uint8_t *)r.data(), &decodedSize, decoded.data()) != BROTLI_DECODER_RESULT_SUCCESS
+				|| data::read<Interface>(BytesView(decoded.data(), decodedSize).toStringView()).getString("body") != data) {
+			return false;
+		}
+
+		// encoding, that is not supported by the server, gives identity response, that still varies by Accept-Encoding;
+		// malformed q-value is treated as q=0
+		for (auto accept : { StringView("Accept-Encoding: gzip\r\n"), StringView("Accept-Encoding: br;q=abc\r\n") }) {
+			result = performRawRequest(makeRequest(accept));
+
+			r = StringView(result);
+			headers = r.readUntilString("\r\n\r\n");
+			r += 4;
+
+			if (!headers.starts_with("HTTP/1.1 200 OK\r\n") || countOccurrences(headers, "content-encoding:") != 0
+					|| countOccurrences(headers, "vary: Accept-Encoding") != 1 || data::read<Interface>(r).getString("body") != data) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool performReusePortTest(StringView rootPath) {
+		web::UnixRoot::Config cfg;
+		cfg.listen = StringView("127.0.0.1:23003");
+		cfg.nworkers = 2;
+		cfg.reusePort = true;
+		cfg.pinWorkers = true;
+
+		auto pinned = countPinnedThreads();
+		auto root = makeServer(move(cfg), rootPath);
+		if (!root) {
+			return false;
+		}
+
+		// kernel distributes connections between the workers' sockets, every one should be served
+		bool success = true;
+		for (size_t i = 0; i < 8; ++ i) {
+			auto result = performRawRequest("GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n", 23003);
+			if (!StringView(result).starts_with("HTTP/1.1 200 OK\r\n")) {
+				success = false;
+			}
+		}
+
+		// both workers are pinned to their CPUs
+		if (countPinnedThreads() < pinned + 2) {
+			success = false;
+		}
+
+		stopServer(root);
+		return success;
+	}
+
+	bool performRangeTest(StringView rootPath, uint16_t port = 23001) {
+		auto fileData = filesystem::readIntoMemory<Interface>(filepath::merge<Interface>(rootPath, "index.html"));
+		if (fileData.size() < 16) {
+			return false;
+		}
+
+		// single range, then two ranges, that should be sent as multipart/byteranges
+		auto result = performRawRequest("GET /index.html HTTP/1.1\r\nHost: localhost\r\nRange: bytes=2-9\r\n\r\n"
+				"GET /index.html HTTP/1.1\r\nHost: localhost\r\nRange: bytes=0-3, -4\r\nConnection: close\r\n\r\n", port);
+
+		auto size = fileData.size();
+		auto data = BytesView(fileData).toStringView();
+		return countOccurrences(result, "HTTP/1.1 206 Partial Content\r\n") == 2
+				&& countOccurrences(result, toString("content-range: bytes 2-9/", size, "\r\n")) == 1
+				&& countOccurrences(result, "content-type: multipart/byteranges; boundary=") == 1
+				&& countOccurrences(result, toString("Content-Range: bytes 0-3/", size, "\r\n\r\n", data.sub(0, 4))) == 1
+				&& countOccurrences(result, toString("Content-Range: bytes ", size - 4, "-", size - 1, "/", size, "\r\n\r\n",
+						data.sub(size - 4, 4))) == 1;
+	}
+
+	bool performUringTest(StringView rootPath) {
+		web::UnixRoot::Config cfg;
+		cfg.listen = StringView("127.0.0.1:23004");
+		cfg.engine = web::UnixEngine::Uring;
+
+		auto root = makeServer(move(cfg), rootPath);
+		if (!root) {
+			return false;
+		}
+
+		// workers fall back to epoll, when io_uring is not supported by the kernel
+		if (root->getEngine() != web::UnixEngine::Uring) {
+			std::cout << "io_uring is not available, io_uring test skipped\n";
+			stopServer(root);
+			return true;
+		}
+
+		// io_uring engine should give the same responses, as epoll
+		bool success = performPipeliningTest(rootPath, 23004) && performRangeTest(rootPath, 23004)
+				&& root->getEngine() == web::UnixEngine::Uring;
+
+		stopServer(root);
+		return success;
+	}
+
+	bool performStaticEncodingTest(StringView rootPath) {
+		String fileData;
+		for (size_t i = 0; fileData.size() < 4_KiB; ++ i) {
+			fileData.append(toString("<p>static content ", i, "</p>\n"));
+		}
+
+		// sidecar is served as is, so it does not need to be a valid brotli stream,
+		// it should be written after the file, stale sidecars are ignored
+		StringView sidecarData("precompressed sidecar content");
+		filesystem::write(filepath::merge<Interface>(rootPath, "static.html"), fileData);
+		filesystem::write(filepath::merge<Interface>(rootPath, "static.html.br"), sidecarData);
+		filesystem::write(filepath::merge<Interface>(rootPath, "hot.html"), fileData);
+
+		web::UnixRoot::Config cfg;
+		cfg.listen = StringView("127.0.0.1:23006");
+		cfg.staticEncoding = true;
+
+		auto root = makeServer(move(cfg), rootPath);
+		if (!root) {
+			return false;
+		}
+
+		// returns response body, result holds the whole response
+		auto request = [] (StringView path, StringView acceptEncoding, String &result) {
+			result = performRawRequest(toString("GET ", path, " HTTP/1.1\r\nHost: localhost\r\n", acceptEncoding,
+					"Connection: close\r\n\r\n"), 23006);
+			StringView r(result);
+			r.skipUntilString("\r\n\r\n");
+			r += 4;
+			return r;
+		};
+
+		bool success = true;
+
+		// sidecar is selected with Accept-Encoding
+		String result;
+		auto body = request("/static.html", "Accept-Encoding: br\r\n", result);
+		if (!StringView(result).starts_with("HTTP/1.1 200 OK\r\n") || countOccurrences(result, "content-encoding: br\r\n") != 1
+				|| countOccurrences(result, "vary: Accept-Encoding\r\n") != 1 || body != sidecarData) {
+			success = false;
+		}
+
+		// without Accept-Encoding original file is served
+		body = request("/static.html", StringView(), result);
+		if (!StringView(result).starts_with("HTTP/1.1 200 OK\r\n") || countOccurrences(result, "content-encoding:") != 0
+				|| countOccurrences(result, "vary: Accept-Encoding\r\n") != 1 || body != fileData) {
+			success = false;
+		}
+
+		// file without sidecar is compressed in background, when it becomes hot,
+		// then it should be served from the memory cache
+		bool compressed = false;
+		for (size_t i = 0; i < 30 && !compressed && success; ++ i) {
+			body = request("/hot.html", "Accept-Encoding: br\r\n", result);
+			if (!StringView(result).starts_with("HTTP/1.1 200 OK\r\n")) {
+				success = false;
+			} else if (countOccurrences(result, "content-encoding: br\r\n") == 1) {
+				Bytes decoded(64_KiB);
+				size_t decodedSize = decoded.size();
+				compressed = true;
+				if (BrotliDecoderDecompress(body.size(), (const uint8_t *)body.data(), &decodedSize, decoded.data())
+							!= BROTLI_DECODER_RESULT_SUCCESS || BytesView(decoded.data(), decodedSize) != BytesView(fileData)) {
+					success = false;
+				}
+			} else if (body != fileData) {
+				success = false;
+			} else {
+				::usleep(100'000);
+			}
+		}
+
+		stopServer(root);
+		return success && compressed;
+	}
+
+	bool performFileCacheTest(StringView rootPath) {
+		auto pathA = filepath::merge<Interface>(rootPath, "cache-a.txt");
+		auto pathB = filepath::merge<Interface>(rootPath, "cache-b.txt");
+		auto pathC = filepath::merge<Interface>(rootPath, "cache-c.txt");
+		filesystem::write(pathA, StringView("a"));
+		filesystem::write(pathB, StringView("b"));
+		filesystem::write(pathC, StringView("c"));
+
+		bool success = true;
+
+		{
+			web::UnixFileCache cache;
+			cache.init(2);
+
+			// references are kept until the end, so dropped entries can not be reallocated at the same address
+			auto a = cache.open(pathA);
+			auto b = cache.open(pathB);
+
+			// hit returns the same entry and moves it to the front
+			auto a2 = cache.open(pathA);
+			if (!a || !b || a2 != a) {
+				success = false;
+			}
+
+			// least recently used entry is evicted
+			auto c = cache.open(pathC);
+			auto a3 = cache.open(pathA);
+			auto b2 = cache.open(pathB);
+			if (!c || a3 != a || b2 == b) {
+				success = false;
+			}
+
+			// modified file is dropped with inotify event, next open loads new stat
+			if (cache.getNotify() >= 0) {
+				filesystem::write(pathA, StringView("modified"));
+				cache.update();
+
+				auto a4 = cache.open(pathA);
+				if (!a4 || a4 == a || a4->stat.size != 8) {
+					success = false;
+				}
+				if (a4) { a4->release(); }
+			}
+
+			for (auto &it : { a, b, a2, c, a3, b2 }) {
+				if (it) { it->release(); }
+			}
+		}
+
+		// file, that was edited on disk, should be served fresh, worker drops it, when inotify event is processed
+		auto request = [] (StringView path) {
+			return performRawRequest(toString("GET ", path, " HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n"));
+		};
+
+		filesystem::write(pathB, StringView("initial content"));
+		for (size_t i = 0; i < 2; ++ i) {
+			if (!StringView(request("/cache-b.txt")).ends_with("\r\n\r\ninitial content")) {
+				success = false;
+			}
+		}
+
+		filesystem::write(pathB, StringView("content, that was edited on disk"));
+
+		bool updated = false;
+		for (size_t i = 0; i < 20 && !updated; ++ i) {
+			if (StringView(request("/cache-b.txt")).ends_with("\r\n\r\ncontent, that was edited on disk")) {
+				updated = true;
+			} else {
+				::usleep(100'000);
+			}
+		}
+
+		filesystem::remove(pathA);
+		filesystem::remove(pathB);
+		filesystem::remove(pathC);
+
+		return success && updated;
+	}
+
+	bool performTimerTest(web::UnixRoot *root) {
+		auto interval = TimeInterval::milliseconds(300);
+
+		web::Host host;
+		root->foreachHost([&] (web::Host &it) {
+			host = it;
+		});
+
+		// task can be performed after the test, when timer is broken, so it should not reference the stack
+		static std::atomic<uint64_t> executed = 0;
+		auto task = web::AsyncTask::prepare(host.getThreadPool(), [&] (web::AsyncTask &task) {
+			task.addExecuteFn([] (const web::AsyncTask &) {
+				executed = Time::now().toMicros();
+				return true;
+			});
+		});
+
+		auto scheduled = Time::now();
+		auto heartbeats = web::s_testHeartbeats.load();
+		if (!task || !root->scheduleTask(host, task, interval)) {
+			return false;
+		}
+
+		// task should be performed once the interval is passed, within a few ticks of the wheel
+		for (size_t i = 0; i < 30 && executed == 0; ++ i) {
+			::usleep(100'000);
+		}
+
+		if (executed == 0 || Time::microseconds(executed) - scheduled < interval) {
+			return false;
+		}
+
+		// component's heartbeat is called with the default interval
+		::sleep(3);
+		return web::s_testHeartbeats.load() >= heartbeats + 2;
+	}
+
+	bool performDeadlineTest(StringView rootPath) {
+		web::UnixRoot::Config cfg;
+		cfg.listen = StringView("127.0.0.1:23005");
+		cfg.requestHeaderTimeout = TimeInterval::milliseconds(300);
+		cfg.keepAliveTimeout = TimeInterval::milliseconds(300);
+
+		auto root = makeServer(move(cfg), rootPath);
+		if (!root) {
+			return false;
+		}
+
+		// returns time, until server closed connection without response, or zero
+		auto waitForClose = [] (int fd) -> TimeInterval {
+			struct timeval tv = { 3, 0 };
+			::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+			auto start = Time::now();
+			char buf[1_KiB];
+			auto n = ::recv(fd, buf, sizeof(buf), 0);
+			::close(fd);
+			return n == 0 ? Time::now() - start : TimeInterval();
+		};
+
+		bool success = true;
+
+		// slow client: incomplete headers are dropped after the header timeout
+		auto fd = connectLocal(23005);
+		StringView partial("GET /index.html HTTP/1.1\r\nHost: loc");
+		if (fd < 0 || ::send(fd, partial.data(), partial.size(), 0) != ssize_t(partial.size())) {
+			success = false;
+		} else {
+			auto t = waitForClose(fd);
+			if (t < TimeInterval::milliseconds(250) || t > 2_sec) {
+				success = false;
+			}
+		}
+
+		// persistent connection is closed after the keep-alive timeout
+		fd = connectLocal(23005);
+		StringView request("GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n");
+		if (fd < 0 || ::send(fd, request.data(), request.size(), 0) != ssize_t(request.size())) {
+			success = false;
+		} else {
+			StringView status("HTTP/1.1 200 OK\r\n");
+			char buf[32];
+			if (::recv(fd, buf, status.size(), MSG_WAITALL) != ssize_t(status.size()) || StringView(buf, status.size()) != status) {
+				::close(fd);
+				success = false;
+			} else {
+				// rest of the response is read until server closes the idle connection
+				struct timeval tv = { 3, 0 };
+				::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+				auto start = Time::now();
+				readAll(fd);
+				if (Time::now() - start > 2_sec) {
+					success = false;
+				}
+			}
+		}
+
+		stopServer(root);
+		return success;
+	}
+
+	bool performSpliceTest() {
+		// raw upload over the splice threshold, body is not saved, so it should be moved from the socket into the file
+		String data;
+		for (size_t i = 0; data.size() < 256_KiB; ++ i) {
+			data.append(toString("spliced upload ", i, "\n"));
+		}
+
+		auto result = performRawRequest(toString("POST /map/upload HTTP/1.1\r\nHost: localhost\r\n"
+				"Content-Type: application/octet-stream\r\nContent-Length: ", data.size(), "\r\nConnection: close\r\n\r\n", data));
+
+		StringView r(result);
+		if (!r.starts_with("HTTP/1.1 200 OK\r\n")) {
+			return false;
+		}
+
+		r.skipUntilString("\r\n\r\n");
+		r += 4;
+
+		auto files = data::read<Interface>(r).getValue("files");
+		return files.size() == 1 && files.getValue(0).getInteger("size") == int64_t(data.size())
+				&& files.getValue(0).getInteger("hash") == int64_t(std::hash<std::string_view>()(std::string_view(data.data(), data.size())));
+	}
+
+	// sends request over the new connection without waiting for the response
+	static int sendRequest(StringView request, uint16_t port) {
+		auto fd = connectLocal(port);
+		if (fd >= 0 && ::send(fd, request.data(), request.size(), 0) != ssize_t(request.size())) {
+			::close(fd);
+			return -1;
+		}
+		return fd;
+	}
+
+	bool performOffloadTest(StringView rootPath) {
+		web::UnixRoot::Config cfg;
+		cfg.listen = StringView("127.0.0.1:23007");
+		cfg.nworkers = 2;
+		cfg.handlerThreads = 2;
+
+		auto root = makeServer(move(cfg), rootPath, true);
+		if (!root) {
+			return false;
+		}
+
+		// slow requests occupy handler threads, I/O workers should stay free for the others
+		StringView slowRequest("GET /slow/1000 HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+		int slow[2] = { sendRequest(slowRequest, 23007), sendRequest(slowRequest, 23007) };
+		::usleep(100'000);
+
+		bool success = slow[0] >= 0 && slow[1] >= 0;
+
+		auto start = Time::now();
+		auto result = performRawRequest("GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n", 23007);
+		if (!StringView(result).starts_with("HTTP/1.1 200 OK\r\n") || Time::now() - start > TimeInterval::milliseconds(500)) {
+			success = false;
+		}
+
+		for (auto &fd : slow) {
+			if (fd >= 0) {
+				auto slowResult = readAll(fd);
+				if (!StringView(slowResult).starts_with("HTTP/1.1 200 OK\r\n") || countOccurrences(slowResult, "\"slept\"") != 1) {
+					success = false;
+				}
+			}
+		}
+
+		stopServer(root);
+		return success;
+	}
+
+	bool performAdmissionTest(StringView rootPath) {
+		web::UnixRoot::Config cfg;
+		cfg.listen = StringView("127.0.0.1:23008");
+		cfg.nworkers = 2;
+		cfg.handlerThreads = 4;
+		cfg.maxWorkerRequests = 1;
+
+		auto root = makeServer(move(cfg), rootPath, true);
+		if (!root) {
+			return false;
+		}
+
+		// two workers can have only two requests in flight, the rest should be shed without processing
+		StringView slowRequest("GET /slow/500 HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+		int fds[6];
+		for (auto &fd : fds) {
+			fd = sendRequest(slowRequest, 23008);
+		}
+
+		bool success = true;
+		size_t served = 0;
+		size_t rejected = 0;
+		for (auto &fd : fds) {
+			if (fd < 0) {
+				success = false;
+				continue;
+			}
+
+			auto result = readAll(fd);
+			if (StringView(result).starts_with("HTTP/1.1 200 OK\r\n")) {
+				++ served;
+			} else if (StringView(result).starts_with("HTTP/1.1 503 ")) {
+				if (countOccurrences(result, "retry-after: 1\r\n") == 1) {
+					++ rejected;
+				} else {
+					success = false;
+				}
+			} else {
+				success = false;
+			}
+		}
+
+		// server accepts requests again, when load is gone
+		auto result = performRawRequest(slowRequest, 23008);
+		if (!StringView(result).starts_with("HTTP/1.1 200 OK\r\n")) {
+			success = false;
+		}
+
+		stopServer(root);
+		return success && served > 0 && rejected > 0;
+	}
+
+	// fd, connected to the listener on unix socket or IPv6 loopback
+	static int connectAddress(const struct sockaddr *addr, socklen_t len) {
+		int fd = ::socket(addr->sa_family, SOCK_STREAM, 0);
+		if (fd < 0) {
+			return -1;
+		}
+
+		if (::connect(fd, addr, len) != 0) {
+			::close(fd);
+			return -1;
+		}
+		return fd;
+	}
+
+	// IPv6 can be disabled in the test environment
+	static bool isIpv6LoopbackAvailable() {
+		int fd = ::socket(AF_INET6, SOCK_STREAM, 0);
+		if (fd < 0) {
+			return false;
+		}
+
+		struct sockaddr_in6 addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin6_family = AF_INET6;
+		addr.sin6_addr = in6addr_loopback;
+
+		bool ret = ::bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+		::close(fd);
+		return ret;
+	}
+
+	bool performListenersTest(StringView rootPath) {
+		auto socketPath = filepath::merge<Interface>(rootPath, "web.sock");
+		auto socketAddress = toString("unix:", socketPath);
+		auto hasIpv6 = isIpv6LoopbackAvailable();
+
+		web::UnixRoot::Config cfg;
+		cfg.listeners.emplace_back(web::UnixListenerConfig{
+			.address = StringView("127.0.0.1:23009"),
+		});
+		cfg.listeners.emplace_back(web::UnixListenerConfig{
+			.address = StringView(socketAddress),
+		});
+		if (hasIpv6) {
+			cfg.listeners.emplace_back(web::UnixListenerConfig{
+				.address = StringView("[::1]:23009"),
+			});
+		} else {
+			std::cout << "IPv6 loopback is not available, IPv6 listener test skipped\n";
+		}
+
+		auto root = makeServer(move(cfg), rootPath);
+		if (!root) {
+			return false;
+		}
+
+		auto isServed = [] (int fd) {
+			StringView request("GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+			if (fd < 0) {
+				return false;
+			}
+			if (::send(fd, request.data(), request.size(), 0) != ssize_t(request.size())) {
+				::close(fd);
+				return false;
+			}
+			return StringView(readAll(fd)).starts_with("HTTP/1.1 200 OK\r\n");
+		};
+
+		bool success = isServed(connectLocal(23009));
+
+		struct sockaddr_un unixAddr;
+		memset(&unixAddr, 0, sizeof(unixAddr));
+		unixAddr.sun_family = AF_UNIX;
+		memcpy(unixAddr.sun_path, socketPath.data(), std::min(socketPath.size(), sizeof(unixAddr.sun_path) - 1));
+		if (!isServed(connectAddress((struct sockaddr *)&unixAddr, sizeof(unixAddr)))) {
+			success = false;
+		}
+
+		if (hasIpv6) {
+			struct sockaddr_in6 addr;
+			memset(&addr, 0, sizeof(addr));
+			addr.sin6_family = AF_INET6;
+			addr.sin6_port = htons(23009);
+			addr.sin6_addr = in6addr_loopback;
+			if (!isServed(connectAddress((struct sockaddr *)&addr, sizeof(addr)))) {
+				success = false;
+			}
+		}
+
+		stopServer(root);
+		return success;
+	}
+
+	bool performContinueTest() {
+		auto fd = connectLocal();
+		if (fd < 0) {
+			return false;
+		}
+
+		// body should be requested with 100 Continue only after the headers was accepted
+		auto headers = toString("POST /map/urlencoded HTTP/1.1\r\nHost: localhost\r\n"
+				"Content-Type: application/x-www-form-urlencoded\r\nContent-Length: ", TEST_URLENCODED.size(), "\r\n"
+				"Expect: 100-continue\r\nConnection: close\r\n\r\n");
+		if (::send(fd, headers.data(), headers.size(), 0) != ssize_t(headers.size())) {
+			::close(fd);
+			return false;
+		}
+
+		StringView interim("HTTP/1.1 100 Continue\r\n\r\n");
+		char buf[1_KiB];
+		auto n = ::recv(fd, buf, interim.size(), MSG_WAITALL);
+		if (n != ssize_t(interim.size()) || StringView(buf, n) != interim) {
+			::close(fd);
+			return false;
+		}
+
+		if (::send(fd, TEST_URLENCODED.data(), TEST_URLENCODED.size(), 0) != ssize_t(TEST_URLENCODED.size())) {
+			::close(fd);
+			return false;
+		}
+
+		if (!StringView(readAll(fd)).starts_with("HTTP/1.1 200 OK\r\n")) {
+			return false;
+		}
+
+		fd = connectLocal();
+		if (fd < 0) {
+			return false;
+		}
+
+		// unknown expectation is rejected without reading the body
+		StringView rejected("POST /map/urlencoded HTTP/1.1\r\nHost: localhost\r\n"
+				"Content-Type: application/x-www-form-urlencoded\r\nContent-Length: 1024\r\n"
+				"Expect: something-else\r\n\r\n");
+		if (::send(fd, rejected.data(), rejected.size(), 0) != ssize_t(rejected.size())) {
+			::close(fd);
+			return false;
+		}
+
+		if (!StringView(readAll(fd)).starts_with("HTTP/1.1 417 Expectation Failed\r\n")) {
+			return false;
+		}
+
+		fd = connectLocal();
+		if (fd < 0) {
+			return false;
+		}
+
+		// raw file over the handler's maxFileSize is rejected from the headers, client should not be asked for the body
+		StringView tooLarge("POST /map/upload HTTP/1.1\r\nHost: localhost\r\n"
+				"Content-Type: application/octet-stream\r\nContent-Length: 2097152\r\n"
+				"Expect: 100-continue\r\nConnection: close\r\n\r\n");
+		if (::send(fd, tooLarge.data(), tooLarge.size(), 0) != ssize_t(tooLarge.size())) {
+			::close(fd);
+			return false;
+		}
+
+		struct timeval tv = { 3, 0 };
+		::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+		auto result = readAll(fd);
+		return StringView(result).starts_with("HTTP/1.1 413 ") && countOccurrences(result, "100 Continue") == 0;
+	}
+
+	bool performReloadTest(web::UnixRoot *root, StringView rootPath) {
+		// idle connection of the previous configuration
+		auto fd = connectLocal();
+		if (fd < 0) {
+			return false;
+		}
+
+		web::Vector<web::UnixHostConfig> hosts;
+		hosts.emplace_back(web::UnixHostConfig{
+			.hastname = "localhost",
+			.admin = "admin@stappler.org",
+			.root = rootPath,
+		});
+
+		if (!root->reload(move(hosts))) {
+			::close(fd);
+			return false;
+		}
+
+		// previous connection is still served, but without keep-alive
+		StringView request("GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n");
+		if (::send(fd, request.data(), request.size(), 0) != ssize_t(request.size())) {
+			::close(fd);
+			return false;
+		}
+
+		if (!StringView(readAll(fd)).starts_with("HTTP/1.1 200 OK\r\n")) {
+			return false;
+		}
+
+		fd = connectLocal();
+		if (fd < 0) {
+			return false;
+		}
+
+		StringView next("GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+		if (::send(fd, next.data(), next.size(), 0) != ssize_t(next.size())) {
+			::close(fd);
+			return false;
+		}
+
+		return StringView(readAll(fd)).starts_with("HTTP/1.1 200 OK\r\n");
+	}
+
+#if UNIX_WEB_TEST_TLS
+	// self-signed certificate for the TLS listener
+	static bool makeTlsCertificate(StringView certPath, StringView keyPath) {
+		auto key = EVP_PKEY_Q_keygen(nullptr, nullptr, "EC", "P-256");
+		auto cert = X509_new();
+		if (!key || !cert) {
+			EVP_PKEY_free(key);
+			X509_free(cert);
+			return false;
+		}
+
+		ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+		X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+		X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+		X509_set_pubkey(cert, key);
+
+		auto name = X509_get_subject_name(cert);
+		X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)"localhost", -1, -1, 0);
+		X509_set_issuer_name(cert, name);
+
+		bool success = X509_sign(cert, key, EVP_sha256()) > 0;
+		if (success) {
+			auto certFile = ::fopen(certPath.data(), "w");
+			auto keyFile = ::fopen(keyPath.data(), "w");
+			success = certFile && keyFile && PEM_write_X509(certFile, cert)
+					&& PEM_write_PrivateKey(keyFile, key, nullptr, nullptr, 0, nullptr, nullptr);
+			if (certFile) { ::fclose(certFile); }
+			if (keyFile) { ::fclose(keyFile); }
+		}
+
+		X509_free(cert);
+		EVP_PKEY_free(key);
+		return success;
+	}
+
+	bool performTlsTest(StringView rootPath) {
+		if (::access("/proc/net/tls_stat", F_OK) != 0) {
+			// kTLS is not available, server closes TLS connections after handshake
+			std::cout << "kTLS is not available, TLS test skipped\n";
+			return true;
+		}
+
+		auto fileData = filesystem::readIntoMemory<Interface>(filepath::merge<Interface>(rootPath, "index.html"));
+
+		auto fd = connectLocal(23002);
+		if (fd < 0) {
+			return false;
+		}
+
+		auto ctx = SSL_CTX_new(TLS_client_method());
+		auto ssl = SSL_new(ctx);
+		SSL_set_fd(ssl, fd);
+		SSL_set_tlsext_host_name(ssl, "localhost");
+
+		StringStream out;
+		if (SSL_connect(ssl) == 1) {
+			// response is sent with sendfile through kTLS
+			StringView request("GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+			if (SSL_write(ssl, request.data(), int(request.size())) == int(request.size())) {
+				char buf[1_KiB];
+				auto n = SSL_read(ssl, buf, sizeof(buf));
+				while (n > 0) {
+					out << StringView(buf, n);
+					n = SSL_read(ssl, buf, sizeof(buf));
+				}
+			}
+		}
+
+		SSL_free(ssl);
+		SSL_CTX_free(ctx);
+		::close(fd);
 
-	stream << "--" << boundary << "\r\n" << "Content-Disposition: form-data; name=arr[0]; dummy=\"dummy\"; val=\"test\r\n\r\nvalue1\r\n";
-	stream << "--" << boundary << "\r\n" << "Content-Disposition: form-data; name=arr[1][]\r\n\r\nvalue2\r\n";
-	stream << "--" << boundary << "\r\n" << "Content-Disposition: form-data; name=arr[1][]\r\n\r\nvalue3\r\n";
-	stream << "--" << boundary << "\r\n" << "Content-Disposition: form-data; name=dict[key]\r\n\r\nvalue4\r\n";
-	stream << "--" << boundary << "\r\n" << "Content-Disposition: form-data; name=dict[key]\r\n\r\nvalue5\r\n";
+		auto result = out.str();
+		return StringView(result).starts_with("HTTP/1.1 200 OK\r\n")
+				&& countOccurrences(result, BytesView(fileData).toStringView()) == 1;
+	}
+#endif
 
-	auto cborData = filesystem::readIntoMemory<Interface>(cborFile);
-	auto jsonData = filesystem::readIntoMemory<Interface>(jsonFile);
+	bool performHttp2Test(StringView rootPath) {
+		auto fileData = filesystem::readIntoMemory<Interface>(filepath::merge<Interface>(rootPath, "index.html"));
 
-	stream << "--" << boundary << "\r\n";
-	stream << "Content-Disposition: form-data; name=\"data\"; filename=\"" << filepath::lastComponent(cborFile) << "\"; "
-			"size=" << cborData.size() << "\r\n";
-	stream << "Content-Type: application/cbor\r\n";
-	stream << "Content-Transfer-Encoding: binary\r\n\r\n";
-	data.insert(data.end(), cborData.begin(), cborData.end());
-	stream << "\r\n";
+		auto fd = connectLocal();
+		if (fd < 0) {
+			return false;
+		}
 
-	stream << "--" << boundary << "\r\n";
-	stream << "Content-Disposition: form-data; name=\"file\"; filename=\"" << filepath::lastComponent(jsonFile) << "\"; "
-			"size=" << jsonData.size() << "\r\n";
-	stream << "Content-Type: application/json\r\n";
-	stream << "Content-Transfer-Encoding: binary\r\n\r\n";
-	data.insert(data.end(), jsonData.begin(), jsonData.end());
-	stream << "\r\n";
+		struct timeval tv = { 5, 0 };
+		::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
 
-	stream << "--" << boundary << "--\r\n";
+		auto writeFrame = [] (Bytes &out, uint8_t type, uint8_t flags, uint32_t id, BytesView payload) {
+			uint8_t header[9] = { uint8_t(payload.size() >> 16), uint8_t(payload.size() >> 8), uint8_t(payload.size()),
+					type, flags, uint8_t(id >> 24), uint8_t(id >> 16), uint8_t(id >> 8), uint8_t(id) };
+			out.insert(out.end(), header, header + 9);
+			out.insert(out.end(), payload.data(), payload.data() + payload.size());
+		};
 
-	return data;
-}
-static Bytes makeFileMultipartRequest2(StringView boundary) {
-	Bytes data;
+		// literal header fields without indexing, names are not taken from the static table
+		Bytes block;
+		auto writeField = [&] (StringView name, StringView value) {
+			block.emplace_back(0x00);
+			block.emplace_back(uint8_t(name.size()));
+			block.insert(block.end(), name.data(), name.data() + name.size());
+			block.emplace_back(uint8_t(value.size()));
+			block.insert(block.end(), value.data(), value.data() + value.size());
+		};
 
-	auto writer = [&] (StringView str) {
-		data.insert(data.end(), (const uint8_t *)str.data(), (const uint8_t *)str.data() + str.size());
-	};
+		writeField(":method", "GET");
+		writeField(":scheme", "http");
+		writeField(":path", "/index.html");
+		writeField(":authority", "localhost");
 
-	Callback<void(StringView)> stream(writer);
+		// prior knowledge: preface, empty SETTINGS and request on stream 1 with END_STREAM | END_HEADERS
+		StringView preface("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n");
+		Bytes request((const uint8_t *)preface.data(), (const uint8_t *)preface.data() + preface.size());
+		writeFrame(request, 0x4, 0x0, 0, BytesView());
+		writeFrame(request, 0x1, 0x5, 1, BytesView(block));
 
-	auto cborFile = filesystem::currentDir<Interface>("data/app.cbor");
-	auto jsonFile = filesystem::currentDir<Interface>("data/app.json");
-	auto cborData = filesystem::readIntoMemory<Interface>(cborFile);
-	auto jsonData = filesystem::readIntoMemory<Interface>(jsonFile);
+		if (::send(fd, request.data(), request.size(), 0) != ssize_t(request.size())) {
+			::close(fd);
+			return false;
+		}
 
-	stream << "--" << boundary << "\r\n";
-	stream << "Content-Disposition: form-data; name=\"binaryFile\"; filename=\"" << filepath::lastComponent(cborFile) << "\"; "
-			"size=" << cborData.size() << "\r\n";
-	stream << "Content-Type: application/cbor\r\n";
-	stream << "Content-Transfer-Encoding: binary\r\n\r\n";
-	data.insert(data.end(), cborData.begin(), cborData.end());
-	stream << "\r\n";
+		uint8_t status = 0;
+		Bytes body;
+		bool ended = false;
+		while (!ended) {
+			uint8_t header[9];
+			if (::recv(fd, header, 9, MSG_WAITALL) != 9) {
+				break;
+			}
 
-	stream << "--" << boundary << "\r\n";
-	stream << "Content-Disposition: form-data; name=\"textFile\"; filename=\"" << filepath::lastComponent(jsonFile) << "\"; "
-			"size=" << jsonData.size() << "\r\n";
-	stream << "Content-Type: application/json\r\n";
-	stream << "Content-Transfer-Encoding: binary\r\n\r\n";
-	data.insert(data.end(), jsonData.begin(), jsonData.end());
-	stream << "\r\n";
+			size_t len = (size_t(header[0]) << 16) | (size_t(header[1]) << 8) | size_t(header[2]);
+			uint32_t id = ((uint32_t(header[5]) << 24) | (uint32_t(header[6]) << 16)
+					| (uint32_t(header[7]) << 8) | uint32_t(header[8])) & 0x7fff'ffff;
 
-	stream << "--" << boundary << "--\r\n";
+			Bytes payload(len);
+			if (len > 0 && ::recv(fd, payload.data(), len, MSG_WAITALL) != ssize_t(len)) {
+				break;
+			}
 
-	return data;
-}
+			if (id != 1) {
+				continue;
+			}
 
-static Bytes performFileQuery(bool auth, NetworkHandle::Method m, StringView url, BytesView data = BytesView(), StringView contentType = StringView()) {
-	Bytes out;
+			if (header[3] == 0x1 && len > 0) {
+				status = payload[0];
+			} else if (header[3] == 0x0) {
+				body.insert(body.end(), payload.begin(), payload.end());
+			}
+			ended = (header[4] & 0x1) != 0;
+		}
+		::close(fd);
 
-	NetworkHandle h;
-	h.init(m, url);
-	if (!data.empty()) {
-		h.setSendData(data, contentType);
+		// 0x88 - indexed :status 200 from the static table
+		return ended && status == 0x88 && body == fileData;
 	}
 
-	h.setReceiveCallback([&] (char *data, size_t size) {
-		auto sourceSize = out.size();
-		out.resize(sourceSize + size);
-		memcpy(out.data() + sourceSize, data, size);
-		return size;
-	});
+	bool performTraceTest(StringView rootPath) {
+		auto tracePath = filepath::merge<Interface>(rootPath, "trace.json");
 
-	auto cookieFile = filesystem::currentDir<Interface>("web/root/cookie.cookie");
-	h.setCookieFile(cookieFile);
+		web::UnixRoot::Config cfg;
+		cfg.listen = StringView("127.0.0.1:23010");
+		cfg.serverTiming = true;
+		cfg.traceLog = StringView(tracePath);
 
-	if (auth && !s_AuthName.empty()) {
-		h.setAuthority(s_AuthName, s_AuthPassword);
-	}
-	h.perform();
+		auto root = makeServer(move(cfg), rootPath);
+		if (!root) {
+			return false;
+		}
 
-	return out;
-}
+		auto result = performRawRequest("GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n", 23010);
 
-static Bytes performFileQuery(NetworkHandle::Method m, StringView url, const Value & data) {
-	Bytes out;
+		bool success = StringView(result).starts_with("HTTP/1.1 200 OK\r\n")
+				&& countOccurrences(result, "server-timing: ") == 1
+				&& countOccurrences(result, "total;dur=") == 1;
 
-	NetworkHandle h;
-	h.init(m, url);
-	if (!data.empty()) {
-		h.setSendData(data);
-	}
+		// spans are appended to the log, when request is finalized, after the response was sent
+		bool traced = false;
+		for (size_t i = 0; i < 20 && !traced; ++ i) {
+			auto trace = filesystem::readTextFile<Interface>(tracePath);
+			if (StringView(trace).starts_with("[\n") && countOccurrences(trace, "\"ph\":\"X\"") > 0) {
+				traced = true;
+			} else {
+				::usleep(100'000);
+			}
+		}
 
-	h.setCookieFile(filesystem::currentDir<Interface>("web/root/cookie.cookie"));
+		stopServer(root);
+		filesystem::remove(tracePath);
+		return success && traced;
+	}
 
-	h.setReceiveCallback([&] (char *data, size_t size) {
-		auto sourceSize = out.size();
-		out.resize(sourceSize + size);
-		memcpy(out.data() + sourceSize, data, size);
-		return size;
-	});
-	h.perform();
+	bool performFragmentedTest(StringView rootPath) {
+		auto fileData = filesystem::readIntoMemory<Interface>(filepath::merge<Interface>(rootPath, "index.html"));
 
-	return out;
-}
+		auto fd = connectLocal();
+		if (fd < 0) {
+			return false;
+		}
 
-static Value performQuery(NetworkHandle::Method m, StringView url, BytesView data = BytesView(), StringView contentType = StringView()) {
-	StringStream out;
+		int nodelay = 1;
+		::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+		// request lines, header delimiters and CRLF pairs are split between reads,
+		// so parser should resume scanning from the previous position
+		StringView request("GET /index.html HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n"
+				"GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+		while (!request.empty()) {
+			auto part = request.sub(0, std::min(request.size(), size_t(3)));
+			request += part.size();
+			if (::send(fd, part.data(), part.size(), 0) != ssize_t(part.size())) {
+				::close(fd);
+				return false;
+			}
+			::usleep(1'000);
+		}
 
-	NetworkHandle h;
-	h.init(m, url);
-	if (!data.empty()) {
-		h.setSendData(data, contentType);
+		auto result = readAll(fd);
+		return countOccurrences(result, "HTTP/1.1 200 OK\r\n") == 2
+				&& countOccurrences(result, BytesView(fileData).toStringView()) == 2;
 	}
 
-	h.setReceiveCallback([&] (char *data, size_t size) {
-		out << StringView(data, size);
-		return size;
-	});
-	h.perform();
+	bool performRecycleTest(StringView rootPath) {
+		auto fileData = filesystem::readIntoMemory<Interface>(filepath::merge<Interface>(rootPath, "index.html"));
 
-	return data::read<Interface>(out.str());
-}
+		// sends part of the request, then drops connection, so client is released in the middle of the input
+		auto abort = [] (StringView data) {
+			auto fd = connectLocal();
+			if (fd >= 0) {
+				::send(fd, data.data(), data.size(), 0);
+				::usleep(10'000);
+				::close(fd);
+			}
+		};
 
-static Value performQuery(NetworkHandle::Method m, StringView url, const Value &data) {
-	StringStream out;
+		// released clients are reused for the next connections, so every response should be built
+		// only from its own request, without state from the aborted ones
+		bool success = true;
+		for (size_t i = 0; i < 60; ++ i) {
+			switch (i % 4) {
+			case 0:
+				abort("GET /index.html HTTP/1.1\r\nHost: loc");
+				break;
+			case 1: {
+				auto result = performRawRequest("GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+				if (!StringView(result).starts_with("HTTP/1.1 200 OK\r\n")
+						|| !StringView(result).ends_with(BytesView(fileData).toStringView())) {
+					success = false;
+				}
+				break;
+			}
+			case 2:
+				abort("POST /map/files HTTP/1.1\r\nHost: localhost\r\nContent-Type: text/plain\r\n"
+						"Content-Length: 1024\r\n\r\npartial body of the aborted request");
+				break;
+			case 3: {
+				auto data = toString("body of the request ", i);
+				auto result = performRawRequest(toString("POST /map/files HTTP/1.1\r\nHost: localhost\r\nContent-Type: text/plain\r\n"
+						"Content-Length: ", data.size(), "\r\nConnection: close\r\n\r\n", data));
+
+				StringView r(result);
+				if (!r.starts_with("HTTP/1.1 200 OK\r\n")) {
+					success = false;
+					break;
+				}
 
-	NetworkHandle h;
-	h.init(m, url);
-	if (!data.empty()) {
-		h.setSendData(data);
+				r.skipUntilString("\r\n\r\n");
+				r += 4;
+				if (data::read<Interface>(r).getString("body") != data) {
+					success = false;
+				}
+				break;
+			}
+			}
+		}
+		return success;
 	}
 
-	h.setReceiveCallback([&] (char *data, size_t size) {
-		out << StringView(data, size);
-		return size;
-	});
-	h.perform();
-
-	return data::read<Interface>(out.str());
-}
+	bool performWebsocketTest() {
+		auto fd = connectLocal();
+		if (fd < 0) {
+			return false;
+		}
 
-struct UnixWebTest : Test {
-	UnixWebTest() : Test("UnixWebTest") { }
+		// key and accept value from RFC 6455 example
+		StringView request("GET /__server/shell?name=stappler&passwd=stappler HTTP/1.1\r\nHost: localhost\r\n"
+				"Upgrade: websocket\r\nConnection: Upgrade\r\n"
+				"Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n");
 
-	bool perfromIndexTest(StringView rootPath) {
-		auto d = base16::encode<Interface>(valid::makeRandomBytes<Interface>(8));
+		// masked Ping with payload, then masked Close with status 1000
+		const uint8_t frames[] = {
+			0x89, 0x84, 0x01, 0x02, 0x03, 0x04, 'p' ^ 0x01, 'i' ^ 0x02, 'n' ^ 0x03, 'g' ^ 0x04,
+			0x88, 0x82, 0x01, 0x02, 0x03, 0x04, 0x03 ^ 0x01, 0xE8 ^ 0x02
+		};
 
-		StringStream out;
+		if (::send(fd, request.data(), request.size(), 0) != ssize_t(request.size())
+				|| ::send(fd, frames, sizeof(frames), 0) != ssize_t(sizeof(frames))) {
+			::close(fd);
+			return false;
+		}
 
-		NetworkHandle h;
-		h.init(NetworkHandle::Method::Get, toString("http://localhost:23001/index.html?data=", d));
-		h.setReceiveCallback([&] (char *data, size_t size) {
-			out << StringView(data, size);
-			return size;
-		});
-		h.perform();
+		auto response = readAll(fd);
 
-		auto fileData = filesystem::readIntoMemory<Interface>(filepath::merge<Interface>(rootPath, "index.html"));
+		StringView result(response);
+		if (!result.starts_with("HTTP/1.1 101 ")
+				|| countOccurrences(result, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") != 1) {
+			return false;
+		}
 
-		if (BytesView(fileData) == BytesView(out.str())) {
-			return true;
+		result.skipUntilString("\r\n\r\n");
+		result += 4;
+
+		// server frames are not masked, and payload is below 126 bytes for this test
+		bool pong = false;
+		bool close = false;
+		while (result.size() >= 2) {
+			auto opcode = uint8_t(result[0]) & 0x0F;
+			auto size = size_t(uint8_t(result[1]) & 0x7F);
+			if (size >= 126 || result.size() < size + 2) {
+				break;
+			}
+			auto payload = StringView(result.data() + 2, size);
+			if (opcode == 0x0A && payload == "ping") {
+				pong = true;
+			} else if (opcode == 0x08 && size >= 2 && uint8_t(payload[0]) == 0x03 && uint8_t(payload[1]) == 0xE8) {
+				close = true;
+			}
+			result += size + 2;
 		}
 
-		return false;
+		return pong && close;
 	}
 
 	Value performMapTest() {
@@ -781,7 +2025,26 @@ struct UnixWebTest : Test {
 
 		web::UnixRoot::Config cfg;
 
-		cfg.listen = StringView("127.0.0.1:23001");
+		auto certPath = filepath::merge<Interface>(rootPath, "cert.pem");
+		auto keyPath = filepath::merge<Interface>(rootPath, "key.pem");
+
+		cfg.listeners.emplace_back(web::UnixListenerConfig{
+			.address = StringView("127.0.0.1:23001"),
+		});
+
+		cfg.http2 = true;
+
+		bool hasTls = false;
+#if UNIX_WEB_TEST_TLS
+		hasTls = makeTlsCertificate(certPath, keyPath);
+#endif
+		if (hasTls) {
+			cfg.listeners.emplace_back(web::UnixListenerConfig{
+				.address = StringView("127.0.0.1:23002"),
+				.certificate = StringView(certPath),
+				.privateKey = StringView(keyPath),
+			});
+		}
 
 		cfg.db = mem_pool::Value({
 			pair("host", mem_pool::Value("localhost")),
@@ -858,6 +2121,100 @@ struct UnixWebTest : Test {
 			success = false;
 		}
 
+		if (!performPipeliningTest(rootPath)) {
+			success = false;
+		}
+
+		if (!performFragmentedTest(rootPath)) {
+			success = false;
+		}
+
+		if (!performRecycleTest(rootPath)) {
+			success = false;
+		}
+
+		if (!performWebsocketTest()) {
+			success = false;
+		}
+
+		if (!performChunkedTest()) {
+			success = false;
+		}
+
+		if (!performCompressionTest()) {
+			success = false;
+		}
+
+		if (!performReusePortTest(rootPath)) {
+			success = false;
+		}
+
+		if (!performRangeTest(rootPath)) {
+			success = false;
+		}
+
+		if (!performStaticEncodingTest(rootPath)) {
+			success = false;
+		}
+
+		if (!performFileCacheTest(rootPath)) {
+			success = false;
+		}
+
+		if (!performTimerTest(root)) {
+			success = false;
+		}
+
+		if (!performDeadlineTest(rootPath)) {
+			success = false;
+		}
+
+		if (!performUringTest(rootPath)) {
+			success = false;
+		}
+
+		if (!performSpliceTest()) {
+			success = false;
+		}
+
+		if (!performOffloadTest(rootPath)) {
+			success = false;
+		}
+
+		if (!performAdmissionTest(rootPath)) {
+			success = false;
+		}
+
+		if (!performListenersTest(rootPath)) {
+			success = false;
+		}
+
+		if (!performContinueTest()) {
+			success = false;
+		}
+
+		if (!performReloadTest(root, rootPath)) {
+			success = false;
+		}
+
+#if UNIX_WEB_TEST_TLS
+		if (!hasTls) {
+			std::cout << "Fail to create test certificate, TLS test skipped\n";
+		} else if (!performTlsTest(rootPath)) {
+			success = false;
+		}
+#else
+		std::cout << "OpenSSL is built without kTLS, TLS test skipped\n";
+#endif
+
+		if (!performHttp2Test(rootPath)) {
+			success = false;
+		}
+
+		if (!performTraceTest(rootPath)) {
+			success = false;
+		}
+
 		::sleep(1);
 
 		root->cancel();
@@ -29,6 +29,9 @@
 
 namespace STAPPLER_VERSIONIZED stappler::web {
 
+// number of the component's heartbeats, checked by the heartbeat test
+static std::atomic<size_t> s_testHeartbeats = 0;
+
 class TestHandlerMapVariant1 : public RequestHandlerMap::Handler {
 public:
 	virtual bool isPermitted() override { return true; }
@@ -73,6 +76,27 @@ public:
 	}
 };
 
+// raw upload without the body, file can be written directly from the socket
+class TestHandlerMapVariant4 : public RequestHandlerMap::Handler {
+public:
+	virtual bool isPermitted() override { return true; }
+
+	virtual Value onData() override {
+		Value files;
+		for (auto &it : _filter->getFiles()) {
+			auto data = it.readBytes();
+			files.addValue(Value({
+				pair("size", Value(int64_t(data.size()))),
+				pair("hash", Value(int64_t(std::hash<std::string_view>()(
+						std::string_view((const char *)data.data(), data.size()))))),
+			}));
+		}
+		return Value({
+			pair("files", move(files)),
+		});
+	}
+};
+
 class TestHandlerMap : public RequestHandlerMap {
 public:
 	TestHandlerMap() {
@@ -116,6 +140,14 @@ public:
 			2_MiB,
 			2_MiB,
 		});
+
+		addHandler("Variant4Post", RequestMethod::Post, "/upload", Handler::Make<TestHandlerMapVariant4>())
+				.setInputConfig(db::InputConfig{
+			db::InputConfig::Require::Files,
+			4_MiB,
+			4_MiB,
+			1_MiB,
+		});
 	}
 };
 
@@ -129,7 +161,7 @@ public:
 	virtual void handleStorageInit(const Host &, const db::Adapter &) override;
 
 	virtual void initTransaction(db::Transaction &) override;
-	// virtual void handleHeartbeat(const VirtualServer &) override;
+	virtual void handleHeartbeat(const Host &) override;
 
 protected:
 	Scheme _objects = Scheme("objects", Scheme::WithDelta);
@@ -453,13 +485,56 @@ void TestHandler::initTransaction(db::Transaction &t) {
 	t.setRole(db::AccessRoleId::Authorized);
 }
 
+void TestHandler::handleHeartbeat(const Host &host) {
+	HostComponent::handleHeartbeat(host);
+	++ s_testHeartbeats;
+}
+
 extern "C" HostComponent * CreateTestComponent(const Host &serv, const HostComponentInfo &info) {
 	return new TestHandler(serv, info);
 }
 
+// handler, that blocks its thread for the number of milliseconds from the path
+class TestSlowHandler : public RequestHandlerMap::Handler {
+public:
+	virtual bool isPermitted() override { return true; }
+
+	virtual Value onData() override {
+		auto ms = StringView(_params.getString("ms")).readInteger(10).get(0);
+		::usleep(useconds_t(ms * 1'000));
+		return Value({
+			pair("slept", Value(ms)),
+		});
+	}
+};
+
+class TestSlowHandlerMap : public RequestHandlerMap {
+public:
+	TestSlowHandlerMap() {
+		addHandler("Slow", RequestMethod::Get, "/:ms", Handler::Make<TestSlowHandler>());
+	}
+};
+
+// component without storage for the servers, that are started by the separate tests
+class TestSlowComponent : public HostComponent {
+public:
+	TestSlowComponent(const Host &serv, const HostComponentInfo &info) : HostComponent(serv, info) { }
+	virtual ~TestSlowComponent() { }
+
+	virtual void handleChildInit(const Host &serv) override {
+		serv.addHandler("/slow/", new TestSlowHandlerMap);
+	}
+};
+
+extern "C" HostComponent * CreateTestSlowComponent(const Host &serv, const HostComponentInfo &info) {
+	return new TestSlowComponent(serv, info);
+}
+
 static SharedSymbol s_testComponentSymbols[] = {
 	SharedSymbol{"CreateTestComponent",
 		(void *)static_cast<HostComponent::Symbol>(CreateTestComponent)},
+	SharedSymbol{"CreateTestSlowComponent",
+		(void *)static_cast<HostComponent::Symbol>(CreateTestSlowComponent)},
 };
 
 static SharedModule s_testComponentModule("TestComonent", s_testComponentSymbols, sizeof(s_testComponentSymbols) / sizeof(SharedSymbol));